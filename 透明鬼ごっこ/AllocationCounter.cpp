@@ -0,0 +1,147 @@
+﻿# include "AllocationCounter.hpp"
+# include <atomic>
+# include <cstdlib>
+# include <new>
+
+# ifdef TRANSPARENT_TAG_BENCHMARK
+
+namespace
+{
+	std::atomic<uint64> g_count{ 0 };
+
+	std::atomic<uint64> g_bytes{ 0 };
+
+	void* Allocate(const std::size_t size)
+	{
+		g_count.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		if (void* p = std::malloc(size ? size : 1))
+		{
+			return p;
+		}
+
+		throw std::bad_alloc{};
+	}
+
+	void* AlignedMalloc(const std::size_t size, const std::size_t alignment) noexcept
+	{
+	# if SIV3D_PLATFORM(WINDOWS)
+		return ::_aligned_malloc(size, alignment);
+	# else
+		return std::aligned_alloc(alignment, ((size + alignment - 1) / alignment * alignment));
+	# endif
+	}
+
+	void* AllocateAligned(const std::size_t size, const std::align_val_t alignment)
+	{
+		g_count.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		if (void* p = AlignedMalloc((size ? size : 1), static_cast<std::size_t>(alignment)))
+		{
+			return p;
+		}
+
+		throw std::bad_alloc{};
+	}
+
+	void FreeAligned(void* p) noexcept
+	{
+	# if SIV3D_PLATFORM(WINDOWS)
+		::_aligned_free(p);
+	# else
+		std::free(p);
+	# endif
+	}
+}
+
+namespace AllocationCounter
+{
+	uint64 GetCount() noexcept
+	{
+		return g_count.load(std::memory_order_relaxed);
+	}
+
+	uint64 GetBytes() noexcept
+	{
+		return g_bytes.load(std::memory_order_relaxed);
+	}
+}
+
+void* operator new(const std::size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new[](const std::size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment)
+{
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment)
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+
+# else
+
+namespace AllocationCounter
+{
+	uint64 GetCount() noexcept
+	{
+		return 0;
+	}
+
+	uint64 GetBytes() noexcept
+	{
+		return 0;
+	}
+}
+
+# endif
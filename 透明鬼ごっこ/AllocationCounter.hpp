@@ -0,0 +1,26 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief グローバルな operator new によるヒープ確保を数えます。
+/// @remark ベンチマークで 1 フレームあたりの確保回数を計測するために使います。
+/// operator new / delete を置き換えるのは TRANSPARENT_TAG_BENCHMARK を定義したとき（Benchmark 構成）だけです。
+/// それ以外のビルドでは数えず、GetCount() と GetBytes() は常に 0 を返します。
+namespace AllocationCounter
+{
+	/// @brief ヒープ確保を数えているか
+# ifdef TRANSPARENT_TAG_BENCHMARK
+	inline constexpr bool Enabled = true;
+# else
+	inline constexpr bool Enabled = false;
+# endif
+
+	/// @brief プログラム開始からのヒープ確保の回数を返します。
+	/// @return ヒープ確保の回数
+	[[nodiscard]]
+	uint64 GetCount() noexcept;
+
+	/// @brief プログラム開始からのヒープ確保のバイト数を返します。
+	/// @return ヒープ確保のバイト数
+	[[nodiscard]]
+	uint64 GetBytes() noexcept;
+}
@@ -0,0 +1,112 @@
+//
+//	Ghost sprites: fade, slowdown tint and transparency computed per pixel
+//
+//	Vertex color: rgb = tint, a = slot * 2 + (1 for the body, 0 for the eyes and crown)
+//	The per-ghost parameters are looked up by slot in GhostConstants.
+//
+
+# version 410
+
+//
+//	Textures
+//
+uniform sampler2D Texture0;
+
+//
+//	PSInput
+//
+layout(location = 0) in vec4 Color;
+layout(location = 1) in vec2 UV;
+
+//
+//	PSOutput
+//
+layout(location = 0) out vec4 FragColor;
+
+//
+//	Constant Buffer
+//
+layout(std140) uniform PSConstants2D
+{
+	vec4 g_colorAdd;
+	vec4 g_sdfParam;
+	vec4 g_sdfOutlineColor;
+	vec4 g_sdfShadowColor;
+	vec4 g_internal;
+};
+
+# define MAX_GHOSTS 64
+
+const uint FlagTransparent	= 1u;
+const uint FlagSlowdown		= 2u;
+const uint FlagSelf			= 4u;
+const uint FlagDimmed		= 8u;
+
+layout(std140) uniform GhostConstants
+{
+	// x: server time (s), y: seconds the viewer has not moved
+	vec4 g_frame;
+
+	// [slot * 2 + 0]: fade deadline (s), fade duration (s), slowdown deadline (s), slowdown duration (s)
+	// [slot * 2 + 1]: x: flags
+	vec4 g_ghosts[MAX_GHOSTS * 2];
+};
+
+//
+//	Functions
+//
+
+// ServerTimer::progress1_0
+float Progress1_0(float deadline, float duration)
+{
+	if (duration <= 0.0)
+	{
+		return 0.0;
+	}
+
+	return (clamp(deadline - g_frame.x, 0.0, duration) / duration);
+}
+
+void main()
+{
+	uint code = uint(round(Color.a));
+	uint slot = (code >> 1u);
+	bool isBody = ((code & 1u) != 0u);
+
+	vec4 timers = g_ghosts[slot * 2u];
+	uint flags = uint(g_ghosts[slot * 2u + 1u].x);
+
+	float fade = Progress1_0(timers.x, timers.y);
+	float alpha = (((flags & FlagTransparent) != 0u) ? fade : (1.0 - fade));
+
+	if ((flags & FlagSelf) != 0u)
+	{
+		alpha = (alpha * 0.75 + 0.25);
+	}
+	else
+	{
+		if (((flags & FlagTransparent) != 0u) && (1.0 < g_frame.y))
+		{
+			alpha = min((g_frame.y - 1.0), 0.5);
+		}
+
+		if ((flags & FlagDimmed) != 0u)
+		{
+			alpha = mix(0.5, 1.0, alpha);
+		}
+	}
+
+	vec3 tint = Color.rgb;
+
+	if (isBody && ((flags & FlagSlowdown) != 0u))
+	{
+		// Periodic::Sine0_1(0.5s, remaining), then HSV value from 1.0 down to 0.5
+		float remaining = clamp(timers.z - g_frame.x, 0.0, timers.w);
+		float t = (sin(mod(remaining, 0.5) / 0.5 * 6.28318530718) * 0.5 + 0.5);
+		tint *= (mix(1.0, 0.5, t) / max(max(tint.r, max(tint.g, tint.b)), 1e-5));
+	}
+
+	vec4 texColor = texture(Texture0, UV);
+
+	FragColor = (texColor * vec4(tint, alpha)) + g_colorAdd;
+}
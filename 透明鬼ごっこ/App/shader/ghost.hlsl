@@ -0,0 +1,109 @@
+//
+//	Ghost sprites: fade, slowdown tint and transparency computed per pixel
+//
+//	Vertex color: rgb = tint, a = slot * 2 + (1 for the body, 0 for the eyes and crown)
+//	The per-ghost parameters are looked up by slot in GhostConstants.
+//
+
+//
+//	Textures
+//
+Texture2D		g_texture0 : register(t0);
+SamplerState	g_sampler0 : register(s0);
+
+namespace s3d
+{
+	//
+	//	VS Output / PS Input
+	//
+	struct PSInput
+	{
+		float4 position	: SV_POSITION;
+		float4 color	: COLOR0;
+		float2 uv		: TEXCOORD0;
+	};
+}
+
+//
+//	Constant Buffer
+//
+cbuffer PSConstants2D : register(b0)
+{
+	float4 g_colorAdd;
+	float4 g_sdfParam;
+	float4 g_sdfOutlineColor;
+	float4 g_sdfShadowColor;
+	float4 g_internal;
+}
+
+#define MAX_GHOSTS 64
+
+static const uint FlagTransparent	= 1;
+static const uint FlagSlowdown		= 2;
+static const uint FlagSelf			= 4;
+static const uint FlagDimmed		= 8;
+
+cbuffer GhostConstants : register(b1)
+{
+	// x: server time (s), y: seconds the viewer has not moved
+	float4 g_frame;
+
+	// [slot * 2 + 0]: fade deadline (s), fade duration (s), slowdown deadline (s), slowdown duration (s)
+	// [slot * 2 + 1]: x: flags
+	float4 g_ghosts[MAX_GHOSTS * 2];
+}
+
+// ServerTimer::progress1_0
+float Progress1_0(float deadline, float duration)
+{
+	if (duration <= 0.0)
+	{
+		return 0.0;
+	}
+
+	return (clamp(deadline - g_frame.x, 0.0, duration) / duration);
+}
+
+float4 PS(s3d::PSInput input) : SV_TARGET
+{
+	const uint code = (uint)round(input.color.a);
+	const uint slot = (code >> 1);
+	const bool isBody = ((code & 1) != 0);
+
+	const float4 timers = g_ghosts[slot * 2];
+	const uint flags = (uint)g_ghosts[slot * 2 + 1].x;
+
+	const float fade = Progress1_0(timers.x, timers.y);
+	float alpha = ((flags & FlagTransparent) ? fade : (1.0 - fade));
+
+	if (flags & FlagSelf)
+	{
+		alpha = (alpha * 0.75 + 0.25);
+	}
+	else
+	{
+		if ((flags & FlagTransparent) && (1.0 < g_frame.y))
+		{
+			alpha = min((g_frame.y - 1.0), 0.5);
+		}
+
+		if (flags & FlagDimmed)
+		{
+			alpha = lerp(0.5, 1.0, alpha);
+		}
+	}
+
+	float3 tint = input.color.rgb;
+
+	if (isBody && (flags & FlagSlowdown))
+	{
+		// Periodic::Sine0_1(0.5s, remaining), then HSV value from 1.0 down to 0.5
+		const float remaining = clamp(timers.z - g_frame.x, 0.0, timers.w);
+		const float t = (sin(fmod(remaining, 0.5) / 0.5 * 6.28318530718) * 0.5 + 0.5);
+		tint *= (lerp(1.0, 0.5, t) / max(max(tint.r, max(tint.g, tint.b)), 1e-5));
+	}
+
+	const float4 texColor = g_texture0.Sample(g_sampler0, input.uv);
+
+	return (texColor * float4(tint, alpha)) + g_colorAdd;
+}
@@ -0,0 +1,159 @@
+﻿# include "BenchmarkStats.hpp"
+# include "CircleCollider.hpp"
+# include <cstdio>
+# include <cstdlib>
+# include <iostream>
+
+void BenchmarkStats::addSample(const double milliseconds, const uint64 allocations)
+{
+	m_milliseconds << milliseconds;
+	m_allocations << allocations;
+}
+
+void BenchmarkStats::reserve(const size_t n)
+{
+	m_milliseconds.reserve(n);
+	m_allocations.reserve(n);
+}
+
+size_t BenchmarkStats::count() const noexcept
+{
+	return m_milliseconds.size();
+}
+
+double BenchmarkStats::percentile(const double p) const
+{
+	if (not m_milliseconds)
+	{
+		return 0.0;
+	}
+
+	const Array<double> sorted = m_milliseconds.sorted();
+	const size_t index = static_cast<size_t>(Math::Round(Clamp(p, 0.0, 1.0) * (sorted.size() - 1)));
+	return sorted[index];
+}
+
+double BenchmarkStats::max() const
+{
+	if (not m_milliseconds)
+	{
+		return 0.0;
+	}
+
+	return *std::max_element(m_milliseconds.begin(), m_milliseconds.end());
+}
+
+double BenchmarkStats::total() const
+{
+	return m_milliseconds.sum();
+}
+
+double BenchmarkStats::allocationsPerSample() const
+{
+	if (not m_allocations)
+	{
+		return 0.0;
+	}
+
+	return (static_cast<double>(m_allocations.sum()) / m_allocations.size());
+}
+
+uint64 BenchmarkStats::maxAllocations() const
+{
+	if (not m_allocations)
+	{
+		return 0;
+	}
+
+	return *std::max_element(m_allocations.begin(), m_allocations.end());
+}
+
+JSON BenchmarkStats::toJSON() const
+{
+	JSON json;
+	json[U"samples"] = count();
+	json[U"p50_ms"] = percentile(0.50);
+	json[U"p99_ms"] = percentile(0.99);
+	json[U"max_ms"] = max();
+	json[U"total_ms"] = total();
+	json[U"allocations_per_sample"] = allocationsPerSample();
+	json[U"max_allocations"] = maxAllocations();
+	return json;
+}
+
+namespace BenchmarkRun
+{
+	void Begin()
+	{
+		Console.open();
+
+		Reseed(Seed);
+	}
+
+	void Finish(const JSON& summary, const Optional<FilePath>& jsonPath)
+	{
+		Console << summary.format();
+
+		if (jsonPath)
+		{
+			summary.save(*jsonPath);
+		}
+	}
+
+	Optional<Array<Vec2>> RandomFreePositions(const CircleCollider& collider, const double radius, const size_t count)
+	{
+		// 外周の壁にめり込まないように内側から選ぶ
+		const RectF area = collider.bounds().stretched(-60);
+
+		Array<Vec2> positions;
+		positions.reserve(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int32 attempt = 0; ; ++attempt)
+			{
+				// 空いた場所がないマップで止まらないように、諦めて失敗にする
+				if (MaxPositionAttempts <= attempt)
+				{
+					return none;
+				}
+
+				const Vec2 pos = RandomVec2(area);
+
+				if (not collider.intersects(Circle{ pos, (radius + 1.0) }))
+				{
+					positions << pos;
+					break;
+				}
+			}
+		}
+
+		return positions;
+	}
+
+	Vec2 RandomDirection()
+	{
+		const int32 d = Random(0, 8);
+
+		if (d == 8)
+		{
+			return Vec2{ 0, 0 };
+		}
+
+		return Circular{ 1.0, (d * 45_deg) };
+	}
+
+	void ExitIfFailed(const bool passed)
+	{
+		if (passed)
+		{
+			return;
+		}
+
+		std::cout.flush();
+		std::fflush(stdout);
+
+		// エンジンの終了処理を待たずに終了する。結果はすでに書き出してある
+		std::_Exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,89 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+class CircleCollider;
+
+/// @brief ベンチマークの 1 サンプルごとの計測値を集計します。
+class BenchmarkStats
+{
+public:
+
+	/// @brief サンプルを追加します。
+	/// @param milliseconds 所要時間（ミリ秒）
+	/// @param allocations ヒープ確保の回数
+	void addSample(double milliseconds, uint64 allocations = 0);
+
+	/// @brief サンプル用の領域を予約します。
+	/// @param n サンプル数
+	void reserve(size_t n);
+
+	/// @brief サンプル数を返します。
+	[[nodiscard]]
+	size_t count() const noexcept;
+
+	/// @brief 所要時間のパーセンタイル値（ミリ秒）を返します。
+	/// @param p 0.0 以上 1.0 以下の割合
+	[[nodiscard]]
+	double percentile(double p) const;
+
+	/// @brief 所要時間の最大値（ミリ秒）を返します。
+	[[nodiscard]]
+	double max() const;
+
+	/// @brief 所要時間の合計（ミリ秒）を返します。
+	[[nodiscard]]
+	double total() const;
+
+	/// @brief 1 サンプルあたりの平均ヒープ確保回数を返します。
+	[[nodiscard]]
+	double allocationsPerSample() const;
+
+	/// @brief 1 サンプルでの最大ヒープ確保回数を返します。
+	[[nodiscard]]
+	uint64 maxAllocations() const;
+
+	/// @brief 集計結果を JSON で返します。
+	[[nodiscard]]
+	JSON toJSON() const;
+
+private:
+
+	Array<double> m_milliseconds;
+
+	Array<uint64> m_allocations;
+};
+
+/// @brief ベンチマークの起動モードに共通する準備と入力の生成、結果の出力
+namespace BenchmarkRun
+{
+	/// @brief 乱数のシード。毎回同じ入力で計測するために固定します
+	inline constexpr uint64 Seed = 12345;
+
+	/// @brief RandomFreePositions() で 1 つの位置を選ぶときに試す最大の回数
+	inline constexpr int32 MaxPositionAttempts = 10000;
+
+	/// @brief コンソールを開き、乱数のシードを Seed に固定します。
+	void Begin();
+
+	/// @brief 結果をコンソールに出力し、保存先が指定されていれば JSON で保存します。
+	/// @param summary 結果
+	/// @param jsonPath 結果の JSON の保存先。none の場合は保存しません
+	void Finish(const JSON& summary, const Optional<FilePath>& jsonPath);
+
+	/// @brief 壁と重ならない位置をランダムに選びます。
+	/// @param collider 壁
+	/// @param radius 置く円の半径
+	/// @param count 選ぶ数
+	/// @return 位置の一覧。MaxPositionAttempts 回試しても空いた場所が見つからなかった場合は none
+	[[nodiscard]]
+	Optional<Array<Vec2>> RandomFreePositions(const CircleCollider& collider, double radius, size_t count);
+
+	/// @brief 8 方向の単位ベクトルまたは停止をランダムに選びます。
+	[[nodiscard]]
+	Vec2 RandomDirection();
+
+	/// @brief 検査に不合格だった場合、出力を書き出してから終了コード EXIT_FAILURE でプロセスを終了します。
+	/// @param passed 検査に合格した場合 true
+	/// @remark Main() は終了コードを返せないため、CI が失敗を検出できるようにここで終了します。
+	void ExitIfFailed(bool passed);
+}
@@ -0,0 +1,311 @@
+﻿# include "CircleCollider.hpp"
+
+# if SIV3D_INTRINSIC(SSE)
+#	include <emmintrin.h>
+# endif
+
+namespace
+{
+	/// @brief パディング用の辺の座標。どの点からも十分に遠い
+	constexpr double FarAway = 1e15;
+
+	/// @brief 押し出したあとに壁から離す距離
+	constexpr double SkinWidth = 1e-6;
+}
+
+void CircleCollider::clear()
+{
+	m_walls.clear();
+	m_wallOuters.clear();
+	m_wallIndices.clear();
+	m_cellBegin.clear();
+	m_ax.clear();
+	m_ay.clear();
+	m_dx.clear();
+	m_dy.clear();
+	m_invLengthSq.clear();
+	m_columns = 0;
+	m_rows = 0;
+}
+
+void CircleCollider::addPolygon(const Polygon& polygon)
+{
+	Array<uint16> indices;
+	indices.reserve(polygon.indices().size() * 3);
+
+	for (const auto& triangle : polygon.indices())
+	{
+		indices << triangle.i0 << triangle.i1 << triangle.i2;
+	}
+
+	m_walls << polygon;
+	m_wallOuters << polygon.outer();
+	m_wallIndices << std::move(indices);
+}
+
+void CircleCollider::addQuad(const Quad& quad)
+{
+	addPolygon(quad.asPolygon());
+}
+
+void CircleCollider::addRect(const Vec2& center, const SizeF& size, const double angle)
+{
+	addQuad(RectF{ Arg::center(center), size }.rotated(angle));
+}
+
+void CircleCollider::build(const RectF& bounds, const double cellSize, const double margin)
+{
+	m_bounds = bounds;
+	m_cellSize = Max(cellSize, 1.0);
+	m_margin = Max(margin, 0.0);
+	m_columns = Max(static_cast<int32>(Math::Ceil(bounds.w / m_cellSize)), 1);
+	m_rows = Max(static_cast<int32>(Math::Ceil(bounds.h / m_cellSize)), 1);
+
+	Array<Line> edges;
+
+	for (const auto& outer : m_wallOuters)
+	{
+		for (size_t i = 0; i < outer.size(); ++i)
+		{
+			edges.emplace_back(outer[i], outer[(i + 1) % outer.size()]);
+		}
+	}
+
+	m_cellBegin.clear();
+	m_ax.clear();
+	m_ay.clear();
+	m_dx.clear();
+	m_dy.clear();
+	m_invLengthSq.clear();
+
+	// セルを margin だけ広げた範囲にかかる辺をすべてそのセルに入れる。
+	// セルの中の点から margin 以内にある辺は、必ずそのセルの辺に含まれる
+	for (int32 y = 0; y < m_rows; ++y)
+	{
+		for (int32 x = 0; x < m_columns; ++x)
+		{
+			m_cellBegin << static_cast<uint32>(m_ax.size());
+
+			const RectF area = RectF{ (m_bounds.x + x * m_cellSize), (m_bounds.y + y * m_cellSize), m_cellSize, m_cellSize }.stretched(m_margin);
+
+			for (const auto& edge : edges)
+			{
+				if (area.intersects(edge) or area.contains(edge.begin))
+				{
+					pushEdge(edge.begin, edge.end);
+				}
+			}
+
+			if (m_ax.size() % 2)
+			{
+				pushPadding();
+			}
+		}
+	}
+
+	m_cellBegin << static_cast<uint32>(m_ax.size());
+}
+
+void CircleCollider::restoreWalls()
+{
+	m_walls.clear();
+
+	for (size_t i = 0; i < m_wallOuters.size(); ++i)
+	{
+		const auto& outer = m_wallOuters[i];
+		const auto& flat = m_wallIndices[i];
+
+		Array<TriangleIndex> indices(flat.size() / 3);
+
+		for (size_t k = 0; k < indices.size(); ++k)
+		{
+			indices[k] = TriangleIndex{ flat[k * 3], flat[k * 3 + 1], flat[k * 3 + 2] };
+		}
+
+		m_walls.emplace_back(outer, std::move(indices), Geometry2D::BoundingRect(outer), SkipValidation::Yes);
+	}
+}
+
+const Array<Polygon>& CircleCollider::walls() const noexcept
+{
+	return m_walls;
+}
+
+const RectF& CircleCollider::bounds() const noexcept
+{
+	return m_bounds;
+}
+
+bool CircleCollider::intersects(const Circle& circle) const
+{
+	assert(circle.r <= m_margin);
+
+	if (m_walls.any([&](const Polygon& wall) { return wall.contains(circle.center); }))
+	{
+		return true;
+	}
+
+	return (findClosestEdge(circle.center).second < (circle.r * circle.r));
+}
+
+Vec2 CircleCollider::move(const Vec2& start, const double radius, const Vec2& displacement) const
+{
+	const double maxStep = Max((radius * 0.5), 1e-3);
+
+	// 押し出しの途中で調べる範囲が margin を超えないようにする
+	assert((radius + maxStep) <= m_margin);
+
+	const int32 steps = Max(static_cast<int32>(Math::Ceil(displacement.length() / maxStep)), 1);
+	const Vec2 step = (displacement / steps);
+
+	Vec2 center = start;
+
+	for (int32 i = 0; i < steps; ++i)
+	{
+		center = resolve((center + step), radius);
+	}
+
+	return center;
+}
+
+void CircleCollider::pushEdge(const Vec2& a, const Vec2& b)
+{
+	const Vec2 d = (b - a);
+	const double lengthSq = d.lengthSq();
+
+	m_ax << a.x;
+	m_ay << a.y;
+	m_dx << d.x;
+	m_dy << d.y;
+	m_invLengthSq << ((0.0 < lengthSq) ? (1.0 / lengthSq) : 0.0);
+}
+
+void CircleCollider::pushPadding()
+{
+	m_ax << FarAway;
+	m_ay << FarAway;
+	m_dx << 0.0;
+	m_dy << 0.0;
+	m_invLengthSq << 0.0;
+}
+
+size_t CircleCollider::toCellIndex(const Vec2& point) const
+{
+	const int32 x = Clamp(static_cast<int32>(Math::Floor((point.x - m_bounds.x) / m_cellSize)), 0, (m_columns - 1));
+	const int32 y = Clamp(static_cast<int32>(Math::Floor((point.y - m_bounds.y) / m_cellSize)), 0, (m_rows - 1));
+	return (static_cast<size_t>(y) * m_columns + x);
+}
+
+std::pair<size_t, double> CircleCollider::findClosestEdge(const Vec2& point) const
+{
+	if (m_cellBegin.isEmpty())
+	{
+		return{ 0, Largest<double> };
+	}
+
+	const size_t cell = toCellIndex(point);
+	const size_t begin = m_cellBegin[cell];
+	const size_t end = m_cellBegin[cell + 1];
+
+# if SIV3D_INTRINSIC(SSE)
+
+	const __m128d px = _mm_set1_pd(point.x);
+	const __m128d py = _mm_set1_pd(point.y);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+
+	__m128d bestDistanceSq = _mm_set1_pd(Largest<double>);
+	__m128d bestIndex = _mm_setzero_pd();
+	__m128d index = _mm_set_pd(static_cast<double>(begin + 1), static_cast<double>(begin));
+
+	for (size_t i = begin; i < end; i += 2)
+	{
+		const __m128d ax = _mm_loadu_pd(m_ax.data() + i);
+		const __m128d ay = _mm_loadu_pd(m_ay.data() + i);
+		const __m128d dx = _mm_loadu_pd(m_dx.data() + i);
+		const __m128d dy = _mm_loadu_pd(m_dy.data() + i);
+		const __m128d invLengthSq = _mm_loadu_pd(m_invLengthSq.data() + i);
+
+		// t = clamp(dot(p - a, d) / |d|^2, 0, 1)
+		const __m128d rx = _mm_sub_pd(px, ax);
+		const __m128d ry = _mm_sub_pd(py, ay);
+		__m128d t = _mm_mul_pd(_mm_add_pd(_mm_mul_pd(rx, dx), _mm_mul_pd(ry, dy)), invLengthSq);
+		t = _mm_min_pd(_mm_max_pd(t, zero), one);
+
+		// |p - (a + t * d)|^2
+		const __m128d ex = _mm_sub_pd(rx, _mm_mul_pd(t, dx));
+		const __m128d ey = _mm_sub_pd(ry, _mm_mul_pd(t, dy));
+		const __m128d distanceSq = _mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey));
+
+		const __m128d closer = _mm_cmplt_pd(distanceSq, bestDistanceSq);
+		bestDistanceSq = _mm_or_pd(_mm_and_pd(closer, distanceSq), _mm_andnot_pd(closer, bestDistanceSq));
+		bestIndex = _mm_or_pd(_mm_and_pd(closer, index), _mm_andnot_pd(closer, bestIndex));
+		index = _mm_add_pd(index, two);
+	}
+
+	alignas(16) double distances[2];
+	alignas(16) double indices[2];
+	_mm_store_pd(distances, bestDistanceSq);
+	_mm_store_pd(indices, bestIndex);
+
+	const size_t lane = ((distances[1] < distances[0]) ? 1 : 0);
+	return{ static_cast<size_t>(indices[lane]), distances[lane] };
+
+# else
+
+	size_t bestIndex = begin;
+	double bestDistanceSq = Largest<double>;
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		const double distanceSq = point.distanceFromSq(closestPointOnEdge(i, point));
+
+		if (distanceSq < bestDistanceSq)
+		{
+			bestIndex = i;
+			bestDistanceSq = distanceSq;
+		}
+	}
+
+	return{ bestIndex, bestDistanceSq };
+
+# endif
+}
+
+Vec2 CircleCollider::closestPointOnEdge(const size_t index, const Vec2& point) const
+{
+	const Vec2 a{ m_ax[index], m_ay[index] };
+	const Vec2 d{ m_dx[index], m_dy[index] };
+	const double t = Clamp(((point - a).dot(d) * m_invLengthSq[index]), 0.0, 1.0);
+	return (a + d * t);
+}
+
+Vec2 CircleCollider::resolve(Vec2 center, const double radius) const
+{
+	const double radiusSq = (radius * radius);
+
+	// 最も近い辺から順に押し出す。法線方向の成分だけを取り除くので、接線方向には滑る
+	for (int32 i = 0; i < MaxResolveIterations; ++i)
+	{
+		const auto [index, distanceSq] = findClosestEdge(center);
+
+		if (radiusSq <= distanceSq)
+		{
+			break;
+		}
+
+		const Vec2 closest = closestPointOnEdge(index, center);
+		const Vec2 normal = (center - closest);
+		const double distance = Math::Sqrt(distanceSq);
+
+		if (distance <= 0.0)
+		{
+			break;
+		}
+
+		center = (closest + normal * ((radius + SkinWidth) / distance));
+	}
+
+	return center;
+}
@@ -0,0 +1,125 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 静的な壁（多角形）に対して円を移動させ、壁に沿って滑らせる運動学的な衝突解決
+/// @remark 壁の辺は一様グリッドのセルごとに SoA で保持し、円と辺の距離を SIMD でまとめて求めます。
+/// グリッドは build() で作るか、焼き込み済みのデータを逆シリアライズして読み込みます。
+class CircleCollider
+{
+public:
+
+	/// @brief build() で使うセルの一辺の長さの既定値
+	static constexpr double DefaultCellSize = 64.0;
+
+	/// @brief 検索できる円の半径の既定値。move() と intersects() に渡す半径はこれ以下でなければなりません
+	static constexpr double DefaultMargin = 32.0;
+
+	/// @brief すべての壁を削除します。
+	void clear();
+
+	/// @brief 多角形の壁を追加します。
+	/// @param polygon 壁の形状。穴は無視されます
+	/// @remark 追加したあとに build() を呼ぶまで衝突判定には反映されません。
+	void addPolygon(const Polygon& polygon);
+
+	/// @brief 四角形の壁を追加します。
+	/// @param quad 壁の形状
+	void addQuad(const Quad& quad);
+
+	/// @brief 長方形の壁を追加します。
+	/// @param center 中心の座標
+	/// @param size 大きさ
+	/// @param angle 中心を軸にした回転角度（ラジアン）
+	void addRect(const Vec2& center, const SizeF& size, double angle = 0.0);
+
+	/// @brief 壁の辺をグリッドに振り分けて、衝突判定の準備をします。
+	/// @param bounds 対象とする範囲。範囲外の点は最寄りのセルで判定されます
+	/// @param cellSize セルの一辺の長さ
+	/// @param margin 検索できる円の最大の半径
+	void build(const RectF& bounds, double cellSize = DefaultCellSize, double margin = DefaultMargin);
+
+	/// @brief 逆シリアライズしたあとに呼び、描画用の Polygon を復元します。
+	void restoreWalls();
+
+	/// @brief 壁の一覧を返します。
+	[[nodiscard]]
+	const Array<Polygon>& walls() const noexcept;
+
+	/// @brief build() で指定した範囲を返します。
+	[[nodiscard]]
+	const RectF& bounds() const noexcept;
+
+	/// @brief 円が壁と重なっているかを返します。
+	[[nodiscard]]
+	bool intersects(const Circle& circle) const;
+
+	/// @brief 円を移動させ、壁にめり込まないように壁に沿って滑らせた位置を返します。
+	/// @param center 移動前の円の中心（壁と重なっていないこと）
+	/// @param radius 円の半径
+	/// @param displacement 移動量
+	/// @return 移動後の円の中心
+	/// @remark 1 回の移動が半径の半分を超えないように分割するため、速く動いても壁をすり抜けません。
+	[[nodiscard]]
+	Vec2 move(const Vec2& center, double radius, const Vec2& displacement) const;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(m_wallOuters, m_wallIndices, m_bounds, m_cellSize, m_margin, m_columns, m_rows, m_cellBegin, m_ax, m_ay, m_dx, m_dy, m_invLengthSq);
+	}
+
+private:
+
+	/// @brief 1 回の移動で行う押し出しの最大回数（角で 2 枚の壁に接する場合を解決できる回数）
+	static constexpr int32 MaxResolveIterations = 4;
+
+	Array<Polygon> m_walls;
+
+	/// @brief 壁の外周の頂点（シリアライズ用）
+	Array<Array<Vec2>> m_wallOuters;
+
+	/// @brief 壁の三角形分割のインデックス（シリアライズ用）
+	Array<Array<uint16>> m_wallIndices;
+
+	RectF m_bounds{ 0, 0, 0, 0 };
+
+	double m_cellSize = DefaultCellSize;
+
+	double m_margin = DefaultMargin;
+
+	int32 m_columns = 0;
+
+	int32 m_rows = 0;
+
+	/// @brief セル i の辺は [m_cellBegin[i], m_cellBegin[i + 1]) 。SIMD のため各セルの辺の数は偶数にそろえる
+	Array<uint32> m_cellBegin;
+
+	// 辺 i は (m_ax[i], m_ay[i]) から (m_ax[i] + m_dx[i], m_ay[i] + m_dy[i]) まで
+	Array<double> m_ax;
+
+	Array<double> m_ay;
+
+	Array<double> m_dx;
+
+	Array<double> m_dy;
+
+	Array<double> m_invLengthSq;
+
+	void pushEdge(const Vec2& a, const Vec2& b);
+
+	void pushPadding();
+
+	[[nodiscard]]
+	size_t toCellIndex(const Vec2& point) const;
+
+	/// @brief 点に最も近い辺を求めます。
+	/// @return 辺のインデックスと距離の二乗。点から margin 以内に辺がない場合、距離の二乗は Largest<double>
+	[[nodiscard]]
+	std::pair<size_t, double> findClosestEdge(const Vec2& point) const;
+
+	[[nodiscard]]
+	Vec2 closestPointOnEdge(size_t index, const Vec2& point) const;
+
+	[[nodiscard]]
+	Vec2 resolve(Vec2 center, double radius) const;
+};
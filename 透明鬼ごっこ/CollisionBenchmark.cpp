@@ -0,0 +1,184 @@
+﻿# include "CollisionBenchmark.hpp"
+# include "CircleCollider.hpp"
+# include "BenchmarkStats.hpp"
+
+namespace
+{
+	constexpr double BodyRadius = 15.0;
+
+	constexpr double Speed = 200.0;
+
+	constexpr double FrameTime = (1.0 / 60.0);
+
+	/// @brief 置き換え前の P2World の更新間隔
+	constexpr double P2StepTime = (1.0 / 200.0);
+
+	/// @brief 同じ位置から同じ入力で 1 フレーム動かしたときの、移動量のずれの許容値（ピクセル）
+	/// @remark P2World は 5 ms 単位でしか進まないため、1 フレームの移動量は最大で 1 ステップ分ずれます。
+	/// 壁に接したときは押し戻しが 1 ステップ遅れることがあるので、もう 1 ステップ分を足します。
+	constexpr double ParityTolerance = (Speed * P2StepTime * 2);
+
+	struct ParityResult
+	{
+		double maxDeviation = 0.0;
+
+		double meanDeviation = 0.0;
+
+		BenchmarkStats p2Stats;
+
+		BenchmarkStats colliderStats;
+	};
+
+	/// @brief 同じ入力で P2World と CircleCollider を動かし、移動量のずれと所要時間を計測します。
+	/// @remark 毎フレーム P2World の円を CircleCollider の位置に合わせ直すため、ずれは 1 フレーム分の移動量の差です。
+	[[nodiscard]]
+	ParityResult RunParity(const CircleCollider& collider, const Array<Vec2>& starts, const int32 walkers, const int32 frames)
+	{
+		constexpr int32 FramesPerInput = 30;
+
+		P2World world{ Vec2{ 0, 0 } };
+
+		for (const auto& wall : collider.walls())
+		{
+			world.createPolygon(P2Static, Vec2{ 0, 0 }, wall);
+		}
+
+		// 歩く円どうしは衝突させない
+		const P2Filter walkerFilter{ .categoryBits = 0b10, .maskBits = 0b01 };
+
+		Array<P2Body> bodies;
+		Array<Vec2> positions;
+		Array<Vec2> velocities(walkers);
+
+		for (int32 i = 0; i < walkers; ++i)
+		{
+			const Vec2 pos = starts[i];
+			bodies << world.createCircle(P2Dynamic, pos, BodyRadius, P2Material{}, walkerFilter).setFixedRotation(true);
+			positions << pos;
+		}
+
+		ParityResult result;
+		result.p2Stats.reserve(frames);
+		result.colliderStats.reserve(frames);
+
+		double accumulatedTime = 0.0;
+		double deviationSum = 0.0;
+		size_t deviationCount = 0;
+
+		for (int32 frame = 0; frame < frames; ++frame)
+		{
+			if ((frame % FramesPerInput) == 0)
+			{
+				for (int32 i = 0; i < walkers; ++i)
+				{
+					velocities[i] = (BenchmarkRun::RandomDirection() * Speed);
+				}
+			}
+
+			{
+				const uint64 begin = Time::GetNanosec();
+
+				// 差が積み重ならないように、毎フレーム同じ位置から動かす
+				for (int32 i = 0; i < walkers; ++i)
+				{
+					bodies[i].setPos(positions[i]).setVelocity(velocities[i]);
+				}
+
+				for (accumulatedTime += FrameTime; accumulatedTime >= P2StepTime; accumulatedTime -= P2StepTime)
+				{
+					world.update(P2StepTime);
+				}
+
+				result.p2Stats.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+			}
+
+			{
+				const uint64 begin = Time::GetNanosec();
+
+				for (int32 i = 0; i < walkers; ++i)
+				{
+					positions[i] = collider.move(positions[i], BodyRadius, (velocities[i] * FrameTime));
+				}
+
+				result.colliderStats.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+			}
+
+			for (int32 i = 0; i < walkers; ++i)
+			{
+				const double deviation = positions[i].distanceFrom(bodies[i].getPos());
+				result.maxDeviation = Max(result.maxDeviation, deviation);
+				deviationSum += deviation;
+			}
+
+			deviationCount += walkers;
+		}
+
+		result.meanDeviation = (deviationCount ? (deviationSum / deviationCount) : 0.0);
+		return result;
+	}
+
+	/// @brief CircleCollider だけで多数の円を動かしたときの所要時間を計測します。
+	[[nodiscard]]
+	BenchmarkStats RunScale(const CircleCollider& collider, const Array<Vec2>& starts, const int32 circles, const int32 frames)
+	{
+		Array<Vec2> positions(starts.begin(), (starts.begin() + circles));
+		Array<Vec2> velocities(circles, Arg::generator = []() { return (BenchmarkRun::RandomDirection() * Speed); });
+
+		BenchmarkStats stats;
+		stats.reserve(frames);
+
+		for (int32 frame = 0; frame < frames; ++frame)
+		{
+			const uint64 begin = Time::GetNanosec();
+
+			for (int32 i = 0; i < circles; ++i)
+			{
+				positions[i] = collider.move(positions[i], BodyRadius, (velocities[i] * FrameTime));
+			}
+
+			stats.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+		}
+
+		return stats;
+	}
+}
+
+bool RunCollisionBenchmark(const CircleCollider& collider, const Optional<FilePath>& jsonPath)
+{
+	constexpr int32 Walkers = 64;
+	constexpr int32 ParityFrames = 1200;
+	constexpr int32 ScaleCircles = 1000;
+	constexpr int32 ScaleFrames = 600;
+
+	BenchmarkRun::Begin();
+
+	const Optional<Array<Vec2>> starts = BenchmarkRun::RandomFreePositions(collider, BodyRadius, Max(Walkers, ScaleCircles));
+
+	if (not starts)
+	{
+		Console << U"[collision-bench] the level has no free space for the circles";
+		return false;
+	}
+
+	const ParityResult parity = RunParity(collider, *starts, Walkers, ParityFrames);
+	const BenchmarkStats scale = RunScale(collider, *starts, ScaleCircles, ScaleFrames);
+
+	const bool passed = (parity.maxDeviation <= ParityTolerance);
+
+	JSON summary;
+	summary[U"walkers"] = Walkers;
+	summary[U"parity_frames"] = ParityFrames;
+	summary[U"parity_max_px"] = parity.maxDeviation;
+	summary[U"parity_mean_px"] = parity.meanDeviation;
+	summary[U"parity_tolerance_px"] = ParityTolerance;
+	summary[U"parity_check"] = (passed ? U"passed" : U"failed");
+	summary[U"p2world"] = parity.p2Stats.toJSON();
+	summary[U"collider"] = parity.colliderStats.toJSON();
+	summary[U"scale_circles"] = ScaleCircles;
+	summary[U"scale"] = scale.toJSON();
+	summary[U"scale_us_per_circle"] = ((scale.percentile(0.5) * 1000.0) / ScaleCircles);
+
+	BenchmarkRun::Finish(summary, jsonPath);
+
+	return passed;
+}
@@ -0,0 +1,10 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+class CircleCollider;
+
+/// @brief CircleCollider と P2World の挙動の一致を確かめ、両者の速度を計測して結果をコンソールに出力します。
+/// @param collider 焼き込み済みの壁
+/// @param jsonPath 結果の JSON の保存先。none の場合は保存しません
+/// @return 挙動の一致の検査に合格した場合 true, それ以外の場合は false
+bool RunCollisionBenchmark(const CircleCollider& collider, const Optional<FilePath>& jsonPath);
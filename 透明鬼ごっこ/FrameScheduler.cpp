@@ -0,0 +1,85 @@
+﻿# include "FrameScheduler.hpp"
+
+namespace
+{
+	/// @brief フレームの待ち時間のうち、これより短い分はスリープの精度が足りないので空回りで待つ（マイクロ秒）
+	constexpr uint64 SpinMicrosec = 2000;
+}
+
+FrameScheduler::FrameScheduler(const Config& config)
+	: m_config{ config }
+{
+	m_config.simulationHz = Max(m_config.simulationHz, 1.0);
+	m_config.networkHz = Max(m_config.networkHz, 1.0);
+	m_config.maxStepsPerFrame = Max(m_config.maxStepsPerFrame, 1);
+}
+
+FrameScheduler::Steps FrameScheduler::advance(const double deltaTime)
+{
+	Steps steps;
+
+	const double simulationDelta = (1.0 / m_config.simulationHz);
+	m_simulationAccumulator += Max(deltaTime, 0.0);
+
+	while ((simulationDelta <= m_simulationAccumulator) and (steps.simulation < m_config.maxStepsPerFrame))
+	{
+		m_simulationAccumulator -= simulationDelta;
+		++steps.simulation;
+	}
+
+	// 上限まで進めても残っている分は、追いつこうとせずに捨てる
+	if (simulationDelta <= m_simulationAccumulator)
+	{
+		m_droppedTicks += static_cast<uint64>(m_simulationAccumulator / simulationDelta);
+		m_simulationAccumulator = Math::Fmod(m_simulationAccumulator, simulationDelta);
+	}
+
+	steps.alpha = (m_simulationAccumulator / simulationDelta);
+
+	// ネットワークはティックを溜めても意味がないので、1 フレームに最大 1 回分だけ持ち越す
+	const double networkDelta = (1.0 / m_config.networkHz);
+	m_networkAccumulator = Min((m_networkAccumulator + Max(deltaTime, 0.0)), (networkDelta * 2));
+
+	while (networkDelta <= m_networkAccumulator)
+	{
+		m_networkAccumulator -= networkDelta;
+		++steps.network;
+	}
+
+	return steps;
+}
+
+double FrameScheduler::simulationDelta() const noexcept
+{
+	return (1.0 / m_config.simulationHz);
+}
+
+uint64 FrameScheduler::droppedTicks() const noexcept
+{
+	return m_droppedTicks;
+}
+
+void FrameScheduler::waitForNextFrame()
+{
+	if (m_config.frameLimitHz <= 0.0)
+	{
+		return;
+	}
+
+	const uint64 frameMicrosec = static_cast<uint64>(1'000'000 / m_config.frameLimitHz);
+	const uint64 deadline = (m_lastFrameMicrosec + frameMicrosec);
+	uint64 now = Time::GetMicrosec();
+
+	while (now < deadline)
+	{
+		if (SpinMicrosec < (deadline - now))
+		{
+			System::Sleep(1);
+		}
+
+		now = Time::GetMicrosec();
+	}
+
+	// 大きく遅れたときは、遅れを取り戻そうとせずに今から数え直す
+	m_lastFrameMicrosec = (((deadline + frameMicrosec) < now) ? now : deadline);
+}
@@ -0,0 +1,75 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief シミュレーションとネットワークを固定のティックで、描画を画面のリフレッシュレートで回すスケジューラ
+/// @remark フレームごとに advance() を呼ぶと、そのフレームで進めるティックの数が返ります。
+/// 処理が追いつかないときに、ティックの処理がさらに時間を食って遅れが膨らみ続けないよう（spiral of death）、
+/// 1 フレームで進めるティックの数に上限を設け、あふれた時間は捨てます。
+class FrameScheduler
+{
+public:
+
+	struct Config
+	{
+		/// @brief シミュレーションのティックレート（Hz）
+		double simulationHz = 60.0;
+
+		/// @brief ネットワークの送受信のティックレート（Hz）
+		double networkHz = 60.0;
+
+		/// @brief 1 フレームで進めるシミュレーションのティックの上限
+		int32 maxStepsPerFrame = 5;
+
+		/// @brief 描画のフレームレートの上限（Hz）。0 なら制限しない
+		double frameLimitHz = 0.0;
+	};
+
+	/// @brief 1 フレームで進めるもの
+	struct Steps
+	{
+		/// @brief 進めるシミュレーションのティックの数
+		int32 simulation = 0;
+
+		/// @brief 進めるネットワークのティックの数
+		int32 network = 0;
+
+		/// @brief 描画に使う、直前のティックから最新のティックへの補間の割合 [0, 1]
+		double alpha = 1.0;
+	};
+
+	SIV3D_NODISCARD_CXX20
+	FrameScheduler() = default;
+
+	SIV3D_NODISCARD_CXX20
+	explicit FrameScheduler(const Config& config);
+
+	/// @brief 経過時間を積み、このフレームで進めるティックの数を返します。
+	/// @param deltaTime 前のフレームからの経過時間（秒）
+	[[nodiscard]]
+	Steps advance(double deltaTime);
+
+	/// @brief シミュレーションの 1 ティックの長さ（秒）を返します。
+	[[nodiscard]]
+	double simulationDelta() const noexcept;
+
+	/// @brief 追いつけずに捨てたシミュレーションのティックの数を返します。
+	[[nodiscard]]
+	uint64 droppedTicks() const noexcept;
+
+	/// @brief フレームレートの上限が設定されていれば、次のフレームの時刻まで待ちます。
+	/// @remark System::Update() の直前に呼んでください。
+	void waitForNextFrame();
+
+private:
+
+	Config m_config;
+
+	double m_simulationAccumulator = 0.0;
+
+	double m_networkAccumulator = 0.0;
+
+	uint64 m_droppedTicks = 0;
+
+	/// @brief 前のフレームの開始時刻（マイクロ秒）
+	uint64 m_lastFrameMicrosec = 0;
+};
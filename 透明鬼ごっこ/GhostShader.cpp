@@ -0,0 +1,112 @@
+﻿# include "GhostShader.hpp"
+# include "SpriteBatch.hpp"
+
+namespace
+{
+	/// @brief 時刻の基準からこれ以上離れたら付け替える（ミリ秒）。1 時間なら float でも 1 ミリ秒未満の精度がある
+	constexpr int32 MaxEpochAgeMillisec = (60 * 60 * 1000);
+}
+
+GhostShader::GhostShader(const ServerClock& clock)
+	: m_clock{ &clock }
+	, m_pixelShader{ HLSL{ Resource(U"shader/ghost.hlsl"), U"PS" }
+		| GLSL{ Resource(U"shader/ghost.frag"), { { U"PSConstants2D", 0 }, { U"GhostConstants", 1 } } } }
+{
+	if (not m_pixelShader)
+	{
+		throw Error{ U"Failed to load the ghost shader" };
+	}
+}
+
+void GhostShader::begin(const double stillSeconds)
+{
+	const int32 now = m_clock->nowMillisec();
+
+	if (not InRange(ServerClock::Diff(now, m_epochMillisec), 0, MaxEpochAgeMillisec))
+	{
+		m_epochMillisec = now;
+	}
+
+	m_frame = Float4{ toSeconds(now), static_cast<float>(stillSeconds), 0.0f, 0.0f };
+	m_count = 0;
+}
+
+uint32 GhostShader::add(const ServerTimer& fade, const ServerTimer& slowdown, const uint32 flags)
+{
+	const uint32 slot = static_cast<uint32>(m_count++);
+	const size_t page = PageOf(slot);
+
+	if (m_pages.size() <= page)
+	{
+		m_pages.emplace_back();
+	}
+
+	ConstantBuffer<GhostConstants>& constants = m_pages[page];
+	const size_t index = (slot % MaxGhosts);
+
+	if (index == 0)
+	{
+		constants->frame = m_frame;
+	}
+
+	// 開始していないタイマーは長さ 0 として渡す（ServerTimer::progress1_0() が 0 を返すのと同じ）
+	const float fadeDuration = (fade.isStarted() ? static_cast<float>(fade.duration().count()) : 0.0f);
+	const float slowdownDuration = (slowdown.isStarted() ? static_cast<float>(slowdown.duration().count()) : 0.0f);
+
+	constants->ghosts[index * 2] = Float4{ toSeconds(fade.deadlineMillisec()), fadeDuration,
+		toSeconds(slowdown.deadlineMillisec()), slowdownDuration };
+	constants->ghosts[index * 2 + 1] = Float4{ static_cast<float>(flags), 0.0f, 0.0f, 0.0f };
+
+	return slot;
+}
+
+size_t GhostShader::pageCount() const noexcept
+{
+	return ((m_count + MaxGhosts - 1) / MaxGhosts);
+}
+
+ColorF GhostShader::VertexColor(const uint32 slot, const ColorF& tint, const bool isBody)
+{
+	// シェーダはページの中のスロット番号で定数バッファを引く
+	return ColorF{ tint.r, tint.g, tint.b, static_cast<double>((slot % MaxGhosts) * 2 + (isBody ? 1 : 0)) };
+}
+
+double GhostShader::Alpha(const ServerTimer& fade, const uint32 flags, const double stillSeconds)
+{
+	// ghost.hlsl の PS と同じ
+	double alpha = ((flags & Transparent) ? fade.progress1_0() : fade.progress0_1());
+
+	if (flags & Self)
+	{
+		return (alpha * 0.75 + 0.25);
+	}
+
+	if ((flags & Transparent) and (1.0 < stillSeconds))
+	{
+		alpha = Min((stillSeconds - 1.0), 0.5);
+	}
+
+	if (flags & Dimmed)
+	{
+		alpha = Math::Lerp(0.5, 1.0, alpha);
+	}
+
+	return alpha;
+}
+
+const PixelShader& GhostShader::pixelShader() const noexcept
+{
+	return m_pixelShader;
+}
+
+void GhostShader::draw(const size_t page, const SpriteBatch& batch) const
+{
+	Graphics2D::SetPSConstantBuffer(1, m_pages[page]);
+
+	batch.draw();
+}
+
+float GhostShader::toSeconds(const int32 serverMillisec) const noexcept
+{
+	return static_cast<float>(ServerClock::Diff(serverMillisec, m_epochMillisec) / 1000.0);
+}
@@ -0,0 +1,118 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "ServerClock.hpp"
+
+class SpriteBatch;
+
+/// @brief ゴーストのフェード・鈍足の色の明滅・透明化を GPU で計算するピクセルシェーダ（App/shader/ghost.hlsl）
+/// @remark CPU はゴーストごとにタイマーの締め切りとフラグを定数バッファのスロットに書くだけです。
+/// スプライトの頂点色の rgb に色、a にスロット番号と胴体かどうかを入れて SpriteBatch に追加し、pixelShader() を設定した状態で draw() すると 1 回で描けます。
+/// MaxGhosts 体を超えると次のページの定数バッファに入るため、ページごとに SpriteBatch を分けて draw() します。
+class GhostShader
+{
+public:
+
+	/// @brief 1 ページ（1 回の描画）で扱えるゴーストの数。シェーダの MAX_GHOSTS と合わせる
+	static constexpr size_t MaxGhosts = 64;
+
+	/// @brief ゴーストの状態。シェーダの Flag* と合わせる
+	enum Flag : uint32
+	{
+		/// @brief 透明化している（フェードアウト）
+		Transparent = 1,
+
+		/// @brief 鈍足で、胴体の明るさが明滅する
+		Slowdown = 2,
+
+		/// @brief 自分自身。見えなくならないよう不透明度を 0.25 以上にする
+		Self = 4,
+
+		/// @brief 鬼でない人から見た鬼以外のゴースト。不透明度を 0.5 以上にする
+		Dimmed = 8,
+	};
+
+	SIV3D_NODISCARD_CXX20
+	GhostShader() = default;
+
+	/// @brief シェーダを読み込みます。
+	/// @param clock タイマーの基準となるサーバ時計
+	/// @throw Error 読み込めなかった場合
+	SIV3D_NODISCARD_CXX20
+	explicit GhostShader(const ServerClock& clock);
+
+	/// @brief フレームの描画を始め、スロットを空にします。
+	/// @param stillSeconds 見ている人が止まっている秒数。止まっていると透明なゴーストが見えてくる
+	void begin(double stillSeconds);
+
+	/// @brief ゴーストを 1 体追加します。ページが埋まっていたら次のページに入れます。
+	/// @param fade 透明化・実体化のフェードのタイマー
+	/// @param slowdown 鈍足のタイマー
+	/// @param flags Flag の組み合わせ
+	/// @return スロット番号。PageOf() でページがわかります
+	uint32 add(const ServerTimer& fade, const ServerTimer& slowdown, uint32 flags);
+
+	/// @brief このフレームで使っているページの数を返します。
+	[[nodiscard]]
+	size_t pageCount() const noexcept;
+
+	/// @brief スロットが入っているページを返します。
+	/// @param slot add() が返したスロット番号
+	[[nodiscard]]
+	static constexpr size_t PageOf(uint32 slot) noexcept
+	{
+		return (slot / MaxGhosts);
+	}
+
+	/// @brief スプライトの頂点色を返します。
+	/// @param slot add() が返したスロット番号
+	/// @param tint 色。アルファは使いません
+	/// @param isBody 胴体か。鈍足の明滅は胴体にだけかかります
+	[[nodiscard]]
+	static ColorF VertexColor(uint32 slot, const ColorF& tint, bool isBody);
+
+	/// @brief シェーダと同じ式で不透明度を計算します。
+	/// @remark 名前のラベルのように、このシェーダで描けないものに使います。
+	/// @param fade 透明化・実体化のフェードのタイマー
+	/// @param flags Flag の組み合わせ
+	/// @param stillSeconds 見ている人が止まっている秒数
+	[[nodiscard]]
+	static double Alpha(const ServerTimer& fade, uint32 flags, double stillSeconds);
+
+	/// @brief ピクセルシェーダを返します。
+	[[nodiscard]]
+	const PixelShader& pixelShader() const noexcept;
+
+	/// @brief ページの定数バッファを送り、batch を描画します。
+	/// @param page ページ
+	/// @param batch そのページのスロットのゴーストだけを追加したバッチ
+	/// @remark pixelShader() を ScopedCustomShader2D（または RenderQueue）で設定した状態で呼んでください。
+	void draw(size_t page, const SpriteBatch& batch) const;
+
+private:
+
+	struct GhostConstants
+	{
+		/// @brief x: サーバ時刻（秒）, y: 見ている人が止まっている秒数
+		Float4 frame;
+
+		/// @brief [slot * 2]: フェードの締め切り・長さ、鈍足の締め切り・長さ（秒）, [slot * 2 + 1]: x: フラグ
+		Float4 ghosts[MaxGhosts * 2];
+	};
+
+	const ServerClock* m_clock = nullptr;
+
+	PixelShader m_pixelShader;
+
+	/// @brief ページごとの定数バッファ。足りなくなったら増やし、次のフレームでも使い回す
+	Array<ConstantBuffer<GhostConstants>> m_pages;
+
+	Float4 m_frame{ 0, 0, 0, 0 };
+
+	/// @brief シェーダに渡す時刻の基準。float の精度が足りるように、離れすぎたら付け替える
+	int32 m_epochMillisec = 0;
+
+	size_t m_count = 0;
+
+	[[nodiscard]]
+	float toSeconds(int32 serverMillisec) const noexcept;
+};
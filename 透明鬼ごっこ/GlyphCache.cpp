@@ -0,0 +1,467 @@
+﻿# include "GlyphCache.hpp"
+
+namespace
+{
+	constexpr uint32 GlyphCacheMagic = 0x43475454; // "TTGC"
+
+	/// @brief アトラスのグリフどうしの隙間（ピクセル）
+	constexpr int32 Padding = 1;
+
+	/// @brief 最初に確保するアトラスの高さ（ピクセル）
+	constexpr int32 InitialAtlasHeight = 256;
+
+	[[nodiscard]]
+	FilePath Directory()
+	{
+		return (FileSystem::GetFolderPath(SpecialFolder::LocalAppData) + U"TransparentTag/glyphs/");
+	}
+}
+
+GlyphCache::GlyphCache(const FontMethod method, const int32 fontSize, const Typeface typeface)
+	: m_method{ method }
+	, m_fontSize{ fontSize }
+	, m_typeface{ typeface }
+{
+	const FilePath cachePath = path();
+
+	if (not FileSystem::Exists(cachePath))
+	{
+		return;
+	}
+
+	MemoryMappedFileView file{ cachePath };
+
+	if (not file)
+	{
+		return;
+	}
+
+	const MemoryMappedFileView::MappedMemory mapped = file.mapAll();
+
+	if ((not mapped.data) or (not load(mapped.data, mapped.size)))
+	{
+		// 壊れている・形式が古いキャッシュは捨てて作り直す
+		clear();
+		m_height = 0.0;
+		return;
+	}
+
+	m_texture = Texture{ m_atlas };
+}
+
+Optional<Array<Glyph>> GlyphCache::getGlyphs(const StringView text)
+{
+	if (m_fontSize == 0)
+	{
+		return none;
+	}
+
+	Array<Glyph> glyphs(Arg::reserve = text.size());
+	bool complete = true;
+
+	for (const char32 ch : text)
+	{
+		if (const auto it = m_entries.find(ch); it != m_entries.end())
+		{
+			glyphs << makeGlyph(ch, it->second);
+		}
+		else
+		{
+			if (not m_inFlight.contains(ch))
+			{
+				m_requested.emplace(ch);
+			}
+
+			complete = false;
+		}
+	}
+
+	if (not complete)
+	{
+		return none;
+	}
+
+	return glyphs;
+}
+
+bool GlyphCache::contains(const StringView text) const
+{
+	return std::all_of(text.begin(), text.end(), [&](const char32 ch) { return ((ch == U'\n') or m_entries.contains(ch)); });
+}
+
+void GlyphCache::request(const StringView text)
+{
+	if (m_fontSize == 0)
+	{
+		return;
+	}
+
+	for (const char32 ch : text)
+	{
+		if ((ch != U'\n') and (not m_entries.contains(ch)) and (not m_inFlight.contains(ch)))
+		{
+			m_requested.emplace(ch);
+		}
+	}
+}
+
+bool GlyphCache::drawAt(const StringView text, const Vec2& center, const ColorF& color)
+{
+	if (m_fontSize == 0)
+	{
+		return false;
+	}
+
+	// 1 回目で全部そろっているかと大きさを調べ、そろっていれば 2 回目で描く
+	bool complete = true;
+	double width = 0.0;
+	double lineWidth = 0.0;
+	size_t lines = 1;
+
+	for (const char32 ch : text)
+	{
+		if (ch == U'\n')
+		{
+			width = Max(width, lineWidth);
+			lineWidth = 0.0;
+			++lines;
+			continue;
+		}
+
+		if (const auto it = m_entries.find(ch); it != m_entries.end())
+		{
+			lineWidth += it->second.info.xAdvance;
+		}
+		else
+		{
+			if (not m_inFlight.contains(ch))
+			{
+				m_requested.emplace(ch);
+			}
+
+			complete = false;
+		}
+	}
+
+	if (not complete)
+	{
+		return false;
+	}
+
+	width = Max(width, lineWidth);
+
+	// Font の drawAt と同じく、全体の中心を合わせて各行は左揃えにする
+	const Vec2 topLeft = (center - Vec2{ width, (m_height * lines) } / 2);
+	Vec2 pen = topLeft;
+
+	for (const char32 ch : text)
+	{
+		if (ch == U'\n')
+		{
+			pen = Vec2{ topLeft.x, (pen.y + m_height) };
+			continue;
+		}
+
+		const Entry& entry = m_entries.find(ch)->second;
+
+		if (entry.region.area())
+		{
+			m_texture(entry.region).draw(pen + makeGlyph(ch, entry).getOffset(), color);
+		}
+
+		pen.x += entry.info.xAdvance;
+	}
+
+	return true;
+}
+
+bool GlyphCache::update()
+{
+	bool added = false;
+
+	if (m_task.isReady())
+	{
+		Batch batch = m_task.get();
+		m_font = std::move(batch.font);
+		m_height = batch.height;
+
+		for (const auto& rendered : batch.glyphs)
+		{
+			Optional<Rect> region = pack(rendered.image);
+
+			if (not region)
+			{
+				// 上限まで埋まったら捨てる。使っている文字は描くときにまた依頼されるので、よく使う文字だけが残っていく
+				clear();
+				region = pack(rendered.image);
+			}
+
+			m_entries[rendered.codePoint] = Entry{ rendered.info, region.value_or(Rect{ 0, 0, 0, 0 }) };
+		}
+
+		m_inFlight.clear();
+		m_texture = Texture{ m_atlas };
+		++m_revision;
+		m_dirty = true;
+		added = true;
+	}
+
+	if ((not m_task.isValid()) and (not m_requested.empty()))
+	{
+		startTask();
+	}
+
+	return added;
+}
+
+bool GlyphCache::save()
+{
+	if (not m_dirty)
+	{
+		return true;
+	}
+
+	MemoryWriter writer;
+	writer.write(GlyphCacheMagic);
+	writer.write(Version);
+	writer.write(static_cast<uint32>(FromEnum(m_method)));
+	writer.write(m_fontSize);
+	writer.write(static_cast<uint32>(FromEnum(m_typeface)));
+	writer.write(m_height);
+	writer.write(m_atlas.height());
+	writer.write(m_cursor);
+	writer.write(m_shelfHeight);
+	writer.write(static_cast<uint32>(m_entries.size()));
+
+	for (const auto& [codePoint, entry] : m_entries)
+	{
+		writer.write(codePoint);
+		writer.write(entry.info);
+		writer.write(entry.region);
+	}
+
+	writer.write(m_atlas.data(), m_atlas.size_bytes());
+
+	FileSystem::CreateDirectories(Directory());
+
+	// 書き込み途中のファイルを読まないように、一時ファイルに書いてから移動する
+	const FilePath cachePath = path();
+	const FilePath temporary = (cachePath + U".tmp");
+
+	if (not writer.getBlob().save(temporary))
+	{
+		return false;
+	}
+
+	if (FileSystem::Exists(cachePath))
+	{
+		FileSystem::Remove(cachePath);
+	}
+
+	if (not FileSystem::Rename(temporary, cachePath))
+	{
+		return false;
+	}
+
+	m_dirty = false;
+	return true;
+}
+
+uint64 GlyphCache::revision() const noexcept
+{
+	return m_revision;
+}
+
+FontMethod GlyphCache::method() const noexcept
+{
+	return m_method;
+}
+
+int32 GlyphCache::fontSize() const noexcept
+{
+	return m_fontSize;
+}
+
+double GlyphCache::height() const noexcept
+{
+	return m_height;
+}
+
+size_t GlyphCache::size() const noexcept
+{
+	return m_entries.size();
+}
+
+FilePath GlyphCache::path() const
+{
+	return (Directory() + U"{}-{}-{}.ttglyph"_fmt(FromEnum(m_typeface), FromEnum(m_method), m_fontSize));
+}
+
+Glyph GlyphCache::makeGlyph(const char32 codePoint, const Entry& entry) const
+{
+	Glyph glyph;
+	static_cast<GlyphInfo&>(glyph) = entry.info;
+	glyph.codePoint = codePoint;
+	glyph.texture = m_texture(entry.region);
+	return glyph;
+}
+
+bool GlyphCache::load(const void* data, const size_t size)
+{
+	MemoryViewReader reader{ data, size };
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	uint32 method = 0;
+	int32 fontSize = 0;
+	uint32 typeface = 0;
+	int32 atlasHeight = 0;
+	uint32 count = 0;
+
+	if ((not reader.read(magic)) or (not reader.read(version)) or (not reader.read(method)) or (not reader.read(fontSize))
+		or (not reader.read(typeface)) or (not reader.read(m_height)) or (not reader.read(atlasHeight))
+		or (not reader.read(m_cursor)) or (not reader.read(m_shelfHeight)) or (not reader.read(count)))
+	{
+		return false;
+	}
+
+	if ((magic != GlyphCacheMagic) or (version != Version) or (method != static_cast<uint32>(FromEnum(m_method)))
+		or (fontSize != m_fontSize) or (typeface != static_cast<uint32>(FromEnum(m_typeface)))
+		or (atlasHeight < 0) or (MaxAtlasHeight < atlasHeight))
+	{
+		return false;
+	}
+
+	m_entries.reserve(count);
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		char32 codePoint = 0;
+		Entry entry;
+
+		if ((not reader.read(codePoint)) or (not reader.read(entry.info)) or (not reader.read(entry.region)))
+		{
+			return false;
+		}
+
+		m_entries.emplace(codePoint, entry);
+	}
+
+	if (atlasHeight == 0)
+	{
+		return true;
+	}
+
+	m_atlas = Image{ AtlasWidth, atlasHeight };
+
+	const int64 pixelBytes = static_cast<int64>(m_atlas.size_bytes());
+	return (reader.read(m_atlas.data(), pixelBytes) == pixelBytes);
+}
+
+Optional<Rect> GlyphCache::pack(const Image& image)
+{
+	if (not image)
+	{
+		return Rect{ 0, 0, 0, 0 };
+	}
+
+	// 棚に収まらなければ次の棚へ
+	if (AtlasWidth < (m_cursor.x + image.width()))
+	{
+		m_cursor = Point{ 0, (m_cursor.y + m_shelfHeight + Padding) };
+		m_shelfHeight = 0;
+	}
+
+	const Rect region{ m_cursor, image.size() };
+
+	if (MaxAtlasHeight < region.bottomY())
+	{
+		return none;
+	}
+
+	if (m_atlas.height() < region.bottomY())
+	{
+		int32 height = Max(m_atlas.height(), InitialAtlasHeight);
+
+		while (height < region.bottomY())
+		{
+			height *= 2;
+		}
+
+		height = Min(height, MaxAtlasHeight);
+
+		Image grown(AtlasWidth, height, Color{ 0, 0 });
+
+		if (m_atlas)
+		{
+			m_atlas.overwrite(grown, Point{ 0, 0 });
+		}
+
+		m_atlas = std::move(grown);
+	}
+
+	image.overwrite(m_atlas, region.pos);
+
+	m_cursor.x += (image.width() + Padding);
+	m_shelfHeight = Max(m_shelfHeight, image.height());
+
+	return region;
+}
+
+void GlyphCache::clear()
+{
+	m_entries.clear();
+	m_atlas = Image{};
+	m_cursor = Point{ 0, 0 };
+	m_shelfHeight = 0;
+}
+
+void GlyphCache::startTask()
+{
+	Array<char32> codePoints(m_requested.begin(), m_requested.end());
+	m_inFlight = std::move(m_requested);
+	m_requested.clear();
+
+	m_task = Async([font = m_font, method = m_method, fontSize = m_fontSize, typeface = m_typeface, codePoints = std::move(codePoints)]() mutable
+		{
+			// フォントを作ると書体のアーカイブを展開するので、メインスレッドではなくここで作る
+			if (not font)
+			{
+				font = Font{ method, fontSize, typeface };
+			}
+
+			Batch batch;
+			batch.height = font.height();
+			batch.glyphs.reserve(codePoints.size());
+
+			for (const char32 ch : codePoints)
+			{
+				const GlyphIndex glyphIndex = font.getGlyphIndex(ch);
+
+				switch (method)
+				{
+				case FontMethod::SDF:
+					{
+						SDFGlyph glyph = font.renderSDFByGlyphIndex(glyphIndex);
+						batch.glyphs << Rendered{ ch, glyph, std::move(glyph.image) };
+						break;
+					}
+				case FontMethod::MSDF:
+					{
+						MSDFGlyph glyph = font.renderMSDFByGlyphIndex(glyphIndex);
+						batch.glyphs << Rendered{ ch, glyph, std::move(glyph.image) };
+						break;
+					}
+				default:
+					{
+						BitmapGlyph glyph = font.renderBitmapByGlyphIndex(glyphIndex);
+						batch.glyphs << Rendered{ ch, glyph, std::move(glyph.image) };
+						break;
+					}
+				}
+			}
+
+			batch.font = std::move(font);
+			return batch;
+		});
+}
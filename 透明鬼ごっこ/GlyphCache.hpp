@@ -0,0 +1,165 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief フォントのグリフを 1 枚のアトラスに描きためて、ディスクにキャッシュする
+/// @remark キャッシュはフォント（書体・方式・大きさ）ごとに 1 ファイルで、グリフは文字とグリフ ID で引きます。
+/// 起動時にファイルをメモリマップして読むので、キャッシュにある文字はフォントを作らずに描けます。
+/// キャッシュにない文字はワーカースレッドでラスタライズし、update() でアトラスに取り込みます。
+/// 取り込むまでの間、getGlyphs() と drawAt() は描けないことを返すので、呼び出し側で後回しにしてください。
+/// アトラスが MaxAtlasHeight まで埋まったら、すべてのグリフを捨てて空のアトラスからやり直します。
+class GlyphCache
+{
+public:
+
+	/// @brief キャッシュファイルの形式のバージョン
+	static constexpr uint32 Version = 1;
+
+	/// @brief アトラスの幅（ピクセル）。高さは足りなくなったら 2 倍にする
+	static constexpr int32 AtlasWidth = 1024;
+
+	/// @brief アトラスの高さの上限（ピクセル）。Direct3D 10 以降で必ず作れるテクスチャの大きさ
+	static constexpr int32 MaxAtlasHeight = 8192;
+
+	SIV3D_NODISCARD_CXX20
+	GlyphCache() = default;
+
+	/// @brief キャッシュファイルがあれば読み込みます。
+	/// @param method フォントの方式
+	/// @param fontSize フォントの基準サイズ
+	/// @param typeface 書体。フォントはキャッシュにない文字を描くときに、ワーカースレッドで初めて作ります
+	SIV3D_NODISCARD_CXX20
+	GlyphCache(FontMethod method, int32 fontSize, Typeface typeface);
+
+	/// @brief テキストのグリフを返します。
+	/// @param text テキスト
+	/// @return すべてのグリフがキャッシュにあればグリフの一覧。なければ足りないグリフのラスタライズを依頼して none
+	[[nodiscard]]
+	Optional<Array<Glyph>> getGlyphs(StringView text);
+
+	/// @brief テキストのグリフ（改行を除く）がすべてキャッシュにあるかを返します。
+	/// @param text テキスト
+	[[nodiscard]]
+	bool contains(StringView text) const;
+
+	/// @brief テキストのうちキャッシュにないグリフのラスタライズを依頼します。
+	/// @param text テキスト
+	void request(StringView text);
+
+	/// @brief テキストを中心を指定して描きます。改行で複数行にできます。
+	/// @param text テキスト
+	/// @param center 描画する中心の位置
+	/// @param color 文字の色
+	/// @return 描いた場合 true, キャッシュにないグリフがあって描かなかった場合は false
+	bool drawAt(StringView text, const Vec2& center, const ColorF& color);
+
+	/// @brief ラスタライズが終わったグリフをアトラスに取り込み、待っている依頼があれば次を始めます。毎フレーム呼んでください。
+	/// @return グリフを取り込んだ場合 true
+	bool update();
+
+	/// @brief グリフが増えていれば、キャッシュファイルに保存します。
+	/// @return 保存に成功したか、保存するものがなかった場合 true
+	bool save();
+
+	/// @brief グリフを取り込むたびに増える番号を返します。getGlyphs() をやり直すかの判断に使います。
+	[[nodiscard]]
+	uint64 revision() const noexcept;
+
+	/// @brief フォントの方式を返します。
+	[[nodiscard]]
+	FontMethod method() const noexcept;
+
+	/// @brief フォントの基準サイズを返します。
+	[[nodiscard]]
+	int32 fontSize() const noexcept;
+
+	/// @brief 1 行の高さを返します。まだ分からない場合は 0
+	[[nodiscard]]
+	double height() const noexcept;
+
+	/// @brief キャッシュにあるグリフの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief キャッシュファイルのパスを返します。
+	[[nodiscard]]
+	FilePath path() const;
+
+private:
+
+	struct Entry
+	{
+		GlyphInfo info;
+
+		/// @brief アトラスの中での範囲。空白のように画像がないグリフは大きさ 0
+		Rect region{ 0, 0, 0, 0 };
+	};
+
+	struct Rendered
+	{
+		char32 codePoint = 0;
+
+		GlyphInfo info;
+
+		Image image;
+	};
+
+	struct Batch
+	{
+		/// @brief ワーカースレッドで作ったフォント。次の依頼でも使う
+		Font font;
+
+		double height = 0.0;
+
+		Array<Rendered> glyphs;
+	};
+
+	FontMethod m_method = FontMethod::Bitmap;
+
+	int32 m_fontSize = 0;
+
+	Typeface m_typeface = Typeface::Regular;
+
+	double m_height = 0.0;
+
+	HashTable<char32, Entry> m_entries;
+
+	Image m_atlas;
+
+	Texture m_texture;
+
+	/// @brief 棚詰めの次の位置と、今の棚の高さ
+	Point m_cursor{ 0, 0 };
+
+	int32 m_shelfHeight = 0;
+
+	/// @brief まだワーカーに渡していない依頼
+	HashSet<char32> m_requested;
+
+	/// @brief ワーカーに渡した依頼
+	HashSet<char32> m_inFlight;
+
+	AsyncTask<Batch> m_task;
+
+	/// @brief ワーカーが前回作ったフォント
+	Font m_font;
+
+	uint64 m_revision = 0;
+
+	bool m_dirty = false;
+
+	[[nodiscard]]
+	Glyph makeGlyph(char32 codePoint, const Entry& entry) const;
+
+	/// @brief キャッシュファイルを読み込みます。
+	bool load(const void* data, size_t size);
+
+	/// @brief グリフの画像をアトラスに詰め、範囲を返します。
+	/// @return 範囲。アトラスが上限の高さまで埋まっていて詰められない場合は none
+	[[nodiscard]]
+	Optional<Rect> pack(const Image& image);
+
+	/// @brief すべてのグリフとアトラスを捨てます。
+	void clear();
+
+	void startTask();
+};
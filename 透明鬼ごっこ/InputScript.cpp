@@ -0,0 +1,98 @@
+﻿# include "InputScript.hpp"
+
+InputScript::InputScript(Array<Segment> segments, const bool loop)
+	: m_segments{ std::move(segments) }
+	, m_loop{ loop }
+{
+	m_segments.remove_if([](const Segment& segment) { return (segment.seconds <= 0.0); });
+	m_ends.reserve(m_segments.size());
+
+	double end = 0.0;
+
+	for (const auto& segment : m_segments)
+	{
+		end += segment.seconds;
+		m_ends << end;
+	}
+}
+
+Optional<InputScript> InputScript::Load(const FilePathView path)
+{
+	const JSON json = JSON::Load(path);
+
+	if ((not json) or (not json.hasElement(U"segments")) or (not json[U"segments"].isArray()))
+	{
+		return none;
+	}
+
+	Array<Segment> segments;
+
+	for (const auto& element : json[U"segments"].arrayView())
+	{
+		Segment segment;
+		segment.seconds = (element.hasElement(U"seconds") ? element[U"seconds"].get<double>() : 0.0);
+
+		if (element.hasElement(U"axis"))
+		{
+			const JSON axis = element[U"axis"];
+
+			if ((not axis.isArray()) or (axis.size() != 2))
+			{
+				return none;
+			}
+
+			segment.input.axis = Vec2{ axis[0].get<double>(), axis[1].get<double>() };
+		}
+
+		segment.input.transparent = (element.hasElement(U"transparent") ? element[U"transparent"].get<bool>() : false);
+		segments << segment;
+	}
+
+	const bool loop = (json.hasElement(U"loop") ? json[U"loop"].get<bool>() : true);
+
+	return InputScript{ std::move(segments), loop };
+}
+
+InputScript InputScript::RandomWalk(const uint64 seed, const size_t segmentCount)
+{
+	SmallRNG rng{ seed };
+	Array<Segment> segments(segmentCount);
+
+	for (auto& segment : segments)
+	{
+		segment.seconds = Random(0.5, 2.0, rng);
+		// 8 方向か停止。止まっていると見張り状態になる
+		segment.input.axis = Vec2(Random(-1, 1, rng), Random(-1, 1, rng));
+		segment.input.transparent = RandomBool(0.2, rng);
+	}
+
+	return InputScript{ std::move(segments), true };
+}
+
+FrameInput InputScript::at(double seconds) const
+{
+	if (not m_segments)
+	{
+		return{};
+	}
+
+	const double total = m_ends.back();
+
+	if (m_loop)
+	{
+		seconds = Math::Fmod(Max(seconds, 0.0), total);
+	}
+	else if (total <= seconds)
+	{
+		return m_segments.back().input;
+	}
+
+	const size_t index = static_cast<size_t>(std::upper_bound(m_ends.begin(), m_ends.end(), seconds) - m_ends.begin());
+
+	return m_segments[Min(index, (m_segments.size() - 1))].input;
+}
+
+double InputScript::duration() const noexcept
+{
+	return (m_ends ? m_ends.back() : 0.0);
+}
@@ -0,0 +1,56 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "SessionReplay.hpp"
+
+/// @brief ヘッドレス実行で使う、時間で区切られた入力の台本
+/// @remark JSON の形式は {"loop": true, "segments": [{"seconds": 1.5, "axis": [1, 0], "transparent": false}, ...]} です。
+class InputScript
+{
+public:
+
+	/// @brief 一定時間続ける入力
+	struct Segment
+	{
+		double seconds = 1.0;
+
+		FrameInput input;
+	};
+
+	SIV3D_NODISCARD_CXX20
+	InputScript() = default;
+
+	/// @param segments 入力の区切りの一覧
+	/// @param loop 最後まで進んだら最初に戻るか。戻らない場合は最後の入力のまま止まります
+	SIV3D_NODISCARD_CXX20
+	InputScript(Array<Segment> segments, bool loop);
+
+	/// @brief JSON ファイルから台本を読み込みます。
+	/// @param path ファイルのパス
+	/// @return 台本。読み込めなかった場合は none
+	[[nodiscard]]
+	static Optional<InputScript> Load(FilePathView path);
+
+	/// @brief ランダムに歩き回る台本を作ります。
+	/// @param seed 乱数のシード。同じシードからは同じ台本ができます
+	/// @param segmentCount 区切りの数
+	[[nodiscard]]
+	static InputScript RandomWalk(uint64 seed, size_t segmentCount = 64);
+
+	/// @brief 開始からの時刻の入力を返します。
+	/// @param seconds 開始からの時刻（秒）
+	[[nodiscard]]
+	FrameInput at(double seconds) const;
+
+	/// @brief 台本 1 周の長さ（秒）を返します。
+	[[nodiscard]]
+	double duration() const noexcept;
+
+private:
+
+	Array<Segment> m_segments;
+
+	/// @brief 各区切りの終わりの時刻（秒）
+	Array<double> m_ends;
+
+	bool m_loop = true;
+};
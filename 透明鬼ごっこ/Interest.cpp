@@ -0,0 +1,65 @@
+﻿# include "Interest.hpp"
+
+namespace
+{
+	/// @brief 見える範囲はセルの中心から求めるため、受け手の本当の位置とのずれの分だけ円を広げて見落としを防ぐ
+	constexpr double ViewMargin = (InterestTracker::ViewStep * 0.5 * Math::Sqrt2);
+}
+
+void InterestTracker::clear()
+{
+	m_receivers.clear();
+}
+
+void InterestTracker::erase(const PlayerID id)
+{
+	m_receivers.erase(id);
+
+	for (auto& [receiverID, receiver] : m_receivers)
+	{
+		receiver.seen.erase(id);
+	}
+}
+
+void InterestTracker::update(VisibilityMap& map, const PlayerID receiverID, const Vec2& receiverPos, const double range, const double bodyRadius,
+	const Array<PlayerID>& ids, const Array<Vec2>& positions, const Array<uint8>& moved,
+	Array<PlayerID>& movedIDs, Array<Vec2>& movedPositions, Array<PlayerID>& hiddenIDs)
+{
+	movedIDs.clear();
+	movedPositions.clear();
+	hiddenIDs.clear();
+
+	Receiver& receiver = m_receivers[receiverID];
+
+	if (map.update(receiverPos, range, ViewStep, receiver.view))
+	{
+		++m_rebuilds;
+	}
+
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		const PlayerID id = ids[i];
+		const Vec2& pos = positions[i];
+
+		if ((id != receiverID) and (not receiver.view.intersects(Circle{ pos, (bodyRadius + ViewMargin) })))
+		{
+			if (receiver.seen.erase(id))
+			{
+				hiddenIDs << id;
+			}
+
+			continue;
+		}
+
+		if (moved[i] or receiver.seen.insert(id).second)
+		{
+			movedIDs << id;
+			movedPositions << pos;
+		}
+	}
+}
+
+uint64 InterestTracker::rebuildCount() const noexcept
+{
+	return m_rebuilds;
+}
@@ -0,0 +1,60 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "Visibility.hpp"
+
+/// @brief ホストが各クライアントに送るプレイヤーを、そのクライアントから見えるかで選ぶ
+/// @remark クライアントごとに見える範囲を持ち、視点が ViewStep 四方のセルから出るまで使い回します。
+/// 送ったプレイヤーを覚えておき、動いたか見え始めたプレイヤーと、見えなくなったプレイヤーを求めます。
+class InterestTracker
+{
+public:
+
+	/// @brief プレイヤーの ID（Multiplayer_Photon の LocalPlayerID）
+	using PlayerID = int32;
+
+	/// @brief 見える範囲を使い回すセルの一辺（ピクセル）
+	/// @remark 止まっているプレイヤーは計算し直さず、歩いていても数回に 1 回で済みます。
+	static constexpr double ViewStep = 16.0;
+
+	/// @brief すべてのクライアントの見える範囲と、送ったプレイヤーを忘れます。
+	/// @remark 次の update() で、見えているプレイヤーをすべて送り直します。
+	void clear();
+
+	/// @brief 退室したプレイヤーを、受け手としても送ったプレイヤーとしても忘れます。
+	/// @param id プレイヤーの ID
+	void erase(PlayerID id);
+
+	/// @brief 受け手に送るプレイヤーを求めます。
+	/// @param map 壁の可視範囲
+	/// @param receiverID 受け手の ID
+	/// @param receiverPos 受け手の位置
+	/// @param range 見える範囲（視点を中心とする正方形の一辺の半分）
+	/// @param bodyRadius プレイヤーの円の半径
+	/// @param ids 全員の ID
+	/// @param positions 全員の位置。インデックスは ids と対応します
+	/// @param moved 全員の、前回から動いたか。インデックスは ids と対応します
+	/// @param movedIDs 送るプレイヤーの ID の格納先。前の内容は消されます。受け手自身は見えなくても補正のために含めます
+	/// @param movedPositions 送るプレイヤーの位置の格納先。前の内容は消されます
+	/// @param hiddenIDs 見えなくなったプレイヤーの ID の格納先。前の内容は消されます
+	void update(VisibilityMap& map, PlayerID receiverID, const Vec2& receiverPos, double range, double bodyRadius,
+		const Array<PlayerID>& ids, const Array<Vec2>& positions, const Array<uint8>& moved,
+		Array<PlayerID>& movedIDs, Array<Vec2>& movedPositions, Array<PlayerID>& hiddenIDs);
+
+	/// @brief 見える範囲を計算し直した回数を返します。
+	[[nodiscard]]
+	uint64 rebuildCount() const noexcept;
+
+private:
+
+	struct Receiver
+	{
+		VisibilityPolygon view;
+
+		/// @brief 位置を送ってあり、見えていることになっているプレイヤー
+		HashSet<PlayerID> seen;
+	};
+
+	HashTable<PlayerID, Receiver> m_receivers;
+
+	uint64 m_rebuilds = 0;
+};
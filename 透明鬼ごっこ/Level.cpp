@@ -0,0 +1,313 @@
+﻿# include "Level.hpp"
+
+namespace
+{
+	constexpr uint32 LevelMagic = 0x564C5454; // "TTLV"
+
+	[[nodiscard]]
+	Optional<Vec2> ReadVec2(const JSON& json)
+	{
+		if ((not json.isArray()) or (json.size() != 2))
+		{
+			return none;
+		}
+
+		return Vec2{ json[0].get<double>(), json[1].get<double>() };
+	}
+
+	/// @brief "rect": [中心 x, 中心 y, 幅, 高さ], "angle": 度 または "polygon": [[x, y], ...] の壁を読み込みます。
+	[[nodiscard]]
+	Optional<Polygon> ReadWall(const JSON& json)
+	{
+		if (json.hasElement(U"rect"))
+		{
+			const JSON rect = json[U"rect"];
+
+			if ((not rect.isArray()) or (rect.size() != 4))
+			{
+				return none;
+			}
+
+			const Vec2 center{ rect[0].get<double>(), rect[1].get<double>() };
+			const SizeF size{ rect[2].get<double>(), rect[3].get<double>() };
+			const double angle = (json.hasElement(U"angle") ? Math::ToRadians(json[U"angle"].get<double>()) : 0.0);
+
+			return RectF{ Arg::center(center), size }.rotated(angle).asPolygon();
+		}
+
+		if (json.hasElement(U"polygon"))
+		{
+			Array<Vec2> vertices;
+
+			for (const auto& vertex : json[U"polygon"].arrayView())
+			{
+				const auto pos = ReadVec2(vertex);
+
+				if (not pos)
+				{
+					return none;
+				}
+
+				vertices << *pos;
+			}
+
+			Polygon polygon{ vertices };
+
+			if (not polygon)
+			{
+				return none;
+			}
+
+			return polygon;
+		}
+
+		return none;
+	}
+}
+
+Optional<Level> Level::FromJSON(const JSON& json)
+{
+	if (not json)
+	{
+		return none;
+	}
+
+	Level level;
+	level.m_name = (json.hasElement(U"name") ? json[U"name"].getString() : U"");
+
+	{
+		if (not json.hasElement(U"bounds"))
+		{
+			return none;
+		}
+
+		const JSON bounds = json[U"bounds"];
+
+		if ((not bounds.isArray()) or (bounds.size() != 4))
+		{
+			return none;
+		}
+
+		level.m_bounds = RectF{ bounds[0].get<double>(), bounds[1].get<double>(), bounds[2].get<double>(), bounds[3].get<double>() };
+	}
+
+	if (json.hasElement(U"spawnPoints"))
+	{
+		for (const auto& spawn : json[U"spawnPoints"].arrayView())
+		{
+			const auto pos = ReadVec2(spawn);
+
+			if (not pos)
+			{
+				return none;
+			}
+
+			level.m_spawnPoints << *pos;
+		}
+	}
+
+	if (not level.m_spawnPoints)
+	{
+		level.m_spawnPoints << level.m_bounds.center();
+	}
+
+	if (json.hasElement(U"walls"))
+	{
+		for (const auto& wall : json[U"walls"].arrayView())
+		{
+			const auto polygon = ReadWall(wall);
+
+			if (not polygon)
+			{
+				return none;
+			}
+
+			level.m_collider.addPolygon(*polygon);
+		}
+	}
+
+	level.m_collider.build(level.m_bounds);
+
+	const Blob payload = level.serializePayload();
+	level.m_hash = MD5::FromBinary(payload.data(), payload.size());
+
+	return level;
+}
+
+Optional<Level> Level::FromBaked(const void* data, const size_t size)
+{
+	MemoryViewReader reader{ data, size };
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	MD5Value hash;
+	uint64 payloadSize = 0;
+
+	if ((not reader.read(magic)) or (not reader.read(version)) or (not reader.read(hash.value)) or (not reader.read(payloadSize)))
+	{
+		return none;
+	}
+
+	if ((magic != LevelMagic) or (version != Version))
+	{
+		return none;
+	}
+
+	const int64 payloadOffset = reader.getPos();
+
+	if (static_cast<uint64>(size - payloadOffset) < payloadSize)
+	{
+		return none;
+	}
+
+	const Byte* payload = (static_cast<const Byte*>(data) + payloadOffset);
+
+	if (MD5::FromBinary(payload, payloadSize) != hash)
+	{
+		return none;
+	}
+
+	Level level;
+	Deserializer<MemoryViewReader> deserializer{ payload, static_cast<size_t>(payloadSize) };
+	deserializer(level.m_name, level.m_bounds, level.m_spawnPoints, level.m_collider);
+	level.m_collider.restoreWalls();
+	level.m_hash = hash;
+
+	return level;
+}
+
+Optional<Level> Level::Load(const FilePathView path)
+{
+	if (FileSystem::Extension(path) == U"json")
+	{
+		return FromJSON(JSON::Load(path));
+	}
+
+	if (MemoryMapThreshold <= FileSystem::FileSize(path))
+	{
+		MemoryMappedFileView file{ path };
+
+		if (not file)
+		{
+			return none;
+		}
+
+		const MemoryMappedFileView::MappedMemory mapped = file.mapAll();
+
+		if (not mapped.data)
+		{
+			return none;
+		}
+
+		return FromBaked(mapped.data, mapped.size);
+	}
+
+	const Blob blob{ path };
+
+	if (not blob)
+	{
+		return none;
+	}
+
+	return FromBaked(blob.data(), blob.size());
+}
+
+Blob Level::bake() const
+{
+	const Blob payload = serializePayload();
+
+	MemoryWriter writer;
+	writer.write(LevelMagic);
+	writer.write(Version);
+	writer.write(m_hash.value);
+	writer.write(static_cast<uint64>(payload.size()));
+	writer.write(payload.data(), payload.size());
+
+	return writer.getBlob();
+}
+
+const MD5Value& Level::hash() const noexcept
+{
+	return m_hash;
+}
+
+const String& Level::name() const noexcept
+{
+	return m_name;
+}
+
+const RectF& Level::bounds() const noexcept
+{
+	return m_bounds;
+}
+
+const Array<Vec2>& Level::spawnPoints() const noexcept
+{
+	return m_spawnPoints;
+}
+
+const CircleCollider& Level::collider() const noexcept
+{
+	return m_collider;
+}
+
+Blob Level::serializePayload() const
+{
+	Serializer<MemoryWriter> writer;
+	writer(m_name, m_bounds, m_spawnPoints, m_collider);
+	return writer->getBlob();
+}
+
+namespace LevelCache
+{
+	FilePath Directory()
+	{
+		return (FileSystem::GetFolderPath(SpecialFolder::LocalAppData) + U"TransparentTag/levels/");
+	}
+
+	FilePath PathOf(const MD5Value& hash)
+	{
+		return (Directory() + hash.asString() + U".ttlevel");
+	}
+
+	Optional<Level> Find(const MD5Value& hash)
+	{
+		const FilePath path = PathOf(hash);
+
+		if (not FileSystem::Exists(path))
+		{
+			return none;
+		}
+
+		auto level = Level::Load(path);
+
+		if ((not level) or (level->hash() != hash))
+		{
+			return none;
+		}
+
+		return level;
+	}
+
+	bool Store(const MD5Value& hash, const Blob& baked)
+	{
+		const FilePath path = PathOf(hash);
+
+		if (FileSystem::Exists(path))
+		{
+			return true;
+		}
+
+		FileSystem::CreateDirectories(Directory());
+
+		// 書き込み途中のファイルを読まないように、一時ファイルに書いてから移動する
+		const FilePath temporary = (path + U".tmp");
+
+		if (not baked.save(temporary))
+		{
+			return false;
+		}
+
+		return FileSystem::Rename(temporary, path);
+	}
+}
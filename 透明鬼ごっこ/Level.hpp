@@ -0,0 +1,94 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "CircleCollider.hpp"
+
+/// @brief ステージの壁・スポーン地点・範囲と、焼き込み済みの衝突判定用グリッド
+/// @remark 元データは JSON、配布・キャッシュ用には焼き込んだバイナリ (.ttlevel) を使います。
+/// バイナリの内容のハッシュでステージを識別するため、ホストはハッシュだけを送れば済みます。
+class Level
+{
+public:
+
+	/// @brief バイナリ形式のバージョン
+	static constexpr uint32 Version = 1;
+
+	/// @brief このサイズ（バイト）以上のファイルはメモリマップして読み込みます
+	static constexpr int64 MemoryMapThreshold = (1 << 20);
+
+	/// @brief JSON の元データからステージを作り、衝突判定用のグリッドを焼き込みます。
+	/// @param json 元データ
+	/// @return ステージ。形式が正しくない場合は none
+	[[nodiscard]]
+	static Optional<Level> FromJSON(const JSON& json);
+
+	/// @brief 焼き込み済みのバイナリからステージを読み込みます。
+	/// @param data バイナリの先頭
+	/// @param size バイナリのサイズ（バイト）
+	/// @return ステージ。形式が正しくないかハッシュが一致しない場合は none
+	[[nodiscard]]
+	static Optional<Level> FromBaked(const void* data, size_t size);
+
+	/// @brief ファイルからステージを読み込みます。
+	/// @param path .ttlevel または JSON のファイルのパス
+	/// @return ステージ。失敗した場合は none
+	/// @remark 大きな .ttlevel はメモリマップして読み込みます。
+	[[nodiscard]]
+	static Optional<Level> Load(FilePathView path);
+
+	/// @brief ステージをバイナリに焼き込みます。
+	[[nodiscard]]
+	Blob bake() const;
+
+	/// @brief 内容のハッシュを返します。
+	[[nodiscard]]
+	const MD5Value& hash() const noexcept;
+
+	[[nodiscard]]
+	const String& name() const noexcept;
+
+	[[nodiscard]]
+	const RectF& bounds() const noexcept;
+
+	[[nodiscard]]
+	const Array<Vec2>& spawnPoints() const noexcept;
+
+	[[nodiscard]]
+	const CircleCollider& collider() const noexcept;
+
+private:
+
+	String m_name;
+
+	RectF m_bounds{ 0, 0, 0, 0 };
+
+	Array<Vec2> m_spawnPoints;
+
+	CircleCollider m_collider;
+
+	MD5Value m_hash;
+
+	/// @brief ヘッダを除いた本体をシリアライズします。
+	[[nodiscard]]
+	Blob serializePayload() const;
+};
+
+/// @brief 焼き込み済みのステージをハッシュごとにディスクにキャッシュします。
+namespace LevelCache
+{
+	/// @brief キャッシュのフォルダを返します。
+	[[nodiscard]]
+	FilePath Directory();
+
+	/// @brief ハッシュに対応するキャッシュファイルのパスを返します。
+	[[nodiscard]]
+	FilePath PathOf(const MD5Value& hash);
+
+	/// @brief キャッシュからステージを読み込みます。
+	/// @return ステージ。キャッシュにないか壊れている場合は none
+	[[nodiscard]]
+	Optional<Level> Find(const MD5Value& hash);
+
+	/// @brief 焼き込み済みのバイナリをキャッシュに保存します。
+	/// @return 保存に成功した場合 true, それ以外の場合は false
+	bool Store(const MD5Value& hash, const Blob& baked);
+}
@@ -1,7 +1,42 @@
 ﻿# include <Siv3D.hpp> // Siv3D v0.6.15
 # include "Multiplayer_Photon.hpp"
+# include "SessionReplay.hpp"
+# include "BenchmarkStats.hpp"
+# include "AllocationCounter.hpp"
+# include "ServerClock.hpp"
+# include "CircleCollider.hpp"
+# include "CollisionBenchmark.hpp"
+# include "SpatialGrid.hpp"
+# include "Level.hpp"
+# include "TrapPool.hpp"
+# include "PlayerTable.hpp"
+# include "WallChunks.hpp"
+# include "PlayerSimulation.hpp"
+# include "SimulationBenchmark.hpp"
+# include "SmoothingBatch.hpp"
+# include "SmoothingBenchmark.hpp"
+# include "Visibility.hpp"
+# include "Interest.hpp"
+# include "SweptContact.hpp"
+# include "SpriteBatch.hpp"
+# include "SpriteAtlas.hpp"
+# include "NameLabels.hpp"
+# include "GhostShader.hpp"
+# include "FrameScheduler.hpp"
+# include "InputScript.hpp"
+# include "RenderQueue.hpp"
+# include "StartupProfile.hpp"
+# include "GlyphCache.hpp"
 # include "PHOTON_APP_ID.SECRET"
 
+// defined by the Headless configuration, for CI and load machines without a GPU; only --headless runs are usable in such a build
+# ifdef TRANSPARENT_TAG_HEADLESS
+SIV3D_SET(EngineOption::Renderer::Headless)
+# endif
+
+// Photon only matches peers with the same version; bump it whenever the wire format changes
+constexpr StringView AppVersion = U"1.7";
+
 
 InputGroup KeyGroupLeft{ KeyLeft, KeyA };
 InputGroup KeyGroupRight{ KeyRight, KeyD };
@@ -40,7 +75,122 @@ StringView ToString(NetWorkState state) {
 	}
 }
 
-void drawCrown(const Vec2& pos) {
+// every image in App/image, in the order they are packed into the atlas
+enum class Sprite : uint16 {
+	goastBody,
+	goastEye,
+	goldCrown,
+	pow,
+	boseki,
+};
+
+Array<FilePath> SpritePaths() {
+	return {
+		Resource(U"image/goast_body.png"),
+		Resource(U"image/goast_eye.png"),
+		Resource(U"image/gold_crown.png"),
+		Resource(U"image/pow.png"),
+		Resource(U"image/boseki.png"),
+	};
+}
+
+AsyncTask<Array<Image>>& SpriteImagesTask() {
+	static AsyncTask<Array<Image>> task;
+	return task;
+}
+
+// decodes the sprite images on a worker thread so the first frame does not wait for them
+void LoadSpritesAsync() {
+	SpriteImagesTask() = SpriteAtlas::LoadImagesAsync(SpritePaths());
+}
+
+// true once Sprites() can be called without waiting for the worker
+bool IsSpritesReady() {
+	const auto& task = SpriteImagesTask();
+	return (not task.isValid()) or task.isReady();
+}
+
+// packed once so sprites never switch textures; the texture is made here on the main thread
+const SpriteAtlas& Sprites() {
+	static const SpriteAtlas atlas{ SpriteImagesTask().isValid() ? SpriteImagesTask().get() : SpriteAtlas::LoadImages(SpritePaths()) };
+	return atlas;
+}
+
+// status and HUD text; glyphs are cached on disk, so a warm start draws them without creating the font
+GlyphCache& MessageGlyphs() {
+	static GlyphCache cache{ FontMethod::Bitmap, 30, Typeface::Bold };
+	return cache;
+}
+
+// drawn at 15 px by NameLabels; MSDF keeps the downscaled glyphs sharp
+GlyphCache& NameGlyphs() {
+	static GlyphCache cache{ FontMethod::MSDF, 40, Typeface::Bold };
+	return cache;
+}
+
+// every fixed UI string drawn with MessageGlyphs
+namespace StatusText {
+	constexpr StringView Loading = U"読み込み中...";
+	constexpr StringView ReceivingData = U"データを受信中...";
+	constexpr StringView ReceivingLevel = U"マップを受信中...";
+	constexpr StringView Connecting = U"接続しています...";
+	constexpr StringView Reconnecting = U"接続が切れました\n再接続しています...";
+	constexpr StringView Joining = U"入室中...";
+	constexpr StringView Leaving = U"退室中...";
+	constexpr StringView Disconnecting = U"切断中...";
+	// formatted with the remaining seconds
+	constexpr StringView TagRestart = U"鬼ごっこ再開まで…{}秒";
+}
+
+// built from the strings themselves, so no message waits for a glyph that was left out
+const String& MessageGlyphSet() {
+	static const String glyphs = [] {
+		String result;
+		for (const StringView text : { StatusText::Loading, StatusText::ReceivingData, StatusText::ReceivingLevel, StatusText::Connecting,
+			StatusText::Reconnecting, StatusText::Joining, StatusText::Leaving, StatusText::Disconnecting, StatusText::TagRestart }) {
+			result.append(text);
+		}
+		result.remove(U'\n');
+		result.remove(U'{');
+		result.remove(U'}');
+		result.append(U"0123456789");
+		return result.sorted().unique_consecutive();
+	}();
+	return glyphs;
+}
+
+// ASCII and kana, so most names lay out without waiting for the worker
+const String& CommonNameGlyphs() {
+	static const String glyphs = [] {
+		String result;
+		for (char32 ch = U' '; ch <= U'~'; ++ch)result << ch;
+		for (char32 ch = U'ぁ'; ch <= U'ゖ'; ++ch)result << ch;
+		for (char32 ch = U'ァ'; ch <= U'ヺ'; ++ch)result << ch;
+		result << U'ー';
+		return result;
+	}();
+	return glyphs;
+}
+
+// placeholder for a status message while its glyphs are still being rasterized
+void DrawStatus(const StringView text) {
+	if (not MessageGlyphs().drawAt(text, Scene::Center(), Palette::White)) {
+		Circle{ Scene::Center(), 20 }.drawArc(Scene::Time() * 360_deg, 270_deg, 4, 0, Palette::White);
+	}
+}
+
+// draw order of the render queue; commands in the same layer are grouped by state and must not overlap
+enum class RenderLayer : uint8 {
+	walls,
+	traps,
+	ghosts,
+	names,
+	hudBack,
+	hudIcon,
+	hudFront,
+};
+
+void drawCrown(SpriteBatch& batch, const Vec2& pos, const ColorF& color) {
 	/*constexpr double w = 20;
 	constexpr double h = 15;
 	constexpr Vec2 bottom_left = Vec2{ -w/2,0 };
@@ -52,8 +202,7 @@ void drawCrown(const Vec2& pos) {
 	constexpr Vec2 bottom_right =  Vec2{ w/2,0 };
 	Transformer2D tf{ Mat3x2::Translate(pos) };
 	Polygon{ bottom_left,left,leftV,top,rightV,right,bottom_right }.draw(Palette::Yellow);*/
-	const ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
-	TextureAsset(U"gold_crown").scaled(1).drawAt(pos);
+	batch.add(Sprites().texture(), Sprites().region(Sprite::goldCrown), pos, 1, color);
 }
 
 struct Player {
@@ -74,44 +223,106 @@ struct Player {
 	}
 };
 
-struct Trap {
-	Vec2 pos;
-	LocalPlayerID ownerID;
-	Color color = Palette::White;
-	template <class Archive>
-	void SIV3D_SERIALIZE(Archive& archive)
-	{
-		archive(pos, ownerID, color);
+// per-client state of a player that is never sent
+struct PlayerLocalData {
+	PlayerLocalData() = default;
+	PlayerLocalData(const Vec2& pos, const ServerClock& clock) : pos(pos), prevPos(pos), fadeoutTimer(clock), slowdownTimer(clock) {
+		animationOffset = Random(0.0, 10.0);
 	}
+	Vec2 pos;
+	// smoothed position at the start of the last tick, for swept contact tests
+	Vec2 prevPos;
+	Vec2 velocity{};
+	uint64 smoothedTick = 0;
+	ServerTimer fadeoutTimer;
+	bool isFacingRight = true;
+	double animationOffset = 0.0;
+	ServerTimer slowdownTimer;
+	// authoritative mode: the host stopped sending this player's position because it went out of sight
+	bool isOutOfInterest = false;
 };
 
+// the spatial grids cover this area until a level sets its own bounds
+constexpr RectF defaultArenaBounds{ 0, 0, 800, 600 };
+constexpr double spatialCellSize = 64;
+
 class ShareRoomData {
 
 public:
 	ShareRoomData() = default;
 
-	const HashTable<LocalPlayerID, Player>& players() const {
+	// players in ascending ID order; only the Player component is shared
+	const PlayerTable<Player, PlayerLocalData>& players() const {
 		return m_players;
 	}
 
+	PlayerLocalData& playerLocal(LocalPlayerID id) {
+		return m_players.localAt(id);
+	}
+
+	// indexed like players().ids()
+	Array<PlayerLocalData>& playerLocals() {
+		return m_players.locals();
+	}
+
 	const LocalPlayerID itID() const {
 		return m_itID;
 	}
 
-	const HashTable<size_t,Trap>& traps() const {
+	const TrapPool& traps() const {
 		return m_traps;
 	}
 
+	// calls f(id, player) for players whose position is inside area
+	template <class Fty>
+	void forEachPlayerInCircle(const Circle& area, Fty f) const {
+		m_playerGrid.forEachInCircle(area, [&](LocalPlayerID id, const Vec2&) { f(id, m_players.at(id)); });
+	}
+
+	// calls f(handle, trap) for traps whose position is inside area
+	template <class Fty>
+	void forEachTrapInCircle(const Circle& area, Fty f) const {
+		m_trapGrid.forEachInCircle(area, [&](uint32 slot, const Vec2&) { const TrapHandle handle = m_traps.handleOfSlot(slot); f(handle, m_traps.get(handle)); });
+	}
+
+	template <class Fty>
+	void forEachTrapInRect(const RectF& area, Fty f) const {
+		m_trapGrid.forEachInRect(area, [&](uint32 slot, const Vec2&) { const TrapHandle handle = m_traps.handleOfSlot(slot); f(handle, m_traps.get(handle)); });
+	}
+
+	void setBounds(const RectF& bounds) {
+		m_playerGrid = SpatialGrid<LocalPlayerID>{ bounds, spatialCellSize };
+		m_trapGrid = SpatialGrid<uint32>{ bounds, spatialCellSize };
+		rebuildSpatialIndex();
+	}
+
+	// the grids and the local player data are not serialized; call this after reading the room data
+	void rebuildSpatialIndex() {
+		m_players.restoreIndex();
+		m_playerGrid.clear();
+		m_trapGrid.clear();
+		for (size_t i = 0; i < m_players.size(); ++i) {
+			m_playerGrid.set(m_players.ids()[i], m_players.replicated()[i].pos);
+		}
+		// the grid is keyed by slot, which is unique among live traps
+		for (size_t i = 0; i < m_traps.size(); ++i) {
+			m_trapGrid.set(m_traps.handleAt(i).index, m_traps.positions()[i]);
+		}
+	}
+
 	void setPlayerPos(LocalPlayerID id, Vec2 pos) {
 		m_players.at(id).pos = pos;
+		m_playerGrid.set(id, pos);
 	}
 
-	void addPlayer(LocalPlayerID id, Vec2 pos, Color color, String name) {
-		m_players.insert_or_assign(id, Player(pos, color, name));
+	void addPlayer(LocalPlayerID id, Vec2 pos, Color color, String name, const PlayerLocalData& local) {
+		m_players.insert(id, Player(pos, color, name), local);
+		m_playerGrid.set(id, pos);
 	}
 
 	void erasePlayer(LocalPlayerID id) {
 		m_players.erase(id);
+		m_playerGrid.erase(id);
 	}
 
 	void beTransparent(LocalPlayerID id, bool beTransparent) {
@@ -134,40 +345,45 @@ public:
 		m_itID = id;
 	}
 
-	void addTrap(const Vec2& pos, LocalPlayerID ownerID,const Color& color) {
-		m_traps.insert_or_assign(nextTrapID,Trap{ pos,ownerID,color});
-		nextTrapID++;
+	// host only: assigns the handle every peer will use for this trap
+	TrapHandle addTrap(const Vec2& pos, LocalPlayerID ownerID,const Color& color) {
+		const TrapHandle handle = m_traps.allocate(pos, ownerID, color);
+		m_trapGrid.set(handle.index, pos);
+		return handle;
 	}
 
-	void eraseTrap(size_t id) {
-		m_traps.erase(id);
+	void insertTrap(const TrapHandle& handle, const Vec2& pos, LocalPlayerID ownerID, const Color& color) {
+		if (m_traps.insert(handle, pos, ownerID, color)) {
+			m_trapGrid.set(handle.index, pos);
+		}
 	}
 
-	void eraseTrap(LocalPlayerID ownerID) {
-		for (auto it = m_traps.begin(); it != m_traps.end();) {
-			if (it->second.ownerID == ownerID) {
-				it = m_traps.erase(it);
-			}
-			else {
-				++it;
-			}
+	void eraseTrap(const TrapHandle& handle) {
+		if (m_traps.erase(handle)) {
+			m_trapGrid.erase(handle.index);
 		}
 	}
 
+	void eraseTrap(LocalPlayerID ownerID) {
+		m_traps.eraseOwner(ownerID, [&](const TrapHandle& handle) { m_trapGrid.erase(handle.index); });
+	}
+
 	void clearTraps() {
 		m_traps.clear();
+		m_trapGrid.clear();
 	}
 
 	template <class Archive>
 	void SIV3D_SERIALIZE(Archive& archive)
 	{
-		archive(m_players, m_itID, m_traps, nextTrapID);
+		archive(m_players, m_itID, m_traps);
 	}
 private:
-	HashTable<LocalPlayerID,Player> m_players;
+	PlayerTable<Player, PlayerLocalData> m_players;
 	LocalPlayerID m_itID = 0;
-	HashTable<size_t,Trap> m_traps;
-	size_t nextTrapID = 0;
+	TrapPool m_traps;
+	SpatialGrid<LocalPlayerID> m_playerGrid{ defaultArenaBounds, spatialCellSize };
+	SpatialGrid<uint32> m_trapGrid{ defaultArenaBounds, spatialCellSize };
 };
 
 enum class EventCode:uint8 {
@@ -185,8 +401,25 @@ enum class EventCode:uint8 {
 	requestTrappedToHost,
 	solveTrapped,
 	eraseTrap,
+	requestLevel,
+	levelChunk,
+	playerInput,
+	authoritativeMove,
+	requestAddTrap,
+	requestInput,
+	inputSync,
 };
 
+// sent as a fixed-size custom type; the ID is part of the wire format and must never change
+struct PlayerInputEvent {
+	static constexpr uint32 PhotonTypeID = 0x4E504954; // "TIPN"
+	Vec2 axis{ 0, 0 };
+};
+
+FilePath DefaultLevelPath() {
+	return Resource(U"level/default.json");
+}
+
 class MyNetwork : public Multiplayer_Photon
 {
 public:
@@ -195,6 +428,60 @@ public:
 	NetWorkState state = NetWorkState::Disconnected;
 	bool isFirstConnecting = true;
 
+	// bytes per update(), which runs at the network tick rate; about 36 KB/s at 60 Hz
+	static constexpr size_t sendBudgetPerTick = 600;
+
+	// everything drawRoom needs from the GPU; headless runs never call this
+	void initGraphics() {
+		ghostShader = GhostShader{ serverClock };
+		nameLabels = NameLabels{ NameGlyphs(), 15 };
+		// names of players who joined while the sprites were loading
+		if (hasRoomData) {
+			for (auto [i, player] : Indexed(roomData.players().replicated())) {
+				nameLabels.set(roomData.players().ids()[i], player.name);
+			}
+		}
+		hasGraphics = true;
+	}
+
+	// set by initGraphics(); the main loop calls it once the sprites have loaded
+	bool hasGraphics = false;
+
+	void initSendScheduler() {
+		for (auto code : { EventCode::roomDataFromHost, EventCode::playerAdd, EventCode::playerErase, EventCode::itIDChange,
+			EventCode::tagStop, EventCode::addTrap, EventCode::requestTrappedToHost, EventCode::solveTrapped, EventCode::eraseTrap, EventCode::requestAddTrap,
+			EventCode::requestLevel, EventCode::requestInput, EventCode::inputSync }) {
+			setEventPolicy(FromEnum(code), EventPriority::Critical);
+		}
+		// the host only needs the latest input; a batch of moves must not replace an earlier one
+		setEventPolicy(FromEnum(EventCode::playerInput), EventPriority::Critical, true);
+		setEventPolicy(FromEnum(EventCode::authoritativeMove), EventPriority::Normal);
+		setEventPolicy(FromEnum(EventCode::levelChunk), EventPriority::Normal);
+		setEventPolicy(FromEnum(EventCode::playerMove), EventPriority::Normal, true);
+		setEventPolicy(FromEnum(EventCode::beTransparent), EventPriority::Normal);
+		setEventPolicy(FromEnum(EventCode::beSlowdown), EventPriority::Normal);
+		setEventPolicy(FromEnum(EventCode::playerNameChange), EventPriority::Normal);
+		// only the latest watching state matters
+		setEventPolicy(FromEnum(EventCode::beWatching), EventPriority::Cosmetic, true);
+		setSendBudget(sendBudgetPerTick);
+	}
+
+	void initEventHandlers() {
+		onEvent<PlayerInputEvent>([this](const LocalPlayerID playerID, const uint8 eventCode, const PlayerInputEvent& event) {
+			// the struct bytes are recorded as they arrived; a replay passes them back to customEventAction
+			recorder.addRawEvent(playerID, eventCode, &event, sizeof(event));
+			applyPlayerInput(playerID, event.axis);
+		});
+	}
+
+	// host only: the latest input of a client, applied on the next simulation step
+	void applyPlayerInput(const LocalPlayerID playerID, const Vec2& axis) {
+		if (not hasRoomData or not authoritative or not isHost()) return;
+		if (simulation.contains(playerID)) {
+			simulation.setInput(playerID, axis);
+		}
+	}
+
 	//Lobby Data
 	TextEditState roomNameBox;
 	TextEditState userNameBox;
@@ -204,65 +491,254 @@ public:
 	}
 	void updateLobby() {
 
+		if (lobbyMessage) {
+			SimpleGUI::GetFont()(*lobbyMessage).draw(Vec2{ 100,110 }, Palette::White);
+		}
+
 		SimpleGUI::TextBox(roomNameBox, Vec2{ 100,20 }, 200);
 		if (SimpleGUI::Button(U"ルームを作成", Vec2{ 100,70 })) {
-			initWhenCreateRoom();
-			createRoom(roomNameBox.text + U"#" + ToHex(RandomUint16()), 20);
-			state = NetWorkState::Joining;
+			createGameRoom(roomNameBox.text);
 		}
 
 		SimpleGUI::TextBox(userNameBox, Vec2{ 580,20 }, 200);
 
 		for(auto [i,roomName] : Indexed(getRoomNameList())){
 			if (SimpleGUI::Button(roomName, Vec2{ 100 + (i % 3) * 200,150 + (i / 3) * 50 })) {
-				initWhenJoinRoom();
-				joinRoom(roomName);
-				state = NetWorkState::Joining;
+				joinGameRoom(roomName);
 			}
 		}
 	}
+
+	void createGameRoom(const String& roomName) {
+		lobbyMessage.reset();
+		// --level is checked at startup, but the file can still change or disappear while the game runs
+		if (not initWhenCreateRoom()) {
+			lobbyMessage = U"マップを読み込めませんでした: " + levelPath;
+			return;
+		}
+		createRoom(roomName + U"#" + ToHex(RandomUint16()), 20);
+		state = NetWorkState::Joining;
+	}
+
+	void joinGameRoom(const String& roomName) {
+		lobbyMessage.reset();
+		initWhenJoinRoom();
+		joinRoom(roomName);
+		state = NetWorkState::Joining;
+	}
+
+	// the lobby decision without the GUI: join a room with this name if one is listed, otherwise create one
+	void enterRoomHeadless(const String& roomName) {
+		for (const auto& listed : getRoomNameList()) {
+			if (listed.starts_with(roomName + U"#")) {
+				joinGameRoom(listed);
+				return;
+			}
+		}
+		createGameRoom(roomName);
+	}
 	
 
 	//Room Data
 	static constexpr double playerRadius = 20;
 	static constexpr double trapBodyRadius = 7;
+	static constexpr double smoothingSlack = 64;
+	// the "it" ghost's speed, the fastest any ghost moves
+	static constexpr double maxPlayerSpeed = 220;
 
 	bool hasRoomData = false;
 	ShareRoomData roomData;
-	P2World world;
-	static constexpr double stepTime = 1.0 / 200.0;
-	double accumulatedTime = 0.0;
-	Array<P2Body> walls;
-	P2Body playerBody;
-	Timer tagStoppingTimer;
-	Stopwatch noMovingTime;
-	double trapAccumulatedTime = 0.0;
+	static constexpr double playerBodyRadius = 15;
+	Vec2 playerPos{ 400,300 };
+	// playerPos before the last simulation tick, for drawing between ticks
+	Vec2 previousPlayerPos{ 400,300 };
+	ServerClock serverClock;
+	// ghost fade and slowdown tint are computed on the GPU from the timers; loaded by initGraphics()
+	GhostShader ghostShader;
+	Optional<int32> replayServerTimeMillisec;
+	Stopwatch serverTimeRefreshTime{ StartImmediately::Yes, GetGameClock() };
+	ServerTimer tagStoppingTimer{ serverClock };
+	Stopwatch noMovingTime{ StartImmediately::No, GetGameClock() };
+	// traps are placed every trapStepTime since the last tag, in server time
+	bool hasTrapEpoch = false;
+	int32 trapEpochMillisec = 0;
+	int64 trapStepsDone = 0;
 	constexpr static double trapStepTime = 5;
+	constexpr static Duration tagStopTime = 3.0s;
 	constexpr static Duration slowDownTime = 2.0s;
 
-	Vec2 spawnPos = Vec2{ 400,300 };
+	//Level
+	FilePath levelPath = DefaultLevelPath();
+	Optional<Level> level;
+	// baked bytes the host sends to clients that do not have the level cached
+	Blob levelBlob;
+	Optional<MD5Value> pendingLevelHash;
+	Array<uint8> levelDownload;
+	size_t levelDownloadReceived = 0;
+	// small enough that a chunk with its header fits a queued event, so the send budget paces the download
+	static constexpr size_t levelChunkSize = 224;
+	static constexpr int32 levelChunksPerTick = 2;
+	// chunks wait while other events are still queued, so a download never crowds out the game
+	static constexpr size_t levelChunkQueueLimit = 4;
+	Array<uint8> levelChunkBuffer;
+	struct LevelUpload {
+		LocalPlayerID playerID = 0;
+		size_t offset = 0;
+	};
+	Array<LevelUpload> levelUploads;
+	// a download that makes no progress for this long is requested again, from whoever is host by then
+	static constexpr Duration levelRequestTimeout = 5s;
+	static constexpr int32 maxLevelRequests = 3;
+	int32 levelRequests = 0;
+	Stopwatch levelRequestTime{ StartImmediately::No, GetGameClock() };
+	// shown in the lobby after the room was left because of an error
+	Optional<String> lobbyMessage;
+	WallChunks wallChunks;
+	VisibilityMap visibility;
+	// reused every frame so sprite quads do not reallocate; one per layer because the queue draws them later
+	SpriteBatch trapBatch;
+	// one batch per GhostShader page, since each page is drawn with its own constants
+	Array<SpriteBatch> ghostBatches;
+	// drawRoom records commands here and submits them sorted by render state
+	RenderQueue renderQueue;
+	// state changes made by the last drawRoom
+	size_t lastStateChanges = 0;
+	// laid out only when a player joins or renames
+	NameLabels nameLabels;
+	// half the side of the square around a viewer that can be seen; covers the screen wherever the ghost is on it
+	static constexpr double visibilityRange = 800;
+	static constexpr Color wallColor{ 79, 79, 79 };
+
+	//Camera
+	Camera2D camera{ Vec2{ 400,300 }, 1.0, Camera2DParameters::NoControl() };
+	// remote ghosts are smoothed only inside the view grown by this much; the rest snap when they come back
+	static constexpr double activeMargin = 256;
+	// half the size of a ghost sprite with its name label
+	static constexpr double spriteMargin = 64;
+	uint64 roomTick = 0;
+	// remote ghosts in the active area are gathered here and smoothed in one batch
+	SmoothingBatch smoothing;
+	Array<size_t> smoothingIndices;
+
+	//Authoritative Simulation
+	// the host moves every player from their inputs; clients predict their own move and get corrected
+	bool hostAuthoritative = false;
+	bool authoritative = false;
+	PlayerSimulation simulation;
+	// false until this peer runs the simulation; a client that becomes host rebuilds it before the first step
+	bool ownsSimulation = false;
+	// players whose simulated position was rebuilt from a stale replica and is replaced by the one they report once
+	HashSet<LocalPlayerID> awaitingInputSync;
+	Vec2 sentInputAxis{};
+	Array<LocalPlayerID> movedIDs;
+	Array<Vec2> movedPositions;
+	// players that went out of a receiver's sight this broadcast; the receiver stops drawing their last position
+	Array<LocalPlayerID> hiddenIDs;
+	Array<std::pair<TrapHandle, LocalPlayerID>> trapHits;
+	static constexpr uint64 moveBroadcastInterval = 3;
+	// per receiver, its view and the players whose position it has been sent since they last came into sight
+	InterestTracker interest;
+	Array<uint8> movedFlags;
+	static constexpr double correctionDistance = 64;
+
+	void flipFadeoutTimer(const LocalPlayerID playerID, const int32 startMillisec) {
+		constexpr Duration fadeoutTime = 0.1s;
+		ServerTimer& fadeoutTimer = roomData.playerLocal(playerID).fadeoutTimer;
+		Duration remain = fadeoutTimer.remaining();
+		fadeoutTimer.restartUntil(ServerClock::Add(startMillisec, ServerClock::ToMillisec(fadeoutTime - remain)), fadeoutTime);
+	}
 
-	struct PlayerLocalData {
-		PlayerLocalData() = default;
-		PlayerLocalData(const Vec2& pos) : pos(pos) {
-			animationOffset = Random(0.0, 10.0);
+	int32 sampleServerTime() const {
+		if (replayServerTimeMillisec) {
+			return *replayServerTimeMillisec;
 		}
-		Vec2 pos;
-		Vec2 velocity{};
-		Timer fadeoutTimer;
-		bool isFacingRight = true;
-		double animationOffset = 0.0;
-		Timer slowdownTimer;
-	};
+		return getServerTimeMillisec();
+	}
 
-	HashTable<LocalPlayerID, PlayerLocalData> playersLocalData;
+	int32 serverNow() {
+		if (not serverClock.isSynchronized()) {
+			serverClock.addSample(sampleServerTime());
+		}
+		return serverClock.nowMillisec();
+	}
 
-	void flipFadeoutTimer(const LocalPlayerID playerID) {
-		constexpr Duration fadeoutTime = 0.1s;
-		Timer& fadeoutTimer = playersLocalData.at(playerID).fadeoutTimer;
-		Duration remain = fadeoutTimer.remaining();
-		fadeoutTimer.restart(fadeoutTime);
-		fadeoutTimer.setRemaining(fadeoutTime - remain);
+	void restartTrapCycle(const int32 epochMillisec) {
+		hasTrapEpoch = true;
+		trapEpochMillisec = epochMillisec;
+		trapStepsDone = 0;
+	}
+
+	double trapElapsedTime() const {
+		if (not hasTrapEpoch) return 0.0;
+		return Max(ServerClock::Diff(serverClock.nowMillisec(), trapEpochMillisec) / 1000.0, 0.0);
+	}
+
+	void stopTag(const int32 deadlineMillisec) {
+		tagStoppingTimer.restartUntil(deadlineMillisec, tagStopTime);
+		roomData.clearTraps();
+		restartTrapCycle(ServerClock::Add(deadlineMillisec, -ServerClock::ToMillisec(tagStopTime)));
+	}
+
+	// the tag freeze ends at the same server time on every client
+	int32 startTagStop() {
+		const int32 deadline = ServerClock::Add(serverNow(), ServerClock::ToMillisec(tagStopTime));
+		stopTag(deadline);
+		return deadline;
+	}
+
+	//Session Recording / Replay
+	SessionRecorder recorder;
+	Optional<FilePath> recordDirectory;
+	Optional<LocalPlayerID> replayLocalPlayerID;
+	bool replayIsHost = false;
+
+	LocalPlayerID getLocalPlayerID() const {
+		if (replayLocalPlayerID) {
+			return *replayLocalPlayerID;
+		}
+		return Multiplayer_Photon::getLocalPlayerID();
+	}
+
+	bool isHost() const {
+		if (replayLocalPlayerID) {
+			return replayIsHost;
+		}
+		return Multiplayer_Photon::isHost();
+	}
+
+	void saveRecording() {
+		if (not recorder.isRecording()) return;
+		recorder.stop();
+		if (recordDirectory) {
+			const FilePath path = (*recordDirectory + U"session_{}.ttsr"_fmt(DateTime::Now().format(U"yyyyMMdd_HHmmss")));
+			recorder.record().save(path);
+		}
+	}
+
+	void replayEvent(const RecordedEvent& event) {
+		switch (event.type) {
+		case RecordedEventType::Custom:
+		{
+			Deserializer<MemoryViewReader> reader{ event.data.data(), event.data.size() };
+			customEventAction(event.playerID, event.eventCode, reader);
+		}
+			break;
+		case RecordedEventType::Join:
+			joinRoomEventAction(LocalPlayer{ .localID = event.playerID }, {}, event.flag);
+			break;
+		case RecordedEventType::Leave:
+			leaveRoomEventAction(event.playerID, event.flag);
+			break;
+		default:
+			break;
+		}
+	}
+
+	static FrameInput ReadInput() {
+		return FrameInput{
+			.axis = Vec2(KeyGroupRight.pressed() - KeyGroupLeft.pressed(), KeyGroupDown.pressed() - KeyGroupUp.pressed()),
+			.transparent = KeySpace.pressed(),
+		};
 	}
 
 	const Player& getPlayer() const {
@@ -272,34 +748,113 @@ public:
 	bool isIt() const {
 		return getLocalPlayerID() == roomData.itID();
 	}
+
+	double playerSpeed(LocalPlayerID id, bool isTransparent) const {
+		double speed = isTransparent ? 120 : 200;
+		if (id == roomData.itID()) {
+			speed *= 1.1;
+		}
+
+		if (roomData.players().at(id).isSlowdown) {
+			speed *= 0.5;
+		}
+
+		if(tagStoppingTimer.isRunning() and id == roomData.itID()){
+			speed = 0;
+		}
+		return speed;
+	}
 	
-	void createWalls() {
-		world = P2World{ {0, 0} };
+	bool isLevelReady() const {
+		return level and roomData.players().contains(getLocalPlayerID());
+	}
 
-		walls << world.createRect(P2Static, Scene::Rect().topCenter(), Size{ Scene::Width(),100 });
-		walls << world.createRect(P2Static, Scene::Rect().bottomCenter(), Size{ Scene::Width(),100 });
-		walls << world.createRect(P2Static, Scene::Rect().leftCenter(), Size{ 100,Scene::Height() });
-		walls << world.createRect(P2Static, Scene::Rect().rightCenter(), Size{ 100,Scene::Height() });
+	void setLevel(Level&& newLevel) {
+		level = std::move(newLevel);
+		roomData.setBounds(level->bounds());
+		// spawn markers never move, so they are baked into the wall tiles
+		wallChunks = WallChunks{ level->collider().walls(), level->bounds(), wallColor, [this](const RectF& area) {
+			const ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
+			const TextureRegion boseki = Sprites().texture()(Sprites().region(Sprite::boseki)).scaled(2);
+			for (const auto& spawnPoint : level->spawnPoints()) {
+				if (not area.stretched(boseki.size).intersects(spawnPoint))continue;
+				boseki.drawAt(spawnPoint);
+			}
+		} };
+		visibility = VisibilityMap{ level->collider().walls(), level->bounds() };
+	}
 
-		walls << world.createRect(P2Static, Vec2{ 200,200 }, Size{ 50,50 });
-		walls << world.createRect(P2Static, Vec2{ 600,300 }, Size{ 50,50 }).setAngle(45_deg);
-		walls << world.createRect(P2Static, Vec2{ 250,450 }, Size{ 150,30 });
-		walls << world.createRect(P2Static, Vec2{ 440,250 }, Size{ 30,200 }).setAngle(0_deg);
+	// keeps the view inside the level when the level is larger than the screen
+	Vec2 cameraTarget(const Vec2& pos) const {
+		const RectF& bounds = level->bounds();
+		const Vec2 half = Scene::Size() * 0.5;
+		const double x = (bounds.w <= Scene::Width()) ? bounds.centerX() : Clamp(pos.x, bounds.x + half.x, bounds.rightX() - half.x);
+		const double y = (bounds.h <= Scene::Height()) ? bounds.centerY() : Clamp(pos.y, bounds.y + half.y, bounds.bottomY() - half.y);
+		return Vec2{ x, y };
+	}
+
+	// returns false if the level file is missing or malformed
+	[[nodiscard]] bool loadHostLevel() {
+		Optional<Level> loaded = Level::Load(levelPath);
+		if (not loaded) {
+			return false;
+		}
+		levelBlob = loaded->bake();
+		LevelCache::Store(loaded->hash(), levelBlob);
+		setLevel(std::move(*loaded));
+		return true;
+	}
+
+	// adds the local player once the level is available
+	void enterLevel() {
+		const Vec2 pos = level->spawnPoints().choice();
+		const Color color = RandomColor();
+		playerPos = pos;
+		previousPlayerPos = playerPos;
+		camera.jumpTo(cameraTarget(pos), 1.0);
+		roomData.addPlayer(getLocalPlayerID(), pos, color, userNameBox.text, PlayerLocalData{ pos, serverClock });
+		nameLabels.set(getLocalPlayerID(), userNameBox.text);
+		sendEvent(FromEnum(EventCode::playerAdd), serializeEvent(pos, color, userNameBox.text));
 	}
 
 	void initRoomData() {
 		hasRoomData = false;
 		roomData = ShareRoomData{};
-		createWalls();
-		playerBody = world.createCircle(P2Dynamic, { 400,300 }, 15).setFixedRotation(true);
-		accumulatedTime = 0.0;
-		trapAccumulatedTime = 0.0;
-		playersLocalData.clear();
+		level.reset();
+		levelBlob = Blob{};
+		pendingLevelHash.reset();
+		levelDownload.clear();
+		levelDownloadReceived = 0;
+		levelUploads.clear();
+		levelRequests = 0;
+		levelRequestTime.reset();
+		wallChunks = WallChunks{};
+		visibility = VisibilityMap{};
+		interest.clear();
+		nameLabels.clear();
+		roomTick = 0;
+		authoritative = false;
+		simulation.clear();
+		ownsSimulation = false;
+		awaitingInputSync.clear();
+		sentInputAxis = Vec2{};
+		playerPos = Vec2{ 400,300 };
+		previousPlayerPos = playerPos;
+		hasTrapEpoch = false;
+		trapStepsDone = 0;
+		tagStoppingTimer.reset();
 	}
 
-	void initWhenCreateRoom() {
+	// returns false and leaves the room data empty if the level cannot be loaded
+	[[nodiscard]] bool initWhenCreateRoom() {
 		initRoomData();
+		if (not loadHostLevel()) {
+			return false;
+		}
+		authoritative = hostAuthoritative;
+		ownsSimulation = true;
 		hasRoomData = true;
+		return true;
 	}
 
 	void initWhenJoinRoom() {
@@ -308,236 +863,477 @@ public:
 	}
 
 	LocalPlayerID hostID() const {
-		for (auto& player : getLocalPlayers()) {
-			if (player.isHost) {
-				return player.localID;
+		if (replayLocalPlayerID and replayIsHost) {
+			return *replayLocalPlayerID;
+		}
+		return getHostLocalPlayerID();
+	}
+
+	void leaveWithMessage(const String& message) {
+		lobbyMessage = message;
+		saveRecording();
+		leaveRoom();
+		state = NetWorkState::Leaving;
+	}
+
+	void requestLevel() {
+		++levelRequests;
+		levelDownload.clear();
+		levelDownloadReceived = 0;
+		levelRequestTime.restart();
+		sendEvent(FromEnum(EventCode::requestLevel), serializeEvent(), EventTargets{ hostID() });
+	}
+
+	void retryLevelRequest() {
+		if (maxLevelRequests <= levelRequests) {
+			pendingLevelHash.reset();
+			leaveWithMessage(U"マップを受信できませんでした");
+			return;
+		}
+		requestLevel();
+	}
+
+	// host: queues a few chunks per tick for each downloading client; client: asks again when the download stalls
+	void updateLevelTransfer() {
+		if (pendingLevelHash and levelRequestTime > levelRequestTimeout) {
+			retryLevelRequest();
+		}
+
+		if (not isHost() or not levelUploads) return;
+		const uint8* bytes = static_cast<const uint8*>(static_cast<const void*>(levelBlob.data()));
+		int32 chunks = 0;
+		for (auto& upload : levelUploads) {
+			while (upload.offset < levelBlob.size() and chunks < levelChunksPerTick and getQueuedEventCount() < levelChunkQueueLimit) {
+				const size_t size = Min(levelChunkSize, levelBlob.size() - upload.offset);
+				levelChunkBuffer.assign(bytes + upload.offset, bytes + upload.offset + size);
+				sendEvent(FromEnum(EventCode::levelChunk), serializeEvent(static_cast<uint64>(levelBlob.size()), static_cast<uint64>(upload.offset), levelChunkBuffer), EventTargets{ upload.playerID });
+				upload.offset += size;
+				++chunks;
 			}
 		}
-		return 0;
+		levelUploads.remove_if([this](const LevelUpload& upload) { return levelBlob.size() <= upload.offset; });
 	}
 
-	void updateRoom(double delta = Scene::DeltaTime()) {
-		
-		if(not hasRoomData)return;
-		Vec2 inputAxis = Vec2(KeyGroupRight.pressed() - KeyGroupLeft.pressed(), KeyGroupDown.pressed() - KeyGroupUp.pressed());
-		//Vec2 inputAxis = Vec2(KeyD.pressed() - KeyA.pressed(), KeyS.pressed() - KeyW.pressed());
-		bool beTransparent = KeySpace.pressed();
-		Vec2 prePos = playerBody.getPos();
-		Vec2 normalizedInputAxis = inputAxis.setLength(1);
+	// host only
+	void placeTrap(const Vec2& pos, LocalPlayerID ownerID, const Color& color) {
+		const TrapHandle handle = roomData.addTrap(pos, ownerID, color);
+		sendEvent(FromEnum(EventCode::addTrap), serializeEvent(handle, pos, ownerID, color));
+	}
 
-		double speed = beTransparent ? 120 : 200;
-		if (isIt()) {
-			speed *= 1.1;
+	void trapPlayer(const TrapHandle& trap, LocalPlayerID playerID) {
+		if (not roomData.traps().contains(trap)) return;
+		roomData.eraseTrap(trap);
+		sendEvent(FromEnum(EventCode::eraseTrap), serializeEvent(trap));
+		const int32 deadline = ServerClock::Add(serverNow(), ServerClock::ToMillisec(slowDownTime));
+		sendEvent(FromEnum(EventCode::solveTrapped), serializeEvent(deadline), EventTargets{ playerID });
+	}
+
+	// host only: each client gets the players it can see that moved, or that just came into sight
+	void broadcastVisibleMoves() {
+		simulation.takeMovedFlags(movedFlags);
+		for (auto [r, receiverID] : Indexed(simulation.ids())) {
+			if (receiverID == getLocalPlayerID())continue;
+			interest.update(visibility, receiverID, simulation.positions()[r], visibilityRange, playerBodyRadius,
+				simulation.ids(), simulation.positions(), movedFlags, movedIDs, movedPositions, hiddenIDs);
+			if (movedIDs or hiddenIDs) {
+				sendEvent(FromEnum(EventCode::authoritativeMove), serializeEvent(movedIDs, movedPositions, hiddenIDs), EventTargets{ receiverID });
+			}
 		}
+	}
 
-		if (getPlayer().isSlowdown) {
-			speed *= 0.5;
+	// the host that built the simulation can leave; the player that takes over rebuilds it from the replicated players
+	void takeOverSimulation() {
+		ownsSimulation = true;
+		simulation.clear();
+		awaitingInputSync.clear();
+		for (auto [i, player] : Indexed(roomData.players().replicated())) {
+			const LocalPlayerID id = roomData.players().ids()[i];
+			// the host simulates everyone, so nobody is out of its interest
+			roomData.playerLocals()[i].isOutOfInterest = false;
+			if (id == getLocalPlayerID()) {
+				simulation.setPlayer(id, playerPos);
+				continue;
+			}
+			simulation.setPlayer(id, player.pos);
+			awaitingInputSync.insert(id);
 		}
+		// what each client has been sent is unknown, so everything in sight is sent again
+		interest.clear();
+		// clients only send their input when it changes
+		sendEvent(FromEnum(EventCode::requestInput), serializeEvent());
+	}
 
-		if(tagStoppingTimer.isRunning() and isIt()){
-			speed = 0;
+	// host only: moves every player, then checks tagging and traps against the simulated positions
+	void stepSimulation(double delta) {
+		for (const LocalPlayerID id : simulation.ids()) {
+			simulation.setSpeed(id, playerSpeed(id, roomData.players().at(id).isTransparent));
 		}
+		simulation.step(level->collider(), playerBodyRadius, delta);
 
-		playerBody.setVelocity(normalizedInputAxis * speed);
+		for (auto [i, id] : Indexed(simulation.ids())) {
+			if (roomData.players().at(id).pos != simulation.positions()[i]) {
+				roomData.setPlayerPos(id, simulation.positions()[i]);
+			}
+		}
 
-		for (accumulatedTime += delta; accumulatedTime >= stepTime; accumulatedTime -= stepTime) {
-			world.update(stepTime);
+		if (roomTick % moveBroadcastInterval == 0) {
+			broadcastVisibleMoves();
 		}
 
-		Vec2 pos = playerBody.getPos();
+		// contacts are swept over the whole tick, so fast ghosts cannot pass through each other
+		const LocalPlayerID itID = roomData.itID();
+		if (not tagStoppingTimer.isRunning() and simulation.contains(itID)) {
+			const size_t it = simulation.indexOf(itID);
+			const Vec2& itFrom = simulation.previousPositions()[it];
+			const Vec2& itTo = simulation.positions()[it];
+			Optional<LocalPlayerID> tagged;
+			double firstContact = Largest<double>;
+			roomData.forEachPlayerInCircle(Circle{ itTo, playerRadius * 2 + maxPlayerSpeed * delta * 2 }, [&](LocalPlayerID id, const Player&) {
+				if (id == itID or not simulation.contains(id))return;
+				const size_t i = simulation.indexOf(id);
+				const auto contact = SweptContact::TimeOfContact(itFrom, itTo, simulation.previousPositions()[i], simulation.positions()[i], playerRadius * 2);
+				if (contact and *contact < firstContact) {
+					firstContact = *contact;
+					tagged = id;
+				}
+			});
+			if (tagged) {
+				roomData.setItID(*tagged);
+				sendEvent(FromEnum(EventCode::itIDChange), serializeEvent(*tagged));
+
+				sendEvent(FromEnum(EventCode::tagStop), serializeEvent(startTagStop()));
+			}
+		}
+
+		trapHits.clear();
+		for (size_t i = 0; i < simulation.size(); ++i) {
+			const LocalPlayerID id = simulation.ids()[i];
+			const Vec2& from = simulation.previousPositions()[i];
+			const Vec2& to = simulation.positions()[i];
+			roomData.forEachTrapInCircle(Circle{ to, playerRadius + trapBodyRadius + from.distanceFrom(to) }, [&](const TrapHandle& handle, const Trap& trap) {
+				if (trap.ownerID == id)return;
+				if (not SweptContact::TimeOfContact(from, to, trap.pos, trap.pos, playerRadius + trapBodyRadius))return;
+				trapHits.emplace_back(handle, id);
+			});
+		}
+		for (const auto& [handle, playerID] : trapHits) {
+			trapPlayer(handle, playerID);
+		}
+	}
+
+	void updateRoom(const FrameInput& input, double delta = Scene::DeltaTime()) {
+
+		const int32 serverTime = sampleServerTime();
+		recorder.commitFrame(delta, serverTime, input);
+		serverClock.addSample(serverTime);
+		if (serverTimeRefreshTime > 10s) {
+			refreshServerTime();
+			serverTimeRefreshTime.restart();
+		}
+
+		updateLevelTransfer();
+
+		if(not hasRoomData or not isLevelReady())return;
+		Vec2 inputAxis = input.axis;
+		bool beTransparent = input.transparent;
+		Vec2 prePos = playerPos;
+		previousPlayerPos = playerPos;
+		Vec2 normalizedInputAxis = inputAxis.setLength(1);
+
+		if (authoritative and isHost()) {
+			if (not ownsSimulation) {
+				takeOverSimulation();
+			}
+			simulation.setInput(getLocalPlayerID(), normalizedInputAxis);
+			stepSimulation(delta);
+			playerPos = simulation.position(getLocalPlayerID());
+		}
+		else {
+			const double speed = playerSpeed(getLocalPlayerID(), beTransparent);
+			playerPos = level->collider().move(playerPos, playerBodyRadius, normalizedInputAxis * speed * delta);
+		}
+
+		if (authoritative and not isHost() and inputAxis != sentInputAxis) {
+			sentInputAxis = inputAxis;
+			sendEvent(FromEnum(EventCode::playerInput), PlayerInputEvent{ inputAxis }, EventTargets{ hostID() });
+		}
+
+		Vec2 pos = playerPos;
 		if (prePos != pos) {
 			roomData.setPlayerPos(getLocalPlayerID(), pos);
-			sendEvent(FromEnum(EventCode::playerMove), Serializer<MemoryWriter>{}(pos));
+			if (not authoritative) {
+				sendEvent(FromEnum(EventCode::playerMove), serializeEvent(pos));
+			}
 			noMovingTime.restart();
-			roomData.beWatching(getLocalPlayerID(), false);
-			sendEvent(FromEnum(EventCode::beWatching), Serializer<MemoryWriter>{}(false));
 		}
 		if(beTransparent){
 			noMovingTime.restart();
+		}
+		if ((prePos != pos or beTransparent) and getPlayer().isWatching) {
 			roomData.beWatching(getLocalPlayerID(), false);
-			sendEvent(FromEnum(EventCode::beWatching), Serializer<MemoryWriter>{}(false));
+			sendEvent(FromEnum(EventCode::beWatching), serializeEvent(false));
 		}
 
 		if (beTransparent != getPlayer().isTransparent) {
+			const int32 startTime = serverNow();
 			roomData.beTransparent(getLocalPlayerID(), beTransparent);
-			flipFadeoutTimer(getLocalPlayerID());
-			sendEvent(FromEnum(EventCode::beTransparent), Serializer<MemoryWriter>{}(beTransparent));
+			flipFadeoutTimer(getLocalPlayerID(), startTime);
+			sendEvent(FromEnum(EventCode::beTransparent), serializeEvent(beTransparent, startTime));
 		}
 
 		if(noMovingTime > 1.0s){
 			if (not getPlayer().isWatching) {
 				roomData.beWatching(getLocalPlayerID(), true);
-				sendEvent(FromEnum(EventCode::beWatching), Serializer<MemoryWriter>{}(true));
+				sendEvent(FromEnum(EventCode::beWatching), serializeEvent(true));
 			}
 		}
 
-		for (auto& [id, player] : roomData.players()) {
-			Vec2& velocity = playersLocalData.at(id).velocity;
-			playersLocalData.at(id).pos = Math::SmoothDamp(playersLocalData.at(id).pos, player.pos, velocity, 1.0 / 20, unspecified, delta);
-			bool& isFacingRight = playersLocalData.at(id).isFacingRight;
-			if (velocity.x > 10) {
-				isFacingRight = true;
+		++roomTick;
+		const RectF activeArea = camera.getRegion().stretched(activeMargin);
+		smoothing.clear();
+		smoothingIndices.clear();
+		for (auto [i, player] : Indexed(roomData.players().replicated())) {
+			if (not activeArea.intersects(player.pos)) continue;
+			PlayerLocalData& localData = roomData.playerLocals()[i];
+			if (localData.smoothedTick + 1 != roomTick) {
+				// was out of range last tick; its smoothed position is stale
+				localData.pos = player.pos;
+				localData.prevPos = player.pos;
+				localData.velocity = Vec2{};
 			}
-			else if (velocity.x < -10) {
-				isFacingRight = false;
-			}
-			
+			localData.smoothedTick = roomTick;
+			smoothing.push(localData.pos, localData.velocity, player.pos, localData.isFacingRight);
+			smoothingIndices << i;
 		}
 
+		smoothing.update(1.0 / 20, delta, 10);
 
-		if (not tagStoppingTimer.isRunning() and isIt()) {
-			for (auto& [id, player] : roomData.players()) {
-				if (id == getLocalPlayerID())continue;
+		for (auto [k, i] : Indexed(smoothingIndices)) {
+			PlayerLocalData& localData = roomData.playerLocals()[i];
+			localData.prevPos = localData.pos;
+			localData.pos = smoothing.position(k);
+			localData.velocity = smoothing.velocity(k);
+			localData.isFacingRight = smoothing.isFacingRight(k);
+		}
 
-				if (playerBody.getPos().asCircle(playerRadius).intersects(playersLocalData.at(id).pos.asCircle(playerRadius))) {
-					roomData.setItID(id);
-					sendEvent(FromEnum(EventCode::itIDChange), Serializer<MemoryWriter>{}(id));
 
-					tagStoppingTimer.restart(3.0s);
-					roomData.clearTraps();
-					trapAccumulatedTime = 0.0;
-					sendEvent(FromEnum(EventCode::tagStop), Serializer<MemoryWriter>{});
+		// in authoritative mode the host checks tagging and traps in stepSimulation
+		if (not authoritative and not tagStoppingTimer.isRunning() and isIt()) {
+			// the grid holds the received positions; the drawn (smoothed) ones lag behind by up to smoothingSlack
+			// both trajectories are swept over the frame and the earliest contact wins
+			Optional<LocalPlayerID> tagged;
+			double firstContact = Largest<double>;
+			roomData.forEachPlayerInCircle(Circle{ playerPos, playerRadius * 2 + smoothingSlack + prePos.distanceFrom(playerPos) + maxPlayerSpeed * delta }, [&](LocalPlayerID id, const Player&) {
+				if (id == getLocalPlayerID())return;
+
+				const PlayerLocalData& other = roomData.players().localAt(id);
+				const auto contact = SweptContact::TimeOfContact(prePos, playerPos, other.prevPos, other.pos, playerRadius * 2);
+				if (contact and *contact < firstContact) {
+					firstContact = *contact;
+					tagged = id;
 				}
+			});
+			if (tagged) {
+				roomData.setItID(*tagged);
+				sendEvent(FromEnum(EventCode::itIDChange), serializeEvent(*tagged));
+
+				sendEvent(FromEnum(EventCode::tagStop), serializeEvent(startTagStop()));
 			}
 		}
 
-		for (trapAccumulatedTime += delta; trapAccumulatedTime >= trapStepTime; trapAccumulatedTime -= trapStepTime) {
+		if (not hasTrapEpoch) {
+			restartTrapCycle(serverClock.nowMillisec());
+		}
+
+		for (const int64 trapSteps = static_cast<int64>(trapElapsedTime() / trapStepTime); trapStepsDone < trapSteps; ++trapStepsDone) {
 
 			if (getPlayer().isTransparent) continue;
 
 			Color color = HSV(getPlayer().color).withS(0.5);
-			roomData.addTrap(playerBody.getPos(), getLocalPlayerID(), color);
-			sendEvent(FromEnum(EventCode::addTrap), Serializer<MemoryWriter>{}(playerBody.getPos(),color));
+			// the host numbers every trap so that handles agree between peers
+			if (isHost()) {
+				placeTrap(playerPos, getLocalPlayerID(), color);
+			}
+			else {
+				sendEvent(FromEnum(EventCode::requestAddTrap), serializeEvent(playerPos, color), EventTargets{ hostID() });
+			}
 		}
 
 
-		for (auto& [trapID,trap] : roomData.traps()) {
-			if (trap.ownerID == getLocalPlayerID())continue;
-			if (playerBody.getPos().asCircle(playerRadius).intersects(trap.pos.asCircle(trapBodyRadius))) {
+		if (not authoritative) {
+			roomData.forEachTrapInCircle(Circle{ playerPos, playerRadius + trapBodyRadius + prePos.distanceFrom(playerPos) }, [&](const TrapHandle& handle, const Trap& trap) {
+				if (trap.ownerID == getLocalPlayerID())return;
+				if (not SweptContact::TimeOfContact(prePos, playerPos, trap.pos, trap.pos, playerRadius + trapBodyRadius))return;
 
-				sendEvent(FromEnum(EventCode::requestTrappedToHost), Serializer<MemoryWriter>{}(trapID), Array{ hostID() });
-			}
+				sendEvent(FromEnum(EventCode::requestTrappedToHost), serializeEvent(handle), EventTargets{ hostID() });
+			});
 		}
 
-		if (getPlayer().isSlowdown and not playersLocalData.at(getLocalPlayerID()).slowdownTimer.isRunning()) {
+		if (getPlayer().isSlowdown and not roomData.playerLocal(getLocalPlayerID()).slowdownTimer.isRunning()) {
 			roomData.beSlowdown(getLocalPlayerID(), false);
-			sendEvent(FromEnum(EventCode::beSlowdown), Serializer<MemoryWriter>{}(false));
+			sendEvent(FromEnum(EventCode::beSlowdown), serializeEvent(false, int32{ 0 }));
 		}
 
 	}
 
-	void drawRoom() {
+	// alpha interpolates from the previous simulation tick to the latest one
+	void drawRoom(double alpha = 1.0, double delta = Scene::DeltaTime()) {
 
-		if (not hasRoomData) {
-			FontAsset(U"message")(U"データを受信中...").drawAt(Scene::Center(), Palette::White);
+		lastStateChanges = 0;
+
+		if (not hasGraphics) {
+			DrawStatus(StatusText::Loading);
 			return;
 		}
 
-		{
-			ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
-			TextureAsset(U"boseki").scaled(2).drawAt(spawnPos);
-		}
-		{
-			ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
-			for (auto& [id,trap] : roomData.traps()) {
-				
-				int32 page = static_cast<int32>(Scene::Time() / 0.25) % 4;
+		// lays out names whose glyphs arrived since the last frame
+		nameLabels.update();
 
-				TextureAsset(U"pow")(page % 2 * 32, page / 2 * 32, 32, 32).scaled(2).drawAt(trap.pos, trap.color);
-			}
+		if (not hasRoomData) {
+			DrawStatus(StatusText::ReceivingData);
+			return;
 		}
-		
 
-		for (auto& wall : walls) {
-			wall.draw(Color{ 79, 79, 79 });
-			
+		if (not isLevelReady()) {
+			DrawStatus(StatusText::ReceivingLevel);
+			return;
 		}
 
-		auto drawGoast = [&](const Vec2& pos, double alpha,LocalPlayerID id,const Player& player,const PlayerLocalData& localPlayer) {
-			ScopedColorMul2D scm{ 1.0,1.0,1.0,alpha };
-			{
-				ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
-				int32 i = static_cast<int32>((Scene::Time() + localPlayer.animationOffset) / 1.2) % 2;
+		// the camera follows at the display rate so it does not step with the simulation ticks
+		const Vec2 renderPos = previousPlayerPos.lerp(playerPos, alpha);
+		camera.setTargetCenter(cameraTarget(renderPos));
+		camera.update(delta);
 
-				Color color = player.color;
-				if(player.isSlowdown){
-					double t = Periodic::Sine0_1(0.5s, localPlayer.slowdownTimer.sF());
-					color = HSV(color).withV(Math::Map(t, 0, 1, 1, 0.5));
-				}
+		const RectF view = camera.getRegion();
+		wallChunks.update(level->collider().walls(), view);
+
+		{
+			const Transformer2D cameraTransformer = camera.createTransformer();
+			const RectF spriteView = view.stretched(spriteMargin);
+			// ghosts and traps behind walls are not drawn
+			const VisibilityPolygon& visible = visibility.compute(renderPos, visibilityRange);
+
+			// sprites all come from one atlas, so each batch draw is a single call
+			const SpriteAtlas& sprites = Sprites();
+			const uint64 spriteTextureID = sprites.texture().id().value();
+			const int32 powPage = static_cast<int32>(Scene::Time() / 0.25) % 4;
+
+			// walls and spawn markers are cached tiles with premultiplied colors; traps go on top
+			renderQueue.submit(FromEnum(RenderLayer::walls), RenderQueue::State{ SamplerState::Default2D, BlendState::Premultiplied }, [this, view] {
+				wallChunks.draw(view);
+			});
+
+			trapBatch.clear();
+
+			roomData.forEachTrapInRect(spriteView, [&](const TrapHandle&, const Trap& trap) {
+				if (not visible.intersects(Circle{ trap.pos, trapBodyRadius }))return;
+
+				trapBatch.add(sprites.texture(), sprites.region(Sprite::pow, RectF{ powPage % 2 * 32, powPage / 2 * 32, 32, 32 }), trap.pos, 2, trap.color);
+			});
+			renderQueue.submit(FromEnum(RenderLayer::traps), RenderQueue::State{ SamplerState::ClampNearest, BlendState::Default2D, nullptr, spriteTextureID }, [this] {
+				trapBatch.draw();
+			});
+
+			for (auto& batch : ghostBatches)batch.clear();
+			const double stillSeconds = noMovingTime.sF();
+			ghostShader.begin(stillSeconds);
+
+			auto drawGoast = [&](const Vec2& pos, uint32 flags,LocalPlayerID id,const Player& player,const PlayerLocalData& localPlayer) {
+				if (player.isTransparent)flags |= GhostShader::Transparent;
+				if (player.isSlowdown)flags |= GhostShader::Slowdown;
+				const uint32 slot = ghostShader.add(localPlayer.fadeoutTimer, localPlayer.slowdownTimer, flags);
+				const size_t page = GhostShader::PageOf(slot);
+				if (ghostBatches.size() <= page)ghostBatches.resize(page + 1);
+				SpriteBatch& ghostBatch = ghostBatches[page];
+
+				int32 i = static_cast<int32>((Scene::Time() + localPlayer.animationOffset) / 1.2) % 2;
 
-				TextureAsset(U"goast_body")(0, 32 * i, 32, 32).scaled(2).mirrored(localPlayer.isFacingRight).drawAt(pos, color);
+				ghostBatch.add(sprites.texture(), sprites.region(Sprite::goastBody, RectF{ 0, 32 * i, 32, 32 }), pos, 2, GhostShader::VertexColor(slot, player.color, true), localPlayer.isFacingRight);
 
 				if (player.isWatching) {
 
-					TextureAsset(U"goast_eye")(0, 32 * 2, 32, 32).scaled(2).mirrored(localPlayer.isFacingRight).drawAt(pos);
+					ghostBatch.add(sprites.texture(), sprites.region(Sprite::goastEye, RectF{ 0, 32 * 2, 32, 32 }), pos, 2, GhostShader::VertexColor(slot, ColorF{ 1.0 }, false), localPlayer.isFacingRight);
 				}
 				else {
-					TextureAsset(U"goast_eye")(0, 0, 32, 32).scaled(2).mirrored(localPlayer.isFacingRight).drawAt(pos);
+					ghostBatch.add(sprites.texture(), sprites.region(Sprite::goastEye, RectF{ 0, 0, 32, 32 }), pos, 2, GhostShader::VertexColor(slot, ColorF{ 1.0 }, false), localPlayer.isFacingRight);
 				}
-			}
-			double x_sign = localPlayer.isFacingRight ? 1 : -1;
-			if (id == roomData.itID())drawCrown(pos + Vec2(x_sign * 3, -30 + Periodic::Sine1_1(2) * 3));
-
-			//Circle{ pos,playerRadius }.drawFrame(2, Palette::Black);
+				double x_sign = localPlayer.isFacingRight ? 1 : -1;
+				if (id == roomData.itID())drawCrown(ghostBatch, pos + Vec2(x_sign * 3, -30 + Periodic::Sine1_1(2) * 3), GhostShader::VertexColor(slot, ColorF{ 1.0 }, false));
 
-			FontAsset(U"name")(player.name).drawAt(pos + Vec2{ 0,30 }, ColorF(1));
-		};
+				//Circle{ pos,playerRadius }.drawFrame(2, Palette::Black);
 
-		for (auto& [id, player] : roomData.players()) {
-			if (id == getLocalPlayerID())continue;
-			const PlayerLocalData& localPlayer = playersLocalData.at(id);
+				// names are drawn after the batch with the font shader, so their alpha is computed here
+				nameLabels.add(id, pos + Vec2{ 0,30 }, ColorF(1, GhostShader::Alpha(localPlayer.fadeoutTimer, flags, stillSeconds)));
+			};
 
-			double alpha = 1.0;
-			if (player.isTransparent) {
-				alpha = localPlayer.fadeoutTimer.progress1_0();
-				if(noMovingTime > 1.0s){
-					alpha = Min((noMovingTime.sF() - 1.0), 0.5);
-				}
-			}
-			else {
-				alpha = localPlayer.fadeoutTimer.progress0_1();
+			// ID order, so every client stacks overlapping ghosts the same way
+			for (auto [i, id] : Indexed(roomData.players().ids())) {
+				if (id == getLocalPlayerID())continue;
+				const Player& player = roomData.players().replicated()[i];
+				const PlayerLocalData& localPlayer = roomData.players().locals()[i];
+				// ghosts outside the active area were not smoothed this tick and their drawn position is stale
+				const Vec2 pos = localPlayer.prevPos.lerp(localPlayer.pos, alpha);
+				if (localPlayer.smoothedTick != roomTick or not spriteView.intersects(pos))continue;
+				// the host no longer sends where it is, so the last position would show a frozen ghost
+				if (localPlayer.isOutOfInterest)continue;
+				if (not visible.intersects(Circle{ pos, playerBodyRadius }))continue;
+
+				const uint32 flags = ((not isIt() and id != roomData.itID()) ? GhostShader::Dimmed : 0);
+				drawGoast(pos, flags, id, player, localPlayer);
 			}
-			if(not isIt() and id != roomData.itID()){
-				alpha = Math::Map(alpha, 0.0, 1.0, 0.5, 1.0);
+
+			const Player& player = getPlayer();
+			LocalPlayerID id = getLocalPlayerID();
+			const PlayerLocalData& localPlayer = roomData.players().localAt(id);
+			const Vec2& pos = renderPos;
+			drawGoast(pos, GhostShader::Self, id, player, localPlayer);
+
+			// same layer and state, so the pages keep this order and the local ghost stays on top
+			for (size_t page = 0; page < ghostShader.pageCount(); ++page) {
+				renderQueue.submit(FromEnum(RenderLayer::ghosts), RenderQueue::State{ SamplerState::ClampNearest, BlendState::Default2D, &ghostShader.pixelShader(), spriteTextureID }, [this, page] {
+					ghostShader.draw(page, ghostBatches[page]);
+				});
 			}
-			const Vec2& pos = localPlayer.pos;
-			drawGoast(pos, alpha, id, player, localPlayer);
+			renderQueue.submit(FromEnum(RenderLayer::names), RenderQueue::State{ SamplerState::Default2D, BlendState::Default2D, &nameLabels.pixelShader() }, [this] {
+				nameLabels.draw();
+			});
+
+			// flushed inside the camera transform
+			lastStateChanges = renderQueue.flush();
 		}
 
 		const Player& player = getPlayer();
-		LocalPlayerID id = getLocalPlayerID();
-		const PlayerLocalData& localPlayer = playersLocalData.at(id);
-		double alpha = 1.0;
-		if (player.isTransparent) {
-			alpha = (localPlayer.fadeoutTimer.progress1_0() * 0.75 + 0.25);
-		}
-		else {
-			alpha = (localPlayer.fadeoutTimer.progress0_1() * 0.75 + 0.25);
-		}
-		const Vec2& pos = playerBody.getPos();
-		drawGoast(pos, alpha, id, player, localPlayer);
 		
 		if(tagStoppingTimer.isRunning()){
-			FontAsset(U"message")(U"鬼ごっこ再開まで…", tagStoppingTimer.s_ceil(), U"秒").drawAt(Vec2{ 400,550 }, Palette::White);
+			renderQueue.submit(FromEnum(RenderLayer::hudBack), RenderQueue::State{}, [this] {
+				MessageGlyphs().drawAt(Fmt(StatusText::TagRestart)(tagStoppingTimer.s_ceil()), Vec2{ 400,550 }, Palette::White);
+			});
 		}
 
 		//observerAccumulatedTime Circle
-		Circle trapAccumulatedCircle{ Scene::Size() - Vec2{40,40},25 };
-		trapAccumulatedCircle.draw(Palette::Dimgray);
-		{
-			ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
+		const Circle trapAccumulatedCircle{ Scene::Size() - Vec2{40,40},25 };
+		renderQueue.submit(FromEnum(RenderLayer::hudBack), RenderQueue::State{}, [trapAccumulatedCircle] {
+			trapAccumulatedCircle.draw(Palette::Dimgray);
+		});
+		const SpriteAtlas& sprites = Sprites();
+		renderQueue.submit(FromEnum(RenderLayer::hudIcon), RenderQueue::State{ SamplerState::ClampNearest, BlendState::Default2D, nullptr, sprites.texture().id().value() }, [&sprites, trapAccumulatedCircle, color = HSV(player.color).withS(0.5)] {
 			int32 page = static_cast<int32>(Scene::Time() / 0.25) % 4;
 
-			TextureAsset(U"pow")(page % 2 * 32, page / 2 * 32, 32, 32).scaled(2).drawAt(trapAccumulatedCircle.center, HSV(player.color).withS(0.5));
-		}
-		trapAccumulatedCircle.drawPie(0, trapAccumulatedTime / trapStepTime * Math::TwoPi, ColorF(1, 0.3)).drawFrame(3, Palette::Gray);
-		if (player.isTransparent) {
-			trapAccumulatedCircle.drawFrame(3, Palette::Red);
-			Vec2 dir = Circular{ trapAccumulatedCircle.r, 45_deg };
-			Line{ trapAccumulatedCircle.center - dir,trapAccumulatedCircle.center + dir }.draw(3, Palette::Red);
-		}
+			sprites.texture()(sprites.region(Sprite::pow, RectF{ page % 2 * 32, page / 2 * 32, 32, 32 })).scaled(2).drawAt(trapAccumulatedCircle.center, color);
+		});
+		renderQueue.submit(FromEnum(RenderLayer::hudFront), RenderQueue::State{}, [this, trapAccumulatedCircle, isTransparent = player.isTransparent] {
+			trapAccumulatedCircle.drawPie(0, Math::Fmod(trapElapsedTime(), trapStepTime) / trapStepTime * Math::TwoPi, ColorF(1, 0.3)).drawFrame(3, Palette::Gray);
+			if (isTransparent) {
+				trapAccumulatedCircle.drawFrame(3, Palette::Red);
+				Vec2 dir = Circular{ trapAccumulatedCircle.r, 45_deg };
+				Line{ trapAccumulatedCircle.center - dir,trapAccumulatedCircle.center + dir }.draw(3, Palette::Red);
+			}
+		});
+
+		lastStateChanges += renderQueue.flush();
 
 		if (SimpleGUI::Button(U"Exit", Vec2{ 700,10 })) {
+			saveRecording();
 			leaveRoom();
 			state = NetWorkState::Leaving;
 		}
@@ -551,23 +1347,39 @@ public:
 
 	void disconnectReturn() override
 	{
+		saveRecording();
 		state = NetWorkState::Disconnected;
 	}
 
 	void leaveRoomReturn(int32 errorCode, const String& errorString) override
 	{
+		saveRecording();
 		state = NetWorkState::InLobby;
 	}
 
 	void joinRoomEventAction(const LocalPlayer& newPlayer, [[maybe_unused]] const Array<LocalPlayerID>& playerIDs, const bool isSelf) override {
+		if (isSelf and recordDirectory) {
+			const uint64 seed = RandomUint64();
+			Reseed(seed);
+			recorder.start(newPlayer.localID, isHost(), userNameBox.text, seed);
+		}
+		recorder.addJoinEvent(newPlayer.localID, isSelf);
+
 		if (isSelf) {
 			state = NetWorkState::InRoom;
 
 			noMovingTime.restart();
 			if (isHost()) {
 
-				roomData.addPlayer(newPlayer.localID, Vec2{ 400,300 }, RandomColor(), userNameBox.text);
-				playersLocalData.insert_or_assign(newPlayer.localID, PlayerLocalData{ Vec2{ 400,300 } });
+				const Vec2 pos = level->spawnPoints().choice();
+				playerPos = pos;
+				previousPlayerPos = playerPos;
+				camera.jumpTo(cameraTarget(pos), 1.0);
+				roomData.addPlayer(newPlayer.localID, pos, RandomColor(), userNameBox.text, PlayerLocalData{ pos, serverClock });
+				nameLabels.set(newPlayer.localID, userNameBox.text);
+				if (authoritative) {
+					simulation.setPlayer(newPlayer.localID, pos);
+				}
 
 				roomData.setItID(newPlayer.localID);
 			}
@@ -576,48 +1388,77 @@ public:
 		}
 		else {
 			if (isHost()) {
-				sendEvent(FromEnum(EventCode::roomDataFromHost), Serializer<MemoryWriter>{}(roomData, trapAccumulatedTime), Array{ newPlayer.localID });
+				if (not hasTrapEpoch) {
+					restartTrapCycle(serverNow());
+				}
+				const bool isTagStopping = tagStoppingTimer.isRunning();
+				// only the level hash is sent; clients without a cached copy ask with requestLevel
+				const Array<uint8> levelHash(level->hash().value.begin(), level->hash().value.end());
+				sendEvent(FromEnum(EventCode::roomDataFromHost), serializeEvent(roomData, trapEpochMillisec, isTagStopping, tagStoppingTimer.deadlineMillisec(), levelHash, authoritative), EventTargets{ newPlayer.localID });
 			}
 		}
 	}
 
 	void leaveRoomEventAction(const LocalPlayerID playerID, [[maybe_unused]] const bool isInactive) override {
+		recorder.addLeaveEvent(playerID, isInactive);
+
 		if (isHost()) {
 
 			if(playerID == roomData.itID()){
 				roomData.setItID(getLocalPlayerID());
-				sendEvent(FromEnum(EventCode::itIDChange), Serializer<MemoryWriter>{}(getLocalPlayerID()));
+				sendEvent(FromEnum(EventCode::itIDChange), serializeEvent(getLocalPlayerID()));
 
-				tagStoppingTimer.restart(3.0s);
-				roomData.clearTraps();
-				trapAccumulatedTime = 0.0;
-				sendEvent(FromEnum(EventCode::tagStop), Serializer<MemoryWriter>{});
+				sendEvent(FromEnum(EventCode::tagStop), serializeEvent(startTagStop()));
 			}
 
 			roomData.erasePlayer(playerID);
-			playersLocalData.erase(playerID);
 			roomData.eraseTrap(playerID);
-			sendEvent(FromEnum(EventCode::playerErase), Serializer<MemoryWriter>{}(playerID));
+			levelUploads.remove_if([playerID](const LevelUpload& upload) { return upload.playerID == playerID; });
+			nameLabels.erase(playerID);
+			simulation.erase(playerID);
+			awaitingInputSync.erase(playerID);
+			interest.erase(playerID);
+			sendEvent(FromEnum(EventCode::playerErase), serializeEvent(playerID));
 		}
 	}
 
 	void customEventAction(const LocalPlayerID playerID, const uint8 eventCode, Deserializer<MemoryViewReader>& reader) override
 	{
+		recorder.addCustomEvent(playerID, eventCode, reader);
+
 		auto eventCodeEnum = ToEnum<EventCode>(eventCode);
 		switch (eventCodeEnum) {
 		case EventCode::roomDataFromHost:
 		{
 			assert(not hasRoomData);
-			reader(roomData, trapAccumulatedTime);
+			int32 trapEpoch;
+			bool isTagStopping;
+			int32 tagStopDeadline;
+			Array<uint8> levelHashBytes;
+			reader(roomData, trapEpoch, isTagStopping, tagStopDeadline, levelHashBytes, authoritative);
+			roomData.rebuildSpatialIndex();
+			restartTrapCycle(trapEpoch);
+			// traps for steps that passed before joining were already placed by the host's clock
+			trapStepsDone = static_cast<int64>(trapElapsedTime() / trapStepTime);
+			if (isTagStopping) {
+				tagStoppingTimer.restartUntil(tagStopDeadline, tagStopTime);
+			}
 			hasRoomData = true;
-			Vec2 pos = Vec2{ 400,300 };
-			Color color = RandomColor();
-			for(auto [id,player] : roomData.players()){
-				playersLocalData.insert_or_assign(id, PlayerLocalData{ player.pos });
+			for (auto [i, player] : Indexed(roomData.players().replicated())) {
+				roomData.playerLocals()[i] = PlayerLocalData{ player.pos, serverClock };
+				nameLabels.set(roomData.players().ids()[i], player.name);
+			}
+
+			MD5Value levelHash;
+			std::copy_n(levelHashBytes.begin(), Min(levelHashBytes.size(), levelHash.value.size()), levelHash.value.begin());
+			if (auto cached = LevelCache::Find(levelHash)) {
+				setLevel(std::move(*cached));
+				enterLevel();
+			}
+			else {
+				pendingLevelHash = levelHash;
+				requestLevel();
 			}
-			roomData.addPlayer(getLocalPlayerID(), pos, color, userNameBox.text);
-			playersLocalData.insert_or_assign(getLocalPlayerID(), PlayerLocalData{ pos });
-			sendEvent(FromEnum(EventCode::playerAdd), Serializer<MemoryWriter>{}(pos, color, userNameBox.text));
 		}
 			break;
 		case EventCode::playerAdd:
@@ -627,8 +1468,11 @@ public:
 			Color color;
 			String name;
 			reader(pos, color, name);
-			roomData.addPlayer(playerID, pos, color, name);
-			playersLocalData.insert_or_assign(playerID, PlayerLocalData{ pos });
+			roomData.addPlayer(playerID, pos, color, name, PlayerLocalData{ pos, serverClock });
+			nameLabels.set(playerID, name);
+			if (authoritative and isHost()) {
+				simulation.setPlayer(playerID, pos);
+			}
 		}
 			break;
 		case EventCode::playerErase:
@@ -636,12 +1480,15 @@ public:
 			LocalPlayerID erasePlayerID;
 			reader(erasePlayerID);
 			roomData.erasePlayer(erasePlayerID);
-			playersLocalData.erase(erasePlayerID);
 			roomData.eraseTrap(erasePlayerID);
+			nameLabels.erase(erasePlayerID);
 			break;
 		case EventCode::playerMove:
 		{
-			if (not hasRoomData) return;
+			// positions reported by clients are not trusted in authoritative mode
+			if (not hasRoomData or authoritative) return;
+			// the sender may not be in this client's table yet, e.g. a snapshot taken before its playerAdd
+			if (not roomData.players().contains(playerID)) return;
 			Vec2 pos;
 			reader(pos);
 			roomData.setPlayerPos(playerID, pos);
@@ -649,16 +1496,17 @@ public:
 			break;
 		case EventCode::beTransparent:
 		{
-			if (not hasRoomData) return;
+			if (not hasRoomData or not roomData.players().contains(playerID)) return;
 			bool beTransparent;
-			reader(beTransparent);
+			int32 startTime;
+			reader(beTransparent, startTime);
 			roomData.beTransparent(playerID, beTransparent);
-			flipFadeoutTimer(playerID);
+			flipFadeoutTimer(playerID, startTime);
 		}
 			break;
 		case EventCode::beWatching:
 		{
-			if (not hasRoomData) return;
+			if (not hasRoomData or not roomData.players().contains(playerID)) return;
 			bool beWatching;
 			reader(beWatching);
 			roomData.beWatching(playerID, beWatching);
@@ -666,19 +1514,21 @@ public:
 			break;
 		case EventCode::beSlowdown:
 		{
-			if (not hasRoomData) return;
+			if (not hasRoomData or not roomData.players().contains(playerID)) return;
 			bool beSlowdown;
-			reader(beSlowdown);
+			int32 deadline;
+			reader(beSlowdown, deadline);
 			roomData.beSlowdown(playerID, beSlowdown);
-			if (beSlowdown)playersLocalData.at(playerID).slowdownTimer.restart(slowDownTime);
+			if (beSlowdown)roomData.playerLocal(playerID).slowdownTimer.restartUntil(deadline, slowDownTime);
 		}
 			break;
 		case EventCode::playerNameChange:
 		{
-			if (not hasRoomData) return;
+			if (not hasRoomData or not roomData.players().contains(playerID)) return;
 			String name;
 			reader(name);
 			roomData.setPlayerName(playerID, name);
+			nameLabels.set(playerID, name);
 		}
 			break;
 		case EventCode::itIDChange:
@@ -692,18 +1542,31 @@ public:
 		case EventCode::tagStop:
 		{
 			if (not hasRoomData) return;
-			tagStoppingTimer.restart(3.0s);
-			roomData.clearTraps();
-			trapAccumulatedTime = 0.0;
+			int32 deadline;
+			reader(deadline);
+			stopTag(deadline);
 		}
 			break;
 		case EventCode::addTrap:
 		{
 			if (not hasRoomData) return;
+			TrapHandle handle;
+			Vec2 pos;
+			LocalPlayerID ownerID;
+			Color color;
+			reader(handle, pos, ownerID, color);
+			roomData.insertTrap(handle, pos, ownerID, color);
+		}
+			break;
+		case EventCode::requestAddTrap:
+		{
+			if (not hasRoomData or not isHost()) return;
 			Vec2 pos;
 			Color color;
-			reader(pos,color);
-			roomData.addTrap(pos, playerID,color);
+			reader(pos, color);
+			// the owner may have left while the request was in flight
+			if (not roomData.players().contains(playerID)) return;
+			placeTrap(pos, playerID, color);
 		}
 			break;
 		case EventCode::requestTrappedToHost:
@@ -711,13 +1574,9 @@ public:
 			if (not hasRoomData) return;
 
 			if (isHost()) {
-				size_t trapID;
-				reader(trapID);
-				if(roomData.traps().contains(trapID)){
-					roomData.eraseTrap(trapID);
-					sendEvent(FromEnum(EventCode::eraseTrap), Serializer<MemoryWriter>{}(trapID));
-					sendEvent(FromEnum(EventCode::solveTrapped), Serializer<MemoryWriter>{}, Array{ playerID });
-				}
+				TrapHandle handle;
+				reader(handle);
+				trapPlayer(handle, playerID);
 			}
 		}
 			break;
@@ -725,17 +1584,115 @@ public:
 		{
 			if (not hasRoomData) return;
 
+			int32 deadline;
+			reader(deadline);
 			roomData.beSlowdown(getLocalPlayerID(), true);
-			playersLocalData.at(getLocalPlayerID()).slowdownTimer.restart(slowDownTime);
-			sendEvent(FromEnum(EventCode::beSlowdown), Serializer<MemoryWriter>{}(true));
+			roomData.playerLocal(getLocalPlayerID()).slowdownTimer.restartUntil(deadline, slowDownTime);
+			sendEvent(FromEnum(EventCode::beSlowdown), serializeEvent(true, deadline));
 		}
 			break;
 		case EventCode::eraseTrap:
 		{
 			if (not hasRoomData) return;
-			size_t trapID;
-			reader(trapID);
-			roomData.eraseTrap(trapID);
+			TrapHandle handle;
+			reader(handle);
+			roomData.eraseTrap(handle);
+		}
+			break;
+		case EventCode::requestLevel:
+		{
+			if (not isHost() or not level) return;
+
+			// a host that took over from the original one has the level but not its baked bytes
+			if (levelBlob.isEmpty()) {
+				levelBlob = level->bake();
+			}
+			// Photon limits a single event, so the baked level goes out in chunks over the next ticks; a repeated request starts over
+			levelUploads.remove_if([playerID](const LevelUpload& upload) { return upload.playerID == playerID; });
+			levelUploads << LevelUpload{ .playerID = playerID };
+		}
+			break;
+		case EventCode::levelChunk:
+		{
+			if (not pendingLevelHash) return;
+			uint64 totalSize;
+			uint64 offset;
+			reader(totalSize, offset, levelChunkBuffer);
+			if (totalSize < offset + levelChunkBuffer.size()) return;
+
+			// chunks from one upload arrive in order; an upload restarted by a retry begins again at 0
+			if (offset == 0) {
+				levelDownload.assign(static_cast<size_t>(totalSize), 0);
+				levelDownloadReceived = 0;
+			}
+			if (levelDownload.size() != totalSize or offset != levelDownloadReceived) return;
+			std::copy(levelChunkBuffer.begin(), levelChunkBuffer.end(), levelDownload.begin() + static_cast<size_t>(offset));
+			levelDownloadReceived += levelChunkBuffer.size();
+			levelRequestTime.restart();
+			if (levelDownloadReceived < totalSize) return;
+
+			auto downloaded = Level::FromBaked(levelDownload.data(), levelDownload.size());
+			if (not downloaded or downloaded->hash() != *pendingLevelHash) {
+				retryLevelRequest();
+				return;
+			}
+			LevelCache::Store(downloaded->hash(), Blob{ levelDownload.data(), levelDownload.size() });
+			levelBlob = Blob{ levelDownload.data(), levelDownload.size() };
+			setLevel(std::move(*downloaded));
+			enterLevel();
+			pendingLevelHash.reset();
+			levelDownload.clear();
+			levelDownloadReceived = 0;
+		}
+			break;
+		case EventCode::playerInput:
+		{
+			// only reached in a replay; live input arrives through the PlayerInputEvent handler
+			PlayerInputEvent event;
+			if (reader->read(&event, sizeof(event)) != static_cast<int64>(sizeof(event))) return;
+			applyPlayerInput(playerID, event.axis);
+		}
+			break;
+		case EventCode::requestInput:
+		{
+			if (not hasRoomData or not authoritative or isHost() or not isLevelReady()) return;
+			sendEvent(FromEnum(EventCode::inputSync), serializeEvent(playerPos, sentInputAxis), EventTargets{ hostID() });
+		}
+			break;
+		case EventCode::inputSync:
+		{
+			if (not hasRoomData or not authoritative or not isHost()) return;
+			Vec2 pos;
+			Vec2 axis;
+			reader(pos, axis);
+			if (not simulation.contains(playerID)) return;
+			// the client's own position is taken only once, in place of the stale replica the simulation was rebuilt from
+			if (awaitingInputSync.erase(playerID)) {
+				simulation.setPlayer(playerID, pos);
+				roomData.setPlayerPos(playerID, pos);
+			}
+			simulation.setInput(playerID, axis);
+		}
+			break;
+		case EventCode::authoritativeMove:
+		{
+			if (not hasRoomData or not authoritative or playerID != hostID()) return;
+			reader(movedIDs, movedPositions, hiddenIDs);
+			for (const LocalPlayerID id : hiddenIDs) {
+				if (not roomData.players().contains(id) or id == getLocalPlayerID()) continue;
+				roomData.playerLocal(id).isOutOfInterest = true;
+			}
+			for (size_t i = 0; i < Min(movedIDs.size(), movedPositions.size()); ++i) {
+				const LocalPlayerID id = movedIDs[i];
+				if (not roomData.players().contains(id)) continue;
+				roomData.playerLocal(id).isOutOfInterest = false;
+				if (id == getLocalPlayerID()) {
+					// the host lags behind the prediction by the round trip; only a large gap means the prediction was wrong
+					if (playerPos.distanceFrom(movedPositions[i]) <= correctionDistance) continue;
+					playerPos = movedPositions[i];
+				}
+				roomData.setPlayerPos(id, movedPositions[i]);
+			}
 		}
 			break;
 		default:
@@ -745,36 +1702,576 @@ public:
 	}
 };
 
+struct LaunchOptions {
+	Optional<FilePath> recordDirectory;
+	Optional<FilePath> replayBenchmarkPath;
+	bool replayDraw = false;
+	Optional<FilePath> benchmarkJSONPath;
+	bool assertZeroAllocation = false;
+	bool allocationCheck = false;
+	bool collisionBenchmark = false;
+	bool simulationBenchmark = false;
+	bool smoothingBenchmark = false;
+	bool authoritative = false;
+	Optional<FilePath> levelPath;
+	Optional<std::pair<FilePath, FilePath>> bakeLevel;
+	double tickRate = 60;
+	double networkRate = 60;
+	// 0 means no limit beyond vsync
+	double frameLimit = 0;
+	bool headless = false;
+	Optional<FilePath> inputScriptPath;
+	String roomName = U"room";
+	// headless exit criteria; 0 means no limit
+	uint64 headlessTicks = 0;
+	double headlessSeconds = 0;
+	Optional<FilePath> startupReportPath;
+
+	static LaunchOptions Parse(const Array<String>& args) {
+		LaunchOptions options;
+		for (size_t i = 1; i < args.size(); ++i) {
+			const String& arg = args[i];
+			const bool hasValue = (i + 1 < args.size());
+			if (arg == U"--record" and hasValue) {
+				FilePath directory = args[++i];
+				if (not directory.ends_with(U'/')) {
+					directory.push_back(U'/');
+				}
+				options.recordDirectory = directory;
+			}
+			else if (arg == U"--replay-bench" and hasValue) {
+				options.replayBenchmarkPath = args[++i];
+			}
+			else if (arg == U"--draw") {
+				options.replayDraw = true;
+			}
+			else if (arg == U"--json" and hasValue) {
+				options.benchmarkJSONPath = args[++i];
+			}
+			else if (arg == U"--assert-zero-alloc") {
+				options.assertZeroAllocation = true;
+			}
+			else if (arg == U"--alloc-check") {
+				options.allocationCheck = true;
+			}
+			else if (arg == U"--collision-bench") {
+				options.collisionBenchmark = true;
+			}
+			else if (arg == U"--sim-bench") {
+				options.simulationBenchmark = true;
+			}
+			else if (arg == U"--smooth-bench") {
+				options.smoothingBenchmark = true;
+			}
+			else if (arg == U"--authoritative") {
+				options.authoritative = true;
+			}
+			else if (arg == U"--level" and hasValue) {
+				options.levelPath = args[++i];
+			}
+			else if (arg == U"--bake-level" and (i + 2 < args.size())) {
+				const FilePath source = args[++i];
+				const FilePath output = args[++i];
+				options.bakeLevel = std::pair{ source, output };
+			}
+			else if (arg == U"--tick-rate" and hasValue) {
+				options.tickRate = ParseOr<double>(args[++i], options.tickRate);
+			}
+			else if (arg == U"--net-rate" and hasValue) {
+				options.networkRate = ParseOr<double>(args[++i], options.networkRate);
+			}
+			else if (arg == U"--fps-limit" and hasValue) {
+				options.frameLimit = ParseOr<double>(args[++i], options.frameLimit);
+			}
+			else if (arg == U"--headless") {
+				options.headless = true;
+			}
+			else if (arg == U"--input-script" and hasValue) {
+				options.inputScriptPath = args[++i];
+			}
+			else if (arg == U"--room" and hasValue) {
+				options.roomName = args[++i];
+			}
+			else if (arg == U"--ticks" and hasValue) {
+				options.headlessTicks = ParseOr<uint64>(args[++i], options.headlessTicks);
+			}
+			else if (arg == U"--seconds" and hasValue) {
+				options.headlessSeconds = ParseOr<double>(args[++i], options.headlessSeconds);
+			}
+			else if (arg == U"--startup-report" and hasValue) {
+				options.startupReportPath = args[++i];
+			}
+		}
+		return options;
+	}
+};
+
+// returns false if the record cannot be loaded or the zero allocation check was requested and did not pass
+bool RunReplayBenchmark(const std::string& secretAppID, const LaunchOptions& options) {
+	Console.open();
+
+	const Optional<SessionRecord> record = SessionRecord::Load(*options.replayBenchmarkPath);
+	if (not record) {
+		Console << U"[replay-bench] failed to load " << *options.replayBenchmarkPath;
+		return false;
+	}
+
+	ReplayClock clock;
+	SetGameClock(&clock);
+	Reseed(record->randomSeed);
+
+	MyNetwork network{ secretAppID, AppVersion, Verbose::No };
+	network.replayLocalPlayerID = record->localPlayerID;
+	network.replayIsHost = record->isHost;
+	if (options.levelPath) {
+		network.levelPath = *options.levelPath;
+	}
+	network.hostAuthoritative = options.authoritative;
+	network.initWhenEnterLobby();
+	network.userNameBox.text = record->userName;
+	if (record->isHost) {
+		if (not network.initWhenCreateRoom()) {
+			Console << U"[replay-bench] failed to load the level " << network.levelPath;
+			return false;
+		}
+	}
+	else {
+		network.initWhenJoinRoom();
+	}
+
+	Optional<RenderTexture> target;
+	if (options.replayDraw) {
+		target.emplace(Scene::Size());
+		network.initGraphics();
+	}
+
+	BenchmarkStats stats;
+	stats.reserve(record->frames.size());
+
+	// updateRoom on frames with no events and no new traps is the steady state whose allocations are counted
+	size_t steadyStateFrames = 0;
+	uint64 steadyStateAllocations = 0;
+	uint64 totalStateChanges = 0;
+
+	for (const auto& frame : record->frames) {
+		clock.advance(frame.deltaTime);
+
+		const uint64 allocationsBefore = AllocationCounter::GetCount();
+		const uint64 begin = Time::GetNanosec();
+
+		network.replayServerTimeMillisec = frame.serverTimeMillisec;
+
+		for (const auto& event : frame.events) {
+			network.replayEvent(event);
+		}
+
+		const size_t trapCountBefore = network.roomData.traps().size();
+		const uint64 updateAllocationsBefore = AllocationCounter::GetCount();
+
+		network.updateRoom(frame.input, frame.deltaTime);
+
+		if (frame.events.isEmpty() and (network.roomData.traps().size() <= trapCountBefore)) {
+			++steadyStateFrames;
+			steadyStateAllocations += (AllocationCounter::GetCount() - updateAllocationsBefore);
+		}
+
+		if (target) {
+			MessageGlyphs().update();
+			NameGlyphs().update();
+			{
+				const ScopedRenderTarget2D renderTarget{ target->clear(Color{ 66, 57, 36 }) };
+				network.drawRoom(1.0, frame.deltaTime);
+			}
+			Graphics2D::Flush();
+			totalStateChanges += network.lastStateChanges;
+		}
+
+		const uint64 end = Time::GetNanosec();
+		stats.addSample((end - begin) / 1'000'000.0, (AllocationCounter::GetCount() - allocationsBefore));
+	}
+
+	SetGameClock(nullptr);
+
+	const size_t eventCount = record->countEvents();
+	const double totalSeconds = (stats.total() / 1000.0);
+
+	JSON summary = stats.toJSON();
+	summary[U"record"] = *options.replayBenchmarkPath;
+	summary[U"draw"] = options.replayDraw;
+	summary[U"frames"] = record->frames.size();
+	summary[U"events"] = eventCount;
+	summary[U"events_per_second"] = ((0.0 < totalSeconds) ? (eventCount / totalSeconds) : 0.0);
+	summary[U"steady_state_frames"] = steadyStateFrames;
+	summary[U"steady_state_allocations"] = steadyStateAllocations;
+
+	if (options.replayDraw) {
+		summary[U"state_changes_per_frame"] = (record->frames ? (static_cast<double>(totalStateChanges) / record->frames.size()) : 0.0);
+	}
+
+	// allocations are only counted in the Benchmark configuration, so elsewhere the check cannot pass
+	const bool passed = (AllocationCounter::Enabled and (steadyStateAllocations == 0));
+	if (options.assertZeroAllocation) {
+		summary[U"zero_allocation_check"] = (not AllocationCounter::Enabled) ? U"unavailable" : (passed ? U"passed" : U"failed");
+	}
+
+	BenchmarkRun::Finish(summary, options.benchmarkJSONPath);
+
+	if (options.assertZeroAllocation and (not passed)) {
+		Console << U"[replay-bench] zero allocation check failed: {} allocations in {} steady-state frames"_fmt(steadyStateAllocations, steadyStateFrames);
+	}
+
+	return (passed or (not options.assertZeroAllocation));
+}
+
+// an offline host runs a fixed move/watch/trap workload and sends it through the send budget;
+// after one loop of the script has warmed every buffer up, any allocation fails the check
+bool RunAllocationCheck(const std::string& secretAppID, const LaunchOptions& options) {
+	BenchmarkRun::Begin();
+
+	constexpr double tickTime = 1.0 / 60;
+	constexpr LocalPlayerID localID = 1;
+	// traps are taken by a player that is not simulated, so the pool stays small and its slots are reused
+	constexpr LocalPlayerID trappedID = 2;
+	constexpr size_t maxTraps = 8;
+
+	ReplayClock clock;
+	SetGameClock(&clock);
+
+	MyNetwork network{ secretAppID, AppVersion, Verbose::No };
+	network.replayLocalPlayerID = localID;
+	network.replayIsHost = true;
+	if (options.levelPath) {
+		network.levelPath = *options.levelPath;
+	}
+	network.initSendScheduler();
+
+	uint64 sentEvents = 0;
+	uint64 sentBytes = 0;
+	network.setOfflineSendHandler([&](uint8, size_t size) {
+		++sentEvents;
+		sentBytes += size;
+	});
+
+	network.initWhenEnterLobby();
+	if (not network.initWhenCreateRoom()) {
+		Console << U"[alloc-check] failed to load the level " << network.levelPath;
+		return false;
+	}
+	network.replayEvent(RecordedEvent{ .type = RecordedEventType::Join, .playerID = localID, .flag = true });
+
+	const InputScript script = InputScript::RandomWalk(BenchmarkRun::Seed);
+	const int64 warmupTicks = static_cast<int64>(Math::Ceil(script.duration() / tickTime));
+	const int64 measuredTicks = warmupTicks;
+
+	uint64 allocations = 0;
+	uint64 allocatingTicks = 0;
+	uint64 measuredEvents = 0;
+	size_t trapsTaken = 0;
+
+	for (int64 tick = 0; tick < (warmupTicks + measuredTicks); ++tick) {
+		const double seconds = (tick * tickTime);
+		clock.advance(tickTime);
+		network.replayServerTimeMillisec = static_cast<int32>(seconds * 1000);
+
+		const uint64 eventsBefore = sentEvents;
+		const uint64 allocationsBefore = AllocationCounter::GetCount();
+
+		network.updateRoom(script.at(seconds), tickTime);
+		if (maxTraps < network.roomData.traps().size()) {
+			network.trapPlayer(network.roomData.traps().handleAt(0), trappedID);
+			++trapsTaken;
+		}
+		network.flushEvents();
+
+		if (warmupTicks <= tick) {
+			const uint64 tickAllocations = (AllocationCounter::GetCount() - allocationsBefore);
+			allocations += tickAllocations;
+			allocatingTicks += (tickAllocations != 0);
+			measuredEvents += (sentEvents - eventsBefore);
+		}
+	}
+
+	SetGameClock(nullptr);
+
+	const bool passed = (AllocationCounter::Enabled and (allocations == 0));
+
+	JSON summary;
+	summary[U"warmup_ticks"] = warmupTicks;
+	summary[U"measured_ticks"] = measuredTicks;
+	summary[U"send_budget_bytes"] = MyNetwork::sendBudgetPerTick;
+	summary[U"sent_events"] = sentEvents;
+	summary[U"sent_bytes"] = sentBytes;
+	summary[U"measured_events"] = measuredEvents;
+	summary[U"queued_events"] = network.getQueuedEventCount();
+	summary[U"traps_taken"] = trapsTaken;
+	summary[U"allocations"] = allocations;
+	summary[U"allocating_ticks"] = allocatingTicks;
+	summary[U"zero_allocation_check"] = (not AllocationCounter::Enabled) ? U"unavailable" : (passed ? U"passed" : U"failed");
+
+	BenchmarkRun::Finish(summary, options.benchmarkJSONPath);
+
+	if (not AllocationCounter::Enabled) {
+		Console << U"[alloc-check] allocations are only counted in the Benchmark configuration";
+	}
+
+	return passed;
+}
+
+// runs the real lobby and room logic with scripted input and no drawing or assets
+void RunHeadless(const std::string& secretAppID, const LaunchOptions& options) {
+	Console.open();
+
+	InputScript script = InputScript::RandomWalk(RandomUint64());
+	if (options.inputScriptPath) {
+		const Optional<InputScript> loaded = InputScript::Load(*options.inputScriptPath);
+		if (not loaded) {
+			Console << U"[headless] failed to load " << *options.inputScriptPath;
+			return;
+		}
+		script = *loaded;
+	}
+
+	if (options.levelPath and not Level::Load(*options.levelPath)) {
+		Console << U"[headless] failed to load the level " << *options.levelPath;
+		return;
+	}
+
+	MyNetwork network{ secretAppID, AppVersion, Verbose::No };
+	network.recordDirectory = options.recordDirectory;
+	if (options.levelPath) {
+		network.levelPath = *options.levelPath;
+	}
+	network.hostAuthoritative = options.authoritative;
+	network.initSendScheduler();
+	network.initEventHandlers();
+
+	const String userName = U"bot-" + ToHex(RandomUint16());
+	// the lobby list arrives shortly after connecting; deciding at once would always create a new room
+	constexpr Duration lobbyWait = 2s;
+
+	// the loop is paced to the tick rate so that the network sees a real-time client
+	FrameScheduler scheduler{ FrameScheduler::Config{
+		.simulationHz = options.tickRate,
+		.networkHz = options.networkRate,
+		.frameLimitHz = options.tickRate,
+	} };
+
+	BenchmarkStats stats;
+	Stopwatch runTime{ StartImmediately::Yes };
+	Stopwatch lobbyTime;
+	double roomSeconds = 0;
+	uint64 ticks = 0;
+	bool wasInRoom = false;
+	String exitReason = U"window closed";
+
+	while (System::Update()) {
+		const FrameScheduler::Steps steps = scheduler.advance(Scene::DeltaTime());
+
+		if (not network.isActive()) {
+			if (wasInRoom) {
+				exitReason = U"disconnected";
+				break;
+			}
+			network.initWhenEnterLobby();
+			network.userNameBox.text = userName;
+			network.connect(userName, U"jp");
+			network.state = NetWorkState::Connecting;
+		}
+		else {
+			for (int32 i = 0; i < steps.network; ++i) {
+				network.update();
+			}
+		}
+
+		if (network.state == NetWorkState::InLobby) {
+			if (wasInRoom) {
+				exitReason = U"left the room";
+				break;
+			}
+			if (not lobbyTime.isStarted()) {
+				lobbyTime.start();
+			}
+			if (lobbyTime > lobbyWait) {
+				network.enterRoomHeadless(options.roomName);
+			}
+		}
+		else if (network.state == NetWorkState::InRoom) {
+			wasInRoom = true;
+			for (int32 i = 0; i < steps.simulation; ++i) {
+				const uint64 begin = Time::GetNanosec();
+				network.updateRoom(script.at(roomSeconds), scheduler.simulationDelta());
+				stats.addSample((Time::GetNanosec() - begin) / 1'000'000.0, 0);
+				roomSeconds += scheduler.simulationDelta();
+				++ticks;
+			}
+		}
+
+		if (options.headlessTicks and (options.headlessTicks <= ticks)) {
+			exitReason = U"ticks";
+			break;
+		}
+		if ((0 < options.headlessSeconds) and (options.headlessSeconds <= runTime.sF())) {
+			exitReason = U"seconds";
+			break;
+		}
+
+		scheduler.waitForNextFrame();
+	}
+
+	if (network.isActive()) {
+		network.disconnect();
+	}
+
+	JSON summary = stats.toJSON();
+	summary[U"exit_reason"] = exitReason;
+	summary[U"reached_room"] = wasInRoom;
+	summary[U"ticks"] = ticks;
+	summary[U"dropped_ticks"] = scheduler.droppedTicks();
+	summary[U"seconds"] = runTime.sF();
+	summary[U"players"] = network.roomData.players().size();
+	Console << summary.format();
+
+	if (options.benchmarkJSONPath) {
+		summary.save(*options.benchmarkJSONPath);
+	}
+}
+
+// cold-start breakdown, written to the log every run so it can be compared between releases
+void ReportStartup(const StartupProfile& startup, const LaunchOptions& options) {
+	JSON report = startup.toJSON();
+	report[U"version"] = String{ AppVersion };
+	Logger << U"[startup] " << report.formatMinimum();
+	if (options.startupReportPath) {
+		report.save(*options.startupReportPath);
+	}
+}
 
 void Main()
 {
+	// times are from here; the engine has already created the window
+	StartupProfile startup;
+
+	const std::string secretAppID{ SIV3D_OBFUSCATE(PHOTON_APP_ID) };
+
+	const LaunchOptions options = LaunchOptions::Parse(System::GetCommandLineArgs());
+
+	// before any asset is registered, so it also works with no GPU
+	if (options.headless) {
+		RunHeadless(secretAppID, options);
+		return;
+	}
+
 	Scene::SetBackground(Color{ 66, 57, 36 });
 
-	FontAsset::Register(U"message", 30, Typeface::Bold);
-	FontAsset::Register(U"name", 15, Typeface::Bold);
-	TextureAsset::Register(U"goast_body", Resource(U"image/goast_body.png"));
-	TextureAsset::Register(U"goast_eye", Resource(U"image/goast_eye.png"));
-	TextureAsset::Register(U"gold_crown", Resource(U"image/gold_crown.png"));
-	TextureAsset::Register(U"pow", Resource(U"image/pow.png"));
-	TextureAsset::Register(U"boseki", Resource(U"image/boseki.png"));
 
+	if (options.replayBenchmarkPath) {
+		BenchmarkRun::ExitIfFailed(RunReplayBenchmark(secretAppID, options));
+		return;
+	}
 
+	if (options.allocationCheck) {
+		BenchmarkRun::ExitIfFailed(RunAllocationCheck(secretAppID, options));
+		return;
+	}
 
-	const std::string secretAppID{ SIV3D_OBFUSCATE(PHOTON_APP_ID) };
+	if (options.bakeLevel) {
+		Console.open();
+		const auto& [source, output] = *options.bakeLevel;
+		const Optional<Level> level = Level::Load(source);
+		if (level and level->bake().save(output)) {
+			Console << U"[bake-level] {} -> {} ({})"_fmt(source, output, level->hash().asString());
+		}
+		else {
+			Console << U"[bake-level] failed to bake " << source;
+		}
+		return;
+	}
+
+	if (options.collisionBenchmark) {
+		const Optional<Level> level = Level::Load(options.levelPath.value_or(DefaultLevelPath()));
+		if (not level) {
+			Console << U"[collision-bench] failed to load the level";
+			BenchmarkRun::ExitIfFailed(false);
+			return;
+		}
+		BenchmarkRun::ExitIfFailed(RunCollisionBenchmark(level->collider(), options.benchmarkJSONPath));
+		return;
+	}
+
+	if (options.simulationBenchmark) {
+		const Optional<Level> level = Level::Load(options.levelPath.value_or(DefaultLevelPath()));
+		if (not level) {
+			Console << U"[sim-bench] failed to load the level";
+			BenchmarkRun::ExitIfFailed(false);
+			return;
+		}
+		BenchmarkRun::ExitIfFailed(RunSimulationBenchmark(level->collider(), options.benchmarkJSONPath));
+		return;
+	}
+
+	if (options.smoothingBenchmark) {
+		BenchmarkRun::ExitIfFailed(RunSmoothingBenchmark(options.benchmarkJSONPath));
+		return;
+	}
+
+	// checked once here, so a bad --level is reported before the lobby instead of when a room is created
+	if (options.levelPath and not Level::Load(*options.levelPath)) {
+		System::MessageBoxOK(U"マップを読み込めませんでした: " + *options.levelPath, MessageBoxStyle::Error);
+		return;
+	}
+
+	// cached glyphs are memory-mapped here; missing ones and the sprite images are prepared on workers while Photon connects
+	MessageGlyphs().request(MessageGlyphSet());
+	NameGlyphs().request(CommonNameGlyphs());
+	LoadSpritesAsync();
+	startup.mark(U"assets_requested");
 
-	MyNetwork network{ secretAppID, U"1.1", Verbose::No };
+	MyNetwork network{ secretAppID, AppVersion, Verbose::No };
+	network.recordDirectory = options.recordDirectory;
+	if (options.levelPath) {
+		network.levelPath = *options.levelPath;
+	}
+	network.hostAuthoritative = options.authoritative;
+	network.initSendScheduler();
+	network.initEventHandlers();
+
+	// connect before the first frame so the handshake overlaps the asset loading
+	network.initWhenEnterLobby();
+	network.connect(U"player", U"jp");
+	network.state = NetWorkState::Connecting;
+	startup.mark(U"connect_started");
+	bool startupReported = false;
+
+	// simulation and network run at fixed rates, so a 240 Hz client plays and sends like a 60 Hz one
+	FrameScheduler scheduler{ FrameScheduler::Config{
+		.simulationHz = options.tickRate,
+		.networkHz = options.networkRate,
+		.frameLimitHz = options.frameLimit,
+	} };
 
 	while (System::Update())
 	{
 		ClearPrint();
 
+		const FrameScheduler::Steps steps = scheduler.advance(Scene::DeltaTime());
+
+		startup.mark(U"first_frame");
+		MessageGlyphs().update();
+		NameGlyphs().update();
+		if (not network.hasGraphics and IsSpritesReady()) {
+			network.initGraphics();
+			startup.mark(U"graphics_ready");
+		}
+
 		if(not network.isActive()){
 			network.initWhenEnterLobby();
 			network.connect(U"player", U"jp");
 			network.state = NetWorkState::Connecting;
 		}
 		else {
-			network.update();
+			for (int32 i = 0; i < steps.network; ++i) {
+				network.update();
+			}
 		}
 
 		switch (network.state)
@@ -783,33 +2280,54 @@ void Main()
 			break;
 		case NetWorkState::Connecting:
 			if (network.isFirstConnecting) {
-				FontAsset(U"message")(U"接続しています...").drawAt(Scene::Center(), Palette::White);
+				DrawStatus(StatusText::Connecting);
 			}
 			else {
-				FontAsset(U"message")(U"接続が切れました\n再接続しています...").drawAt(Scene::Center(), Palette::White);
+				DrawStatus(StatusText::Reconnecting);
 			}
 			break;
 		case NetWorkState::InLobby:
 			network.updateLobby();
 			break;
 		case NetWorkState::Joining:
-			FontAsset(U"message")(U"入室中...").drawAt(Scene::Center(), Palette::White);
+			DrawStatus(StatusText::Joining);
 			break;
 		case NetWorkState::InRoom:
-			network.updateRoom();
-			network.drawRoom();
+		{
+			const FrameInput input = MyNetwork::ReadInput();
+			for (int32 i = 0; i < steps.simulation; ++i) {
+				network.updateRoom(input, scheduler.simulationDelta());
+			}
+			network.drawRoom(steps.alpha);
+		}
 			break;
 		case NetWorkState::Leaving:
-			FontAsset(U"message")(U"退室中...").drawAt(Scene::Center(), Palette::White);
+			DrawStatus(StatusText::Leaving);
 			break;
 		case NetWorkState::Disconnecting:
-			FontAsset(U"message")(U"切断中...").drawAt(Scene::Center(), Palette::White);
+			DrawStatus(StatusText::Disconnecting);
 			break;
 		default:
 			break;
 		}
 
+		if (not startupReported) {
+			if (MessageGlyphs().contains(MessageGlyphSet()))startup.mark(U"message_glyphs_ready");
+			if (NameGlyphs().contains(CommonNameGlyphs()))startup.mark(U"name_glyphs_ready");
+			if (IsSpritesReady())startup.mark(U"sprites_ready");
+			if (network.state == NetWorkState::InLobby)startup.mark(U"lobby");
+			if (startup.contains(U"lobby") and network.hasGraphics) {
+				ReportStartup(startup, options);
+				startupReported = true;
+			}
+		}
+
+		scheduler.waitForNextFrame();
 	}
+
+	// glyphs rasterized this session are loaded from disk on the next launch
+	MessageGlyphs().save();
+	NameGlyphs().save();
 }
 
 //
@@ -127,6 +127,112 @@ namespace s3d
 	using PhotonEllipse		= CustomType_Photon<Ellipse, 17>;
 	using PhotonRoundRect	= CustomType_Photon<RoundRect, 18>;
 
+	/// @brief ユーザ定義型を [型の識別子 (4 バイト)][データ] として運ぶ可変長のカスタム型
+	class PhotonUserType : public ExitGames::Common::CustomType<PhotonUserType, 19>
+	{
+	public:
+
+		SIV3D_NODISCARD_CXX20
+		PhotonUserType() = default;
+
+		SIV3D_NODISCARD_CXX20
+		PhotonUserType(const uint32 typeID, const void* data, const size_t size)
+			: ExitGames::Common::CustomType<PhotonUserType, 19>{}
+			, m_typeID{ typeID }
+			, m_size{ static_cast<uint16>(Min(size, MaxCustomTypeEventSize)) }
+		{
+			std::memcpy(m_data.data(), data, m_size);
+		}
+
+		SIV3D_NODISCARD_CXX20
+		PhotonUserType(const PhotonUserType& toCopy)
+			: ExitGames::Common::CustomType<PhotonUserType, 19>{}
+			, m_typeID{ toCopy.m_typeID }
+			, m_size{ toCopy.m_size }
+			, m_data{ toCopy.m_data } {}
+
+		virtual ~PhotonUserType() = default;
+
+		PhotonUserType& operator =(const PhotonUserType& toCopy)
+		{
+			m_typeID = toCopy.m_typeID;
+			m_size = toCopy.m_size;
+			m_data = toCopy.m_data;
+			return *this;
+		}
+
+		void cleanup() {}
+
+		bool compare(const ExitGames::Common::CustomTypeBase& other) const override
+		{
+			const auto& rhs = static_cast<const PhotonUserType&>(other);
+			return ((m_typeID == rhs.m_typeID)
+				and (m_size == rhs.m_size)
+				and (std::memcmp(m_data.data(), rhs.m_data.data(), m_size) == 0));
+		}
+
+		void duplicate(ExitGames::Common::CustomTypeBase* pRetVal) const override
+		{
+			*reinterpret_cast<PhotonUserType*>(pRetVal) = *this;
+		}
+
+		void deserialize(const nByte* pData, const short length) override
+		{
+			if (length < static_cast<short>(sizeof(uint32)))
+			{
+				m_typeID = 0;
+				m_size = 0;
+				return;
+			}
+
+			std::memcpy(&m_typeID, pData, sizeof(uint32));
+			m_size = static_cast<uint16>(Min<size_t>((length - sizeof(uint32)), MaxCustomTypeEventSize));
+			std::memcpy(m_data.data(), (pData + sizeof(uint32)), m_size);
+		}
+
+		short serialize(nByte* pRetVal) const override
+		{
+			if (pRetVal)
+			{
+				std::memcpy(pRetVal, &m_typeID, sizeof(uint32));
+				std::memcpy((pRetVal + sizeof(uint32)), m_data.data(), m_size);
+			}
+
+			return static_cast<short>(sizeof(uint32) + m_size);
+		}
+
+		ExitGames::Common::JString& toString(ExitGames::Common::JString& retStr, [[maybe_unused]] const bool withTypes = false) const override
+		{
+			return (retStr = detail::ToJString(U"UserType({:08X}, {} bytes)"_fmt(m_typeID, m_size)));
+		}
+
+		[[nodiscard]]
+		uint32 typeID() const noexcept
+		{
+			return m_typeID;
+		}
+
+		[[nodiscard]]
+		const void* data() const noexcept
+		{
+			return m_data.data();
+		}
+
+		[[nodiscard]]
+		size_t size() const noexcept
+		{
+			return m_size;
+		}
+
+	private:
+
+		uint32 m_typeID = 0;
+
+		uint16 m_size = 0;
+
+		std::array<uint8, MaxCustomTypeEventSize> m_data{};
+	};
+
 	static void RegisterTypes()
 	{
 		PhotonColor::registerType();
@@ -148,6 +254,7 @@ namespace s3d
 		PhotonQuad::registerType();
 		PhotonEllipse::registerType();
 		PhotonRoundRect::registerType();
+		PhotonUserType::registerType();
 	}
 
 	static void UnregisterTypes()
@@ -171,6 +278,7 @@ namespace s3d
 		PhotonQuad::unregisterType();
 		PhotonEllipse::unregisterType();
 		PhotonRoundRect::unregisterType();
+		PhotonUserType::unregisterType();
 	}
 }
 
@@ -202,6 +310,7 @@ namespace s3d
 			m_receiveEventFunctions.emplace(uint8{ 16 }, [this](const int playerID, const nByte eventCode, const ExitGames::Common::Object& data) { receivedCustomType<Quad, 16>(playerID, eventCode, data); });
 			m_receiveEventFunctions.emplace(uint8{ 17 }, [this](const int playerID, const nByte eventCode, const ExitGames::Common::Object& data) { receivedCustomType<Ellipse, 17>(playerID, eventCode, data); });
 			m_receiveEventFunctions.emplace(uint8{ 18 }, [this](const int playerID, const nByte eventCode, const ExitGames::Common::Object& data) { receivedCustomType<RoundRect, 18>(playerID, eventCode, data); });
+			m_receiveEventFunctions.emplace(uint8{ 19 }, [this](const int playerID, const nByte eventCode, const ExitGames::Common::Object& data) { receivedUserType(playerID, eventCode, data); });
 		}
 
 		void onAvailableRegions(const ExitGames::Common::JVector<ExitGames::Common::JString>& availableRegions, [[maybe_unused]] const ExitGames::Common::JVector<ExitGames::Common::JString>& availableRegionServers) override
@@ -287,7 +396,11 @@ namespace s3d
 			if (type == ExitGames::Common::TypeCode::CUSTOM)
 			{
 				const uint8 customType = _data.getCustomType();
-				m_receiveEventFunctions[customType](playerID, eventCode, _data);
+
+				if (auto it = m_receiveEventFunctions.find(customType); it != m_receiveEventFunctions.end())
+				{
+					it->second(playerID, eventCode, _data);
+				}
 			}
 			else if (type == ExitGames::Common::TypeCode::HASHTABLE)
 			{
@@ -469,6 +582,20 @@ namespace s3d
 			const auto value = ExitGames::Common::ValueObject<CustomType_Photon<Type, N>>(eventContent).getDataCopy().getValue();
 			m_context.customEventAction(playerID, eventCode, value);
 		}
+
+		void receivedUserType(const int playerID, const nByte eventCode, const ExitGames::Common::Object& eventContent)
+		{
+			const PhotonUserType value = ExitGames::Common::ValueObject<PhotonUserType>(eventContent).getDataCopy();
+
+			if (value.typeID() == BlobTypeID)
+			{
+				Deserializer<MemoryViewReader> reader{ value.data(), value.size() };
+				m_context.customEventAction(playerID, eventCode, reader);
+				return;
+			}
+
+			m_context.receivedCustomTypeEvent(playerID, eventCode, value.typeID(), value.data(), value.size());
+		}
 	};
 }
 
@@ -535,6 +662,8 @@ namespace s3d
 			return;
 		}
 
+		m_sendQueue.clear();
+
 		m_client->disconnect();
 
 		m_client->service();
@@ -547,6 +676,8 @@ namespace s3d
 			return;
 		}
 
+		flushEvents();
+
 		m_client->service();
 	}
 
@@ -570,6 +701,16 @@ namespace s3d
 		return static_cast<uint32>(m_client->getServerTimeOffset());
 	}
 
+	void Multiplayer_Photon::refreshServerTime()
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		m_client->fetchServerTimestamp();
+	}
+
 	int32 Multiplayer_Photon::getPingMillisec() const
 	{
 		if (not m_client)
@@ -667,6 +808,8 @@ namespace s3d
 			return;
 		}
 
+		m_sendQueue.clear();
+
 		constexpr bool willComeBack = false;
 		m_client->opLeaveRoom(willComeBack);
 	}
@@ -708,6 +851,30 @@ namespace s3d
 
 			return options;
 		}
+
+		[[nodiscard]]
+		static ExitGames::LoadBalancing::RaiseEventOptions MakeRaiseEventOptions(const EventTargets& targets)
+		{
+			ExitGames::LoadBalancing::RaiseEventOptions options{};
+			options.setTargetPlayers(targets.data(), static_cast<short>(targets.size()));
+			return options;
+		}
+
+		[[nodiscard]]
+		static ExitGames::LoadBalancing::RaiseEventOptions MakeRaiseEventOptions(const EventTargets* targets)
+		{
+			return (targets ? MakeRaiseEventOptions(*targets) : ExitGames::LoadBalancing::RaiseEventOptions{});
+		}
+
+		[[nodiscard]]
+		static bool HasSameTargets(const EventTargets& a, const EventTargets& b) noexcept
+		{
+			return ((a.size() == b.size())
+				and std::equal(a.data(), (a.data() + a.size()), b.data()));
+		}
+
+		/// @brief 送信予算の計算に使う、イベント 1 つあたりのヘッダの推定サイズ（バイト）
+		inline constexpr size_t EventHeaderBytes = 16;
 	}
 
 	void Multiplayer_Photon::sendEvent(const uint8 eventCode, const bool value, const Optional<Array<LocalPlayerID>>& targets)
@@ -1102,7 +1269,7 @@ namespace s3d
 
 	void Multiplayer_Photon::sendEvent(const uint8 eventCode, const Serializer<MemoryWriter>& writer, const Optional<Array<LocalPlayerID>>& targets)
 	{
-		if (not m_client)
+		if (not canSend())
 		{
 			return;
 		}
@@ -1111,12 +1278,310 @@ namespace s3d
 		const uint8* src = static_cast<const uint8*>(static_cast<const void*>(blob.data()));
 		const size_t size = blob.size();
 
+		if ((size <= MaxCustomTypeEventSize)
+			and ((not targets) or InRange<size_t>(targets->size(), 1, EventTargets::Capacity)))
+		{
+			if (targets)
+			{
+				EventTargets eventTargets;
+
+				for (const auto playerID : *targets)
+				{
+					eventTargets.push_back(playerID);
+				}
+
+				sendUserTypeEvent(eventCode, BlobTypeID, src, size, &eventTargets);
+			}
+			else
+			{
+				sendUserTypeEvent(eventCode, BlobTypeID, src, size, nullptr);
+			}
+
+			return;
+		}
+
+		// 送信待ちのイベントを追い越さないように、先にすべて送信する
+		flushEvents(Largest<size_t>);
+
+		if (not m_client)
+		{
+			m_offlineSendHandler(eventCode, size);
+			return;
+		}
+
+		if (size <= MaxCustomTypeEventSize)
+		{
+			m_client->opRaiseEvent(Reliable, PhotonUserType{ BlobTypeID, src, size }, eventCode, detail::MakeRaiseEventOptions(targets));
+			return;
+		}
+
 		ExitGames::Common::Hashtable ev;
 		ev.put(L"Type", L"Blob");
 		ev.put(L"values", src, static_cast<int16>(size));
 		m_client->opRaiseEvent(Reliable, ev, eventCode, detail::MakeRaiseEventOptions(targets));
 	}
 
+	void Multiplayer_Photon::sendEvent(const uint8 eventCode, const Serializer<MemoryWriter>& writer, const EventTargets& targets)
+	{
+		if ((not canSend()) or targets.isEmpty())
+		{
+			return;
+		}
+
+		const auto& blob = writer->getBlob();
+
+		if (MaxCustomTypeEventSize < blob.size())
+		{
+			sendEvent(eventCode, writer, Array<LocalPlayerID>(targets.data(), (targets.data() + targets.size())));
+			return;
+		}
+
+		sendUserTypeEvent(eventCode, BlobTypeID, blob.data(), blob.size(), &targets);
+	}
+
+	void Multiplayer_Photon::sendCustomTypeEvent(const uint8 eventCode, const uint32 typeID, const void* data, const size_t size, const Optional<Array<LocalPlayerID>>& targets)
+	{
+		if (not canSend())
+		{
+			return;
+		}
+
+		if (targets and (not InRange<size_t>(targets->size(), 1, EventTargets::Capacity)))
+		{
+			flushEvents(Largest<size_t>);
+
+			if (not m_client)
+			{
+				m_offlineSendHandler(eventCode, size);
+				return;
+			}
+
+			m_client->opRaiseEvent(Reliable, PhotonUserType{ typeID, data, size }, eventCode, detail::MakeRaiseEventOptions(targets));
+			return;
+		}
+
+		if (targets)
+		{
+			EventTargets eventTargets;
+
+			for (const auto playerID : *targets)
+			{
+				eventTargets.push_back(playerID);
+			}
+
+			sendUserTypeEvent(eventCode, typeID, data, size, &eventTargets);
+		}
+		else
+		{
+			sendUserTypeEvent(eventCode, typeID, data, size, nullptr);
+		}
+	}
+
+	void Multiplayer_Photon::sendCustomTypeEvent(const uint8 eventCode, const uint32 typeID, const void* data, const size_t size, const EventTargets& targets)
+	{
+		if ((not canSend()) or targets.isEmpty())
+		{
+			return;
+		}
+
+		sendUserTypeEvent(eventCode, typeID, data, size, &targets);
+	}
+
+	void Multiplayer_Photon::sendUserTypeEvent(const uint8 eventCode, const uint32 typeID, const void* data, const size_t size, const EventTargets* targets)
+	{
+		assert(size <= MaxCustomTypeEventSize);
+
+		if (m_sendBudget == 0)
+		{
+			if (not m_client)
+			{
+				m_offlineSendHandler(eventCode, size);
+				return;
+			}
+
+			m_client->opRaiseEvent(Reliable, PhotonUserType{ typeID, data, size }, eventCode, detail::MakeRaiseEventOptions(targets));
+			return;
+		}
+
+		const EventSendPolicy& policy = m_eventPolicies[eventCode];
+
+		QueuedEvent* queued = nullptr;
+
+		if (policy.latestOnly)
+		{
+			for (auto& event : m_sendQueue)
+			{
+				if ((event.eventCode == eventCode)
+					and (event.broadcast == (targets == nullptr))
+					and ((not targets) or detail::HasSameTargets(event.targets, *targets)))
+				{
+					queued = &event;
+					break;
+				}
+			}
+		}
+
+		if (not queued)
+		{
+			if (MaxQueuedEvents <= m_sendQueue.size())
+			{
+				if (m_verbose)
+				{
+					Print << U"[Multiplayer_Photon] send queue is full. eventCode: " << eventCode;
+				}
+
+				flushEvents(Largest<size_t>);
+			}
+
+			QueuedEvent& event = m_sendQueue.emplace_back();
+			event.sequence		= m_sendSequence++;
+			event.enqueuedTick	= m_sendTick;
+			event.eventCode		= eventCode;
+			event.priority		= policy.priority;
+			event.broadcast		= (targets == nullptr);
+			event.targets		= (targets ? *targets : EventTargets{});
+			queued = &event;
+		}
+
+		// latestOnly で上書きする場合も、キュー内での順番と待ち時間は引き継ぐ
+		queued->typeID	= typeID;
+		queued->size	= static_cast<uint16>(size);
+		std::memcpy(queued->data.data(), data, size);
+	}
+
+	void Multiplayer_Photon::setEventPolicy(const uint8 eventCode, const EventPriority priority, const bool latestOnly)
+	{
+		m_eventPolicies[eventCode] = EventSendPolicy{ priority, latestOnly };
+	}
+
+	void Multiplayer_Photon::setSendBudget(const size_t bytesPerTick)
+	{
+		if (bytesPerTick == 0)
+		{
+			flushEvents(Largest<size_t>);
+		}
+		else
+		{
+			m_sendQueue.reserve(MaxQueuedEvents);
+			m_sendOrder.reserve(MaxQueuedEvents);
+		}
+
+		m_sendBudget = bytesPerTick;
+	}
+
+	void Multiplayer_Photon::setSendAgingTicks(const uint32 ticks)
+	{
+		m_sendAgingTicks = Max<uint32>(ticks, 1);
+	}
+
+	void Multiplayer_Photon::flushEvents()
+	{
+		++m_sendTick;
+
+		flushEvents((m_sendBudget == 0) ? Largest<size_t> : m_sendBudget);
+	}
+
+	void Multiplayer_Photon::flushEvents(const size_t budget)
+	{
+		if (m_sendQueue.isEmpty())
+		{
+			return;
+		}
+
+		if (not canSend())
+		{
+			m_sendQueue.clear();
+			return;
+		}
+
+		// 待ち時間 m_sendAgingTicks ごとに優先度を 1 段階上げる
+		const auto effectivePriority = [this](const QueuedEvent& event)
+		{
+			const uint64 promotion = ((m_sendTick - event.enqueuedTick) / m_sendAgingTicks);
+			return (static_cast<int64>(FromEnum(event.priority)) - static_cast<int64>(promotion));
+		};
+
+		m_sendOrder.clear();
+
+		for (size_t i = 0; i < m_sendQueue.size(); ++i)
+		{
+			m_sendOrder.push_back(static_cast<uint16>(i));
+		}
+
+		std::sort(m_sendOrder.begin(), m_sendOrder.end(), [&](const uint16 a, const uint16 b)
+			{
+				const QueuedEvent& ea = m_sendQueue[a];
+				const QueuedEvent& eb = m_sendQueue[b];
+				const int64 pa = effectivePriority(ea);
+				const int64 pb = effectivePriority(eb);
+				return ((pa != pb) ? (pa < pb) : (ea.sequence < eb.sequence));
+			});
+
+		size_t sentBytes = 0;
+
+		for (const auto index : m_sendOrder)
+		{
+			QueuedEvent& event = m_sendQueue[index];
+			const size_t cost = (detail::EventHeaderBytes + event.size);
+
+			// 予算を超えても、1 回の呼び出しで最低 1 つは送信する
+			if ((sentBytes != 0) and (budget < (sentBytes + cost)))
+			{
+				break;
+			}
+
+			if (m_client)
+			{
+				m_client->opRaiseEvent(Reliable, PhotonUserType{ event.typeID, event.data.data(), event.size }, event.eventCode,
+					(event.broadcast ? ExitGames::LoadBalancing::RaiseEventOptions{} : detail::MakeRaiseEventOptions(event.targets)));
+			}
+			else
+			{
+				m_offlineSendHandler(event.eventCode, event.size);
+			}
+
+			event.sent = true;
+			sentBytes += cost;
+		}
+
+		m_sendQueue.remove_if([](const QueuedEvent& event) { return event.sent; });
+	}
+
+	size_t Multiplayer_Photon::getQueuedEventCount() const noexcept
+	{
+		return m_sendQueue.size();
+	}
+
+	void Multiplayer_Photon::setOfflineSendHandler(std::function<void(uint8, size_t)> handler)
+	{
+		m_offlineSendHandler = std::move(handler);
+	}
+
+	bool Multiplayer_Photon::canSend() const noexcept
+	{
+		return (m_client or m_offlineSendHandler);
+	}
+
+	void Multiplayer_Photon::receivedCustomTypeEvent(const LocalPlayerID playerID, const uint8 eventCode, const uint32 typeID, const void* data, const size_t size)
+	{
+		const auto it = m_customTypeHandlers.find(typeID);
+
+		if ((it == m_customTypeHandlers.end()) or (it->second.size != size))
+		{
+			if (m_verbose)
+			{
+				Print << U"[Multiplayer_Photon] unhandled custom type event";
+				Print << U"- [Multiplayer_Photon] playerID: " << playerID;
+				Print << U"- [Multiplayer_Photon] eventCode: " << eventCode;
+				Print << U"- [Multiplayer_Photon] typeID: " << U"{:08X}"_fmt(typeID);
+			}
+
+			return;
+		}
+
+		it->second.callback(playerID, eventCode, data);
+	}
+
 	String Multiplayer_Photon::getUserName() const
 	{
 		if (not m_client)
@@ -1353,6 +1818,21 @@ namespace s3d
 		return m_client->getCountPlayersOnline();
 	}
 
+	LocalPlayerID Multiplayer_Photon::getHostLocalPlayerID() const
+	{
+		if (not m_client)
+		{
+			return 0;
+		}
+
+		if (not m_client->getIsInGameRoom())
+		{
+			return 0;
+		}
+
+		return m_client->getCurrentlyJoinedRoom().getMasterClientID();
+	}
+
 	bool Multiplayer_Photon::isHost() const
 	{
 		if (not m_client)
@@ -18,6 +18,7 @@
 
 # pragma once
 # include <Siv3D.hpp>
+# include <typeindex>
 
 # if SIV3D_PLATFORM(WINDOWS)
 #	if SIV3D_BUILD(DEBUG)
@@ -68,6 +69,123 @@ namespace s3d
 		bool isActive = false;
 	};
 
+	/// @brief ユーザ定義のカスタム型イベントで送信できるデータの最大サイズ（バイト）
+	inline constexpr size_t MaxCustomTypeEventSize = 256;
+
+	/// @brief ヒープ確保をしない、送信先プレイヤーの固定長リスト
+	class EventTargets
+	{
+	public:
+
+		/// @brief 保持できる送信先の最大数
+		static constexpr size_t Capacity = 8;
+
+		SIV3D_NODISCARD_CXX20
+		EventTargets() = default;
+
+		SIV3D_NODISCARD_CXX20
+		explicit EventTargets(const LocalPlayerID playerID) noexcept
+		{
+			push_back(playerID);
+		}
+
+		SIV3D_NODISCARD_CXX20
+		EventTargets(const std::initializer_list<LocalPlayerID> playerIDs) noexcept
+		{
+			for (const auto playerID : playerIDs)
+			{
+				push_back(playerID);
+			}
+		}
+
+		/// @brief 送信先を追加します。
+		/// @param playerID 送信先のプレイヤーのローカル ID
+		/// @remark Capacity を超える送信先は無視されます。
+		void push_back(const LocalPlayerID playerID) noexcept
+		{
+			assert(m_size < Capacity);
+
+			if (m_size < Capacity)
+			{
+				m_ids[m_size++] = playerID;
+			}
+		}
+
+		void clear() noexcept
+		{
+			m_size = 0;
+		}
+
+		[[nodiscard]]
+		const LocalPlayerID* data() const noexcept
+		{
+			return m_ids.data();
+		}
+
+		[[nodiscard]]
+		size_t size() const noexcept
+		{
+			return m_size;
+		}
+
+		[[nodiscard]]
+		bool isEmpty() const noexcept
+		{
+			return (m_size == 0);
+		}
+
+	private:
+
+		std::array<LocalPlayerID, Capacity> m_ids{};
+
+		size_t m_size = 0;
+	};
+
+	/// @brief イベント送信の優先度
+	enum class EventPriority : uint8
+	{
+		/// @brief ゲームの進行に欠かせないイベント。最優先で送信されます
+		Critical,
+
+		/// @brief 通常のイベント
+		Normal,
+
+		/// @brief 見た目にだけ関わるイベント。帯域が足りないときは後回しにされます
+		Cosmetic,
+	};
+
+	/// @brief イベントコードごとの送信ポリシー
+	struct EventSendPolicy
+	{
+		/// @brief 送信の優先度
+		EventPriority priority = EventPriority::Normal;
+
+		/// @brief 送信待ちの同じイベントを新しい値で上書きする場合 true
+		bool latestOnly = false;
+	};
+
+	namespace detail
+	{
+		template <class Type>
+		inline constexpr bool IsBuiltinPhotonCustomType = (std::is_same_v<Type, Color> or std::is_same_v<Type, ColorF> or std::is_same_v<Type, HSV>
+			or std::is_same_v<Type, Point> or std::is_same_v<Type, Vec2> or std::is_same_v<Type, Vec3> or std::is_same_v<Type, Vec4>
+			or std::is_same_v<Type, Float2> or std::is_same_v<Type, Float3> or std::is_same_v<Type, Float4> or std::is_same_v<Type, Mat3x2>
+			or std::is_same_v<Type, Rect> or std::is_same_v<Type, Circle> or std::is_same_v<Type, Line> or std::is_same_v<Type, Triangle>
+			or std::is_same_v<Type, RectF> or std::is_same_v<Type, Quad> or std::is_same_v<Type, Ellipse> or std::is_same_v<Type, RoundRect>);
+	}
+
+	/// @brief sendEvent() / onEvent() でそのままメモリコピーして送受信できるユーザ定義型
+	/// @remark 型ごとに 0 以外の識別子 `static constexpr uint32 PhotonTypeID` を定義する必要があります。識別子は通信で使われるため、コンパイラやビルドが異なっても同じ値になります。
+	/// @remark Color や Vec2 などの組み込みのカスタム型は専用のオーバーロードで送受信されるため含みません。
+	template <class Type>
+	concept PhotonCustomType = std::is_class_v<Type>
+		and std::is_trivially_copyable_v<Type>
+		and std::is_default_constructible_v<Type>
+		and (sizeof(Type) <= MaxCustomTypeEventSize)
+		and (not detail::IsBuiltinPhotonCustomType<Type>)
+		and requires { { Type::PhotonTypeID } -> std::convertible_to<uint32>; }
+		and (Type::PhotonTypeID != 0);
+
 	/// @brief マルチプレイヤー用クラス (Photon バックエンド)
 	class Multiplayer_Photon
 	{
@@ -119,6 +237,10 @@ namespace s3d
 		[[nodiscard]]
 		int32 getServerTimeOffsetMillisec() const;
 
+		/// @brief サーバのタイムスタンプを取得し直し、オフセットを更新します。
+		/// @remark ローカルの時計はサーバの時計と少しずつずれるため、長時間接続する場合は定期的に呼んでください。
+		void refreshServerTime();
+
 		/// @brief サーバーとのラウンドトリップタイムを取得します。
 		/// @return サーバーとのラウンドトリップタイム
 		[[nodiscard]]
@@ -386,6 +508,77 @@ namespace s3d
 		/// @remark ユーザ定義型を送信する際に利用します。
 		void sendEvent(uint8 eventCode, const Serializer<MemoryWriter>& writer, const Optional<Array<LocalPlayerID>>& targets = unspecified);
 
+		/// @brief ルームにユーザ定義型のイベントを送信します。
+		/// @tparam Type 送信するデータの型
+		/// @param eventCode イベントコード
+		/// @param value 送信するデータ
+		/// @param targets 送信先のプレイヤーのローカル ID, unspecified の場合は自分以外の全員
+		/// @remark Hashtable に包まず、1 つのカスタム型としてメモリコピーで送信します。受信側は onEvent() で同じ型を登録している必要があります。
+		template <PhotonCustomType Type>
+		void sendEvent(uint8 eventCode, const Type& value, const Optional<Array<LocalPlayerID>>& targets = unspecified);
+
+		/// @brief ルームにイベントを送信します。
+		/// @param eventCode イベントコード
+		/// @param writer 送信するデータ
+		/// @param targets 送信先のプレイヤーのローカル ID。空の場合は送信しません
+		/// @remark ヒープ確保をしない送信先リストを使う版です。
+		void sendEvent(uint8 eventCode, const Serializer<MemoryWriter>& writer, const EventTargets& targets);
+
+		/// @brief ルームにユーザ定義型のイベントを送信します。
+		/// @tparam Type 送信するデータの型
+		/// @param eventCode イベントコード
+		/// @param value 送信するデータ
+		/// @param targets 送信先のプレイヤーのローカル ID。空の場合は送信しません
+		template <PhotonCustomType Type>
+		void sendEvent(uint8 eventCode, const Type& value, const EventTargets& targets);
+
+		/// @brief 使い回しの書き込みバッファに値をシリアライズして返します。
+		/// @param args シリアライズする値
+		/// @return 書き込みバッファ。次に serializeEvent() を呼ぶまで有効です
+		/// @remark バッファは再利用されるため、定常状態ではヒープ確保が発生しません。
+		template <class... Args>
+		[[nodiscard]]
+		const Serializer<MemoryWriter>& serializeEvent(const Args&... args);
+
+		/// @brief イベントコードごとの送信ポリシーを設定します。
+		/// @param eventCode イベントコード
+		/// @param priority 送信の優先度
+		/// @param latestOnly 送信待ちの同じイベント（イベントコードと送信先が同じもの）を新しい値で上書きする場合 true
+		/// @remark setSendBudget() で送信予算を設定した場合にのみ使われます。
+		void setEventPolicy(uint8 eventCode, EventPriority priority, bool latestOnly = false);
+
+		/// @brief 1 回の update() で送信するイベントのバイト数の上限を設定します。
+		/// @param bytesPerTick 上限（バイト）。0 の場合は送信待ちにせず、sendEvent() の呼び出し時に送信します
+		/// @remark 上限を超えたイベントは次回以降の update() で優先度の高い順に送信されます。
+		void setSendBudget(size_t bytesPerTick);
+
+		/// @brief 送信待ちのイベントの優先度が 1 段階上がるまでの update() の回数を設定します。
+		/// @param ticks update() の回数
+		/// @remark 優先度の低いイベントがいつまでも送信されない状態を防ぎます。
+		void setSendAgingTicks(uint32 ticks);
+
+		/// @brief 送信待ちのイベントを、送信予算の範囲で優先度の高い順に送信します。
+		/// @remark update() から呼ばれます。
+		void flushEvents();
+
+		/// @brief 送信待ちのイベントの数を返します。
+		/// @return 送信待ちのイベントの数
+		[[nodiscard]]
+		size_t getQueuedEventCount() const noexcept;
+
+		/// @brief 接続していないときに、Photon に渡す代わりに呼ばれる関数を設定します。
+		/// @param handler 送信されるイベントごとに呼ばれる関数 (イベントコード, データのバイト数)。空の場合は接続するまで送信しません
+		/// @remark 接続せずに送信の経路（送信予算や送信待ちのキュー）を計測するためのものです。
+		void setOfflineSendHandler(std::function<void(uint8, size_t)> handler);
+
+		/// @brief ユーザ定義型のイベントを受信したときに呼ばれる関数を登録します。
+		/// @tparam Type 受信するデータの型
+		/// @param handler 受信時に呼ばれる関数 (送信者のローカル ID, イベントコード, 受信したデータ)
+		/// @remark 型は Type::PhotonTypeID で識別されるため、登録の順序はプレイヤー間で揃える必要はありません。
+		/// @throw Error 同じ PhotonTypeID を持つ別の型がすでに登録されている場合
+		template <PhotonCustomType Type>
+		void onEvent(std::function<void(LocalPlayerID, uint8, const Type&)> handler);
+
 		/// @brief 自身のユーザ名を返します。
 		/// @return 自身のユーザ名
 		[[nodiscard]]
@@ -474,6 +667,12 @@ namespace s3d
 		[[nodiscard]]
 		int32 getCountPlayersOnline() const;
 
+		/// @brief 現在のルームのホストのローカル ID を返します。
+		/// @return ホストのローカル ID, ルームに参加していない場合は 0
+		/// @remark getLocalPlayers() と異なり、ヒープ確保をしません。
+		[[nodiscard]]
+		LocalPlayerID getHostLocalPlayerID() const;
+
 		/// @brief 自分が現在のルームのホストであるかを返します。
 		/// @return 自分が現在のルームのホストである場合 true, それ以外の場合は false
 		[[nodiscard]]
@@ -774,6 +973,77 @@ namespace s3d
 
 		class PhotonDetail;
 
+		/// @brief Serializer<MemoryWriter> のデータをカスタム型で送るときの型の識別子
+		static constexpr uint32 BlobTypeID = 0;
+
+		struct CustomTypeHandler
+		{
+			std::type_index type;
+
+			size_t size = 0;
+
+			std::function<void(LocalPlayerID, uint8, const void*)> callback;
+		};
+
+		HashTable<uint32, CustomTypeHandler> m_customTypeHandlers;
+
+		Serializer<MemoryWriter> m_eventWriter;
+
+		/// @brief 送信待ちにできるイベントの最大数
+		static constexpr size_t MaxQueuedEvents = 256;
+
+		struct QueuedEvent
+		{
+			uint64 sequence = 0;
+
+			uint64 enqueuedTick = 0;
+
+			uint32 typeID = 0;
+
+			uint16 size = 0;
+
+			uint8 eventCode = 0;
+
+			EventPriority priority = EventPriority::Normal;
+
+			bool broadcast = true;
+
+			bool sent = false;
+
+			EventTargets targets;
+
+			std::array<uint8, MaxCustomTypeEventSize> data;
+		};
+
+		std::array<EventSendPolicy, 256> m_eventPolicies{};
+
+		Array<QueuedEvent> m_sendQueue;
+
+		Array<uint16> m_sendOrder;
+
+		size_t m_sendBudget = 0;
+
+		uint32 m_sendAgingTicks = 30;
+
+		uint64 m_sendTick = 0;
+
+		uint64 m_sendSequence = 0;
+
+		std::function<void(uint8, size_t)> m_offlineSendHandler;
+
+		[[nodiscard]]
+		bool canSend() const noexcept;
+
+		void sendUserTypeEvent(uint8 eventCode, uint32 typeID, const void* data, size_t size, const EventTargets* targets);
+
+		void flushEvents(size_t budget);
+
+		void sendCustomTypeEvent(uint8 eventCode, uint32 typeID, const void* data, size_t size, const Optional<Array<LocalPlayerID>>& targets);
+
+		void sendCustomTypeEvent(uint8 eventCode, uint32 typeID, const void* data, size_t size, const EventTargets& targets);
+
+		void receivedCustomTypeEvent(LocalPlayerID playerID, uint8 eventCode, uint32 typeID, const void* data, size_t size);
+
 		std::unique_ptr<ExitGames::LoadBalancing::Listener> m_listener;
 
 		std::unique_ptr<ExitGames::LoadBalancing::Client> m_client;
@@ -786,4 +1056,49 @@ namespace s3d
 
 		bool m_isActive = false;
 	};
+
+	template <PhotonCustomType Type>
+	void Multiplayer_Photon::sendEvent(const uint8 eventCode, const Type& value, const Optional<Array<LocalPlayerID>>& targets)
+	{
+		sendCustomTypeEvent(eventCode, Type::PhotonTypeID, std::addressof(value), sizeof(Type), targets);
+	}
+
+	template <PhotonCustomType Type>
+	void Multiplayer_Photon::sendEvent(const uint8 eventCode, const Type& value, const EventTargets& targets)
+	{
+		sendCustomTypeEvent(eventCode, Type::PhotonTypeID, std::addressof(value), sizeof(Type), targets);
+	}
+
+	template <class... Args>
+	const Serializer<MemoryWriter>& Multiplayer_Photon::serializeEvent(const Args&... args)
+	{
+		m_eventWriter->clear();
+
+		if constexpr (sizeof...(Args) != 0)
+		{
+			m_eventWriter(args...);
+		}
+
+		return m_eventWriter;
+	}
+
+	template <PhotonCustomType Type>
+	void Multiplayer_Photon::onEvent(std::function<void(LocalPlayerID, uint8, const Type&)> handler)
+	{
+		const uint32 typeID = Type::PhotonTypeID;
+
+		if (const auto it = m_customTypeHandlers.find(typeID);
+			(it != m_customTypeHandlers.end()) and (it->second.type != std::type_index{ typeid(Type) }))
+		{
+			throw Error{ U"Multiplayer_Photon::onEvent(): PhotonTypeID {:08X} is already registered by another type"_fmt(typeID) };
+		}
+
+		m_customTypeHandlers.insert_or_assign(typeID, CustomTypeHandler{ std::type_index{ typeid(Type) }, sizeof(Type),
+			[handler = std::move(handler)](const LocalPlayerID playerID, const uint8 eventCode, const void* data)
+			{
+				Type value;
+				std::memcpy(std::addressof(value), data, sizeof(Type));
+				handler(playerID, eventCode, value);
+			} });
+	}
 }
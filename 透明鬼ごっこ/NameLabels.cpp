@@ -0,0 +1,127 @@
+﻿# include "NameLabels.hpp"
+
+NameLabels::NameLabels(GlyphCache& glyphs, const double fontSize)
+	: m_glyphs{ &glyphs }
+	, m_scale{ (fontSize / glyphs.fontSize()) }
+	, m_revision{ glyphs.revision() } {}
+
+void NameLabels::set(const PlayerID id, const String& name)
+{
+	// キャッシュがない（ヘッドレス実行）ときは何も描かない
+	if (not m_glyphs)
+	{
+		return;
+	}
+
+	if (layout(id, name))
+	{
+		m_unresolved.erase(id);
+	}
+	else
+	{
+		// 前の名前のラベルは残さず、グリフが届くまで描かない
+		m_labels.erase(id);
+		m_unresolved[id] = name;
+	}
+}
+
+void NameLabels::erase(const PlayerID id)
+{
+	m_labels.erase(id);
+	m_unresolved.erase(id);
+}
+
+void NameLabels::clear()
+{
+	m_labels.clear();
+	m_unresolved.clear();
+	m_pending.clear();
+}
+
+bool NameLabels::contains(const PlayerID id) const
+{
+	return m_labels.contains(id);
+}
+
+void NameLabels::update()
+{
+	if ((not m_glyphs) or (m_revision == m_glyphs->revision()))
+	{
+		return;
+	}
+
+	m_revision = m_glyphs->revision();
+
+	Array<PlayerID> resolved;
+
+	for (const auto& [id, name] : m_unresolved)
+	{
+		if (layout(id, name))
+		{
+			resolved << id;
+		}
+	}
+
+	for (const auto id : resolved)
+	{
+		m_unresolved.erase(id);
+	}
+}
+
+bool NameLabels::layout(const PlayerID id, const StringView name)
+{
+	Optional<Array<Glyph>> glyphs = m_glyphs->getGlyphs(name);
+
+	if (not glyphs)
+	{
+		return false;
+	}
+
+	Label label;
+	label.glyphs = std::move(*glyphs);
+	label.offsets.reserve(label.glyphs.size());
+
+	// 名前は 1 行なので、ペンを右へ送るだけでよい
+	double penX = 0.0;
+
+	for (const auto& glyph : label.glyphs)
+	{
+		const Vec2 offset = glyph.getOffset(m_scale);
+		label.offsets << Vec2{ (penX + offset.x), offset.y };
+		penX += (glyph.xAdvance * m_scale);
+	}
+
+	label.size = SizeF{ penX, (m_glyphs->height() * m_scale) };
+	m_labels[id] = std::move(label);
+	return true;
+}
+
+void NameLabels::add(const PlayerID id, const Vec2& center, const ColorF& color)
+{
+	if (m_labels.contains(id))
+	{
+		m_pending << Pending{ id, center, color };
+	}
+}
+
+const PixelShader& NameLabels::pixelShader() const
+{
+	// ビットマップ以外のフォントは専用のシェーダで描く
+	return Font::GetPixelShader(m_glyphs ? m_glyphs->method() : FontMethod::Bitmap);
+}
+
+void NameLabels::draw()
+{
+	for (const auto& pending : m_pending)
+	{
+		const Label& label = m_labels.at(pending.id);
+		const Vec2 topLeft = (pending.center - label.size / 2);
+
+		for (size_t i = 0; i < label.glyphs.size(); ++i)
+		{
+			label.glyphs[i].texture.scaled(m_scale).draw(topLeft + label.offsets[i], pending.color);
+		}
+	}
+
+	m_pending.clear();
+}
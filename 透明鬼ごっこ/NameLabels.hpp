@@ -0,0 +1,98 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "GlyphCache.hpp"
+
+/// @brief プレイヤー名のラベルを、名前が変わったときだけレイアウトしてキャッシュする
+/// @remark 各ラベルはグリフ（GlyphCache のアトラス上の範囲）とその位置の列として保持します。
+/// グリフがまだキャッシュにない名前は、ワーカーがラスタライズし終えたあとの update() でレイアウトします。
+/// 描画はフレームごとに add() で積み、draw() でまとめて描きます。
+/// グリフはすべてアトラスにあるので、pixelShader() を 1 回設定するだけで一括で描けます。
+/// キャッシュは FontMethod::MSDF で作ると、基準サイズと違う大きさでもくっきり描けます。
+class NameLabels
+{
+public:
+
+	/// @brief プレイヤーの ID（Multiplayer_Photon の LocalPlayerID）
+	using PlayerID = int32;
+
+	SIV3D_NODISCARD_CXX20
+	NameLabels() = default;
+
+	/// @param glyphs ラベルのグリフのキャッシュ。NameLabels より長く生きている必要があります
+	/// @param fontSize 描画する文字の大きさ（ピクセル）
+	SIV3D_NODISCARD_CXX20
+	NameLabels(GlyphCache& glyphs, double fontSize);
+
+	/// @brief プレイヤーの名前を設定し、ラベルをレイアウトし直します。
+	/// @param id プレイヤーの ID
+	/// @param name 名前
+	void set(PlayerID id, const String& name);
+
+	/// @brief プレイヤーのラベルを削除します。
+	/// @param id プレイヤーの ID
+	void erase(PlayerID id);
+
+	/// @brief すべてのラベルを削除します。
+	void clear();
+
+	/// @brief プレイヤーのラベルがあるかを返します。グリフを待っているラベルは含みません。
+	[[nodiscard]]
+	bool contains(PlayerID id) const;
+
+	/// @brief グリフを待っているラベルのうち、キャッシュにグリフが届いたものをレイアウトします。毎フレーム呼んでください。
+	void update();
+
+	/// @brief このフレームに描くラベルを積みます。
+	/// @param id プレイヤーの ID。ラベルがなければ何もしません
+	/// @param center ラベルの中心の位置
+	/// @param color 文字の色
+	void add(PlayerID id, const Vec2& center, const ColorF& color);
+
+	/// @brief フォントを描くためのピクセルシェーダを返します。
+	[[nodiscard]]
+	const PixelShader& pixelShader() const;
+
+	/// @brief 積んだラベルをすべて描き、積んだものを消します。
+	/// @remark pixelShader() を ScopedCustomShader2D（または RenderQueue）で設定した状態で呼んでください。
+	void draw();
+
+private:
+
+	struct Label
+	{
+		Array<Glyph> glyphs;
+
+		/// @brief ラベルの左上から見た、各グリフの左上の位置
+		Array<Vec2> offsets;
+
+		SizeF size{ 0, 0 };
+	};
+
+	struct Pending
+	{
+		PlayerID id;
+
+		Vec2 center;
+
+		ColorF color;
+	};
+
+	GlyphCache* m_glyphs = nullptr;
+
+	double m_scale = 1.0;
+
+	HashTable<PlayerID, Label> m_labels;
+
+	/// @brief グリフを待っているラベルの名前
+	HashTable<PlayerID, String> m_unresolved;
+
+	/// @brief 最後に m_unresolved をやり直したときのキャッシュの番号
+	uint64 m_revision = 0;
+
+	/// @brief 名前をレイアウトします。
+	/// @return グリフがすべてそろっていてレイアウトできた場合 true
+	bool layout(PlayerID id, StringView name);
+
+	/// @brief 描く順に積んだラベル。容量は次のフレームのために残す
+	Array<Pending> m_pending;
+};
@@ -0,0 +1,157 @@
+﻿# include "PlayerSimulation.hpp"
+# include "CircleCollider.hpp"
+
+void PlayerSimulation::clear()
+{
+	m_ids.clear();
+	m_positions.clear();
+	m_previousPositions.clear();
+	m_directions.clear();
+	m_speeds.clear();
+	m_moved.clear();
+	m_indices.clear();
+}
+
+void PlayerSimulation::setPlayer(const PlayerID id, const Vec2& pos)
+{
+	if (auto it = m_indices.find(id); it != m_indices.end())
+	{
+		m_positions[it->second] = pos;
+		m_previousPositions[it->second] = pos;
+		m_moved[it->second] = true;
+		return;
+	}
+
+	m_indices.emplace(id, m_ids.size());
+	m_ids << id;
+	m_positions << pos;
+	m_previousPositions << pos;
+	m_directions << Vec2{ 0, 0 };
+	m_speeds << 0.0;
+	m_moved << true;
+}
+
+void PlayerSimulation::erase(const PlayerID id)
+{
+	const auto it = m_indices.find(id);
+
+	if (it == m_indices.end())
+	{
+		return;
+	}
+
+	// 順序は保たなくてよいので、末尾と入れ替えて消す
+	const size_t index = it->second;
+	const size_t last = (m_ids.size() - 1);
+	m_indices.erase(it);
+
+	if (index != last)
+	{
+		m_ids[index] = m_ids[last];
+		m_positions[index] = m_positions[last];
+		m_previousPositions[index] = m_previousPositions[last];
+		m_directions[index] = m_directions[last];
+		m_speeds[index] = m_speeds[last];
+		m_moved[index] = m_moved[last];
+		m_indices[m_ids[index]] = index;
+	}
+
+	m_ids.pop_back();
+	m_positions.pop_back();
+	m_previousPositions.pop_back();
+	m_directions.pop_back();
+	m_speeds.pop_back();
+	m_moved.pop_back();
+}
+
+bool PlayerSimulation::contains(const PlayerID id) const
+{
+	return m_indices.contains(id);
+}
+
+size_t PlayerSimulation::size() const noexcept
+{
+	return m_ids.size();
+}
+
+void PlayerSimulation::setInput(const PlayerID id, const Vec2& direction)
+{
+	const double lengthSq = direction.lengthSq();
+	m_directions[indexOf(id)] = ((1.0 < lengthSq) ? (direction / Math::Sqrt(lengthSq)) : direction);
+}
+
+void PlayerSimulation::setSpeed(const PlayerID id, const double speed)
+{
+	m_speeds[indexOf(id)] = Max(speed, 0.0);
+}
+
+const Vec2& PlayerSimulation::position(const PlayerID id) const
+{
+	return m_positions[indexOf(id)];
+}
+
+const Array<PlayerSimulation::PlayerID>& PlayerSimulation::ids() const noexcept
+{
+	return m_ids;
+}
+
+const Array<Vec2>& PlayerSimulation::positions() const noexcept
+{
+	return m_positions;
+}
+
+const Array<Vec2>& PlayerSimulation::previousPositions() const noexcept
+{
+	return m_previousPositions;
+}
+
+void PlayerSimulation::step(const CircleCollider& collider, const double radius, const double deltaTime)
+{
+	const size_t count = m_ids.size();
+	m_previousPositions.assign(m_positions.begin(), m_positions.end());
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const double distance = (m_speeds[i] * deltaTime);
+
+		if ((distance == 0.0) or m_directions[i].isZero())
+		{
+			continue;
+		}
+
+		const Vec2 moved = collider.move(m_positions[i], radius, (m_directions[i] * distance));
+
+		if (moved != m_positions[i])
+		{
+			m_positions[i] = moved;
+			m_moved[i] = true;
+		}
+	}
+}
+
+void PlayerSimulation::takeMoved(Array<PlayerID>& ids, Array<Vec2>& positions)
+{
+	ids.clear();
+	positions.clear();
+
+	for (size_t i = 0; i < m_ids.size(); ++i)
+	{
+		if (m_moved[i])
+		{
+			ids << m_ids[i];
+			positions << m_positions[i];
+			m_moved[i] = false;
+		}
+	}
+}
+
+void PlayerSimulation::takeMovedFlags(Array<uint8>& moved)
+{
+	moved.assign(m_moved.begin(), m_moved.end());
+	m_moved.fill(false);
+}
+
+size_t PlayerSimulation::indexOf(const PlayerID id) const
+{
+	return m_indices.at(id);
+}
@@ -0,0 +1,100 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+class CircleCollider;
+
+/// @brief ホストが全プレイヤーの円を入力から動かす、権威的なシミュレーション
+/// @remark 位置・入力の向き・速さを SoA で持ち、1 ティック分の移動を全員まとめて行います。
+/// 止まっているプレイヤーは衝突判定をしません。
+class PlayerSimulation
+{
+public:
+
+	/// @brief プレイヤーの ID（Multiplayer_Photon の LocalPlayerID）
+	using PlayerID = int32;
+
+	/// @brief すべてのプレイヤーを削除します。
+	void clear();
+
+	/// @brief プレイヤーを追加します。すでにいる場合は位置を設定します。
+	/// @param id プレイヤーの ID
+	/// @param pos 位置（壁と重なっていないこと）
+	void setPlayer(PlayerID id, const Vec2& pos);
+
+	/// @brief プレイヤーを削除します。
+	/// @param id プレイヤーの ID
+	void erase(PlayerID id);
+
+	/// @brief プレイヤーがいるかを返します。
+	[[nodiscard]]
+	bool contains(PlayerID id) const;
+
+	/// @brief プレイヤーの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief 入力の向きを設定します。
+	/// @param id プレイヤーの ID
+	/// @param direction 向き。長さが 1 を超える場合は 1 にそろえます
+	void setInput(PlayerID id, const Vec2& direction);
+
+	/// @brief 速さ（ピクセル毎秒）を設定します。
+	/// @param id プレイヤーの ID
+	/// @param speed 速さ
+	void setSpeed(PlayerID id, double speed);
+
+	/// @brief プレイヤーの位置を返します。
+	[[nodiscard]]
+	const Vec2& position(PlayerID id) const;
+
+	/// @brief プレイヤーの ID から positions() のインデックスを返します。
+	/// @param id プレイヤーの ID（いること）
+	[[nodiscard]]
+	size_t indexOf(PlayerID id) const;
+
+	/// @brief プレイヤーの ID の一覧を返します。インデックスは positions() と対応します
+	[[nodiscard]]
+	const Array<PlayerID>& ids() const noexcept;
+
+	/// @brief プレイヤーの位置の一覧を返します。
+	[[nodiscard]]
+	const Array<Vec2>& positions() const noexcept;
+
+	/// @brief 直前の step() を始めたときの位置の一覧を返します。インデックスは positions() と対応します
+	/// @remark 1 ティックの間の軌跡（前の位置から今の位置への線分）を調べるときに使います。
+	[[nodiscard]]
+	const Array<Vec2>& previousPositions() const noexcept;
+
+	/// @brief 全員を 1 ティック分動かします。
+	/// @param collider 壁
+	/// @param radius 円の半径
+	/// @param deltaTime 経過時間（秒）
+	void step(const CircleCollider& collider, double radius, double deltaTime);
+
+	/// @brief 前回の呼び出し以降に動いたプレイヤーを取り出します。
+	/// @param ids 動いたプレイヤーの ID の格納先。前の内容は消されます
+	/// @param positions 動いたプレイヤーの位置の格納先。前の内容は消されます
+	/// @remark 同じ配列を使い回せば、容量が足りている限りメモリを確保しません。
+	void takeMoved(Array<PlayerID>& ids, Array<Vec2>& positions);
+
+	/// @brief 前回の呼び出し以降に動いたかを、positions() と同じ順で取り出します。
+	/// @param moved 動いたかの格納先。前の内容は消されます
+	void takeMovedFlags(Array<uint8>& moved);
+
+private:
+
+	Array<PlayerID> m_ids;
+
+	Array<Vec2> m_positions;
+
+	Array<Vec2> m_previousPositions;
+
+	Array<Vec2> m_directions;
+
+	Array<double> m_speeds;
+
+	/// @brief 前回の takeMoved() 以降に動いたか
+	Array<uint8> m_moved;
+
+	HashTable<PlayerID, size_t> m_indices;
+};
@@ -0,0 +1,184 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief プレイヤーを ID の昇順に詰めて保持し、ID から O(1) で引ける表
+/// @tparam Replicated ほかのクライアントと共有する成分の型
+/// @tparam Local このクライアントだけが持つ成分の型
+/// @remark Photon のローカル ID は小さな整数なので、ID をそのまま添字にしたスロット配列で詰めた配列の位置を引きます。
+/// 成分ごとに別の配列に持つため、片方だけを走査するときにもう片方を読みません。
+/// 走査の順序は ID の昇順で、どのクライアントでも同じです。
+template <class Replicated, class Local>
+class PlayerTable
+{
+public:
+
+	/// @brief プレイヤーの ID（Multiplayer_Photon の LocalPlayerID）
+	using PlayerID = int32;
+
+	/// @brief すべてのプレイヤーを削除します。
+	void clear()
+	{
+		m_ids.clear();
+		m_replicated.clear();
+		m_locals.clear();
+		m_slots.clear();
+	}
+
+	/// @brief プレイヤーを追加します。すでにいる場合は上書きします。
+	/// @param id プレイヤーの ID（0 以上）
+	/// @param replicated 共有する成分
+	/// @param local このクライアントだけが持つ成分
+	void insert(const PlayerID id, const Replicated& replicated, const Local& local)
+	{
+		assert(0 <= id);
+
+		if (contains(id))
+		{
+			const size_t i = m_slots[id];
+			m_replicated[i] = replicated;
+			m_locals[i] = local;
+			return;
+		}
+
+		// 参加と退出はまれなので、ID の昇順を保つために途中に挿入する
+		const size_t i = static_cast<size_t>(std::lower_bound(m_ids.begin(), m_ids.end(), id) - m_ids.begin());
+		m_ids.insert(m_ids.begin() + i, id);
+		m_replicated.insert(m_replicated.begin() + i, replicated);
+		m_locals.insert(m_locals.begin() + i, local);
+		restoreIndex();
+	}
+
+	/// @brief プレイヤーを削除します。
+	/// @param id プレイヤーの ID
+	void erase(const PlayerID id)
+	{
+		if (not contains(id))
+		{
+			return;
+		}
+
+		const size_t i = m_slots[id];
+		m_ids.erase(m_ids.begin() + i);
+		m_replicated.erase(m_replicated.begin() + i);
+		m_locals.erase(m_locals.begin() + i);
+		restoreIndex();
+	}
+
+	/// @brief プレイヤーがいるかを返します。
+	[[nodiscard]]
+	bool contains(const PlayerID id) const noexcept
+	{
+		return (InRange<PlayerID>(id, 0, static_cast<PlayerID>(m_slots.size()) - 1) and (m_slots[id] != Vacant));
+	}
+
+	/// @brief プレイヤーの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept
+	{
+		return m_ids.size();
+	}
+
+	/// @brief プレイヤーの詰めた配列での位置を返します。
+	/// @param id いるプレイヤーの ID
+	/// @throw Error いないプレイヤーの ID の場合
+	[[nodiscard]]
+	size_t indexOf(const PlayerID id) const
+	{
+		// 置き換え前の HashTable::at() と同じく、範囲外を読まずに例外にする
+		if (not contains(id))
+		{
+			throw Error{ U"PlayerTable::indexOf(): player {} does not exist"_fmt(id) };
+		}
+
+		return m_slots[id];
+	}
+
+	/// @brief 共有する成分を返します。
+	[[nodiscard]]
+	const Replicated& at(const PlayerID id) const
+	{
+		return m_replicated[indexOf(id)];
+	}
+
+	/// @brief 共有する成分を返します。
+	[[nodiscard]]
+	Replicated& at(const PlayerID id)
+	{
+		return m_replicated[indexOf(id)];
+	}
+
+	/// @brief このクライアントだけが持つ成分を返します。
+	[[nodiscard]]
+	const Local& localAt(const PlayerID id) const
+	{
+		return m_locals[indexOf(id)];
+	}
+
+	/// @brief このクライアントだけが持つ成分を返します。
+	[[nodiscard]]
+	Local& localAt(const PlayerID id)
+	{
+		return m_locals[indexOf(id)];
+	}
+
+	/// @brief ID の昇順に並んだ ID の配列を返します。
+	[[nodiscard]]
+	const Array<PlayerID>& ids() const noexcept
+	{
+		return m_ids;
+	}
+
+	/// @brief 共有する成分の配列を返します。インデックスは ids() と対応します
+	[[nodiscard]]
+	const Array<Replicated>& replicated() const noexcept
+	{
+		return m_replicated;
+	}
+
+	/// @brief このクライアントだけが持つ成分の配列を返します。インデックスは ids() と対応します
+	[[nodiscard]]
+	Array<Local>& locals() noexcept
+	{
+		return m_locals;
+	}
+
+	/// @brief このクライアントだけが持つ成分の配列を返します。インデックスは ids() と対応します
+	[[nodiscard]]
+	const Array<Local>& locals() const noexcept
+	{
+		return m_locals;
+	}
+
+	/// @brief 逆シリアライズしたあとに呼び、スロット配列を作り直します。このクライアントだけが持つ成分は既定値になります。
+	void restoreIndex()
+	{
+		m_locals.resize(m_ids.size());
+		m_slots.assign((m_ids ? (static_cast<size_t>(m_ids.back()) + 1) : 0), Vacant);
+
+		for (size_t i = 0; i < m_ids.size(); ++i)
+		{
+			m_slots[m_ids[i]] = static_cast<uint32>(i);
+		}
+	}
+
+	/// @brief 共有する成分だけをシリアライズします。
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(m_ids, m_replicated);
+	}
+
+private:
+
+	/// @brief プレイヤーがいないことを表すスロットの値
+	static constexpr uint32 Vacant = Largest<uint32>;
+
+	Array<PlayerID> m_ids;
+
+	Array<Replicated> m_replicated;
+
+	Array<Local> m_locals;
+
+	/// @brief ID を添字にした、詰めた配列での位置
+	Array<uint32> m_slots;
+};
@@ -0,0 +1,72 @@
+﻿# include "RenderQueue.hpp"
+
+void RenderQueue::submit(const uint8 layer, const State& state, DrawFunction draw)
+{
+	// レイヤー 8 ビット、ステート 16 ビット、積んだ順 32 ビット
+	const uint64 key = ((static_cast<uint64>(layer) << 48)
+		| (static_cast<uint64>(stateIndex(state)) << 32)
+		| static_cast<uint32>(m_commands.size()));
+
+	m_commands << Command{ key, std::move(draw) };
+}
+
+size_t RenderQueue::flush()
+{
+	std::sort(m_commands.begin(), m_commands.end(), [](const Command& a, const Command& b) { return (a.key < b.key); });
+
+	size_t stateChanges = 0;
+	Optional<uint16> current;
+	Optional<ScopedRenderStates2D> renderStates;
+	Optional<ScopedCustomShader2D> customShader;
+
+	for (const auto& command : m_commands)
+	{
+		const uint16 index = static_cast<uint16>(command.key >> 32);
+
+		if (current != index)
+		{
+			const State& state = m_states[index];
+
+			// 先に古いスコープを閉じてから新しいステートを設定する
+			customShader.reset();
+			renderStates.reset();
+			renderStates.emplace(state.sampler, state.blend);
+
+			if (state.pixelShader)
+			{
+				customShader.emplace(*state.pixelShader);
+			}
+
+			current = index;
+			++stateChanges;
+		}
+
+		command.draw();
+	}
+
+	customShader.reset();
+	renderStates.reset();
+	m_commands.clear();
+
+	return stateChanges;
+}
+
+size_t RenderQueue::size() const noexcept
+{
+	return m_commands.size();
+}
+
+uint16 RenderQueue::stateIndex(const State& state)
+{
+	// 1 フレームに使うステートは数種類なので線形探索で十分
+	for (size_t i = 0; i < m_states.size(); ++i)
+	{
+		if (m_states[i] == state)
+		{
+			return static_cast<uint16>(i);
+		}
+	}
+
+	m_states << state;
+	return static_cast<uint16>(m_states.size() - 1);
+}
@@ -0,0 +1,66 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 描画コマンドを描画ステートごとにまとめてから描く
+/// @remark コマンドはレイヤーとステート（サンプラー・ブレンド・ピクセルシェーダ・テクスチャ）を付けて積みます。
+/// flush() はレイヤーの小さい順に、同じレイヤーの中ではステートごとにまとめて描き、ステートはまとまりごとに 1 回だけ切り替えます。
+/// 同じレイヤーで同じステートのコマンドは積んだ順に描かれます。重なり順が大事なものは別のレイヤーにしてください。
+class RenderQueue
+{
+public:
+
+	/// @brief 描画ステート
+	struct State
+	{
+		SamplerState sampler = SamplerState::Default2D;
+
+		BlendState blend = BlendState::Default2D;
+
+		/// @brief カスタムピクセルシェーダ。nullptr なら標準のシェーダ
+		const PixelShader* pixelShader = nullptr;
+
+		/// @brief 並べ替えのためのテクスチャの ID。テクスチャを使わない場合は 0
+		uint64 textureID = 0;
+
+		[[nodiscard]]
+		friend bool operator ==(const State& a, const State& b) noexcept
+		{
+			return ((a.sampler == b.sampler) and (a.blend == b.blend)
+				and (a.pixelShader == b.pixelShader) and (a.textureID == b.textureID));
+		}
+	};
+
+	using DrawFunction = std::function<void()>;
+
+	/// @brief 描画コマンドを積みます。
+	/// @param layer レイヤー。小さいほど先に（下に）描かれます
+	/// @param state 描画ステート
+	/// @param draw 描画する関数。flush() のときに、state が設定された状態で呼ばれます
+	void submit(uint8 layer, const State& state, DrawFunction draw);
+
+	/// @brief 積んだコマンドを並べ替えて描き、積んだものを消します。
+	/// @return ステートを切り替えた回数
+	size_t flush();
+
+	/// @brief 積んでいるコマンドの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+private:
+
+	struct Command
+	{
+		/// @brief レイヤー、ステートの番号、積んだ順を詰めた並べ替えのキー
+		uint64 key = 0;
+
+		DrawFunction draw;
+	};
+
+	/// @brief これまでに使われたステート。インデックスがステートの番号になる
+	Array<State> m_states;
+
+	Array<Command> m_commands;
+
+	[[nodiscard]]
+	uint16 stateIndex(const State& state);
+};
@@ -0,0 +1,133 @@
+﻿# include "ServerClock.hpp"
+# include "SessionReplay.hpp"
+
+void ServerClock::addSample(const int32 serverTimeMillisec)
+{
+	const double local = LocalMillisec();
+
+	if (not m_synchronized)
+	{
+		m_offsetMillisec = (serverTimeMillisec - local);
+		m_synchronized = true;
+		return;
+	}
+
+	const double error = Diff(serverTimeMillisec, nowMillisec());
+
+	if (SnapThresholdMillisec < Abs(error))
+	{
+		m_offsetMillisec += error;
+	}
+	else
+	{
+		m_offsetMillisec += Clamp((error * SmoothingRate), -MaxSlewMillisec, MaxSlewMillisec);
+	}
+}
+
+void ServerClock::reset() noexcept
+{
+	m_synchronized = false;
+	m_offsetMillisec = 0.0;
+}
+
+bool ServerClock::isSynchronized() const noexcept
+{
+	return m_synchronized;
+}
+
+int32 ServerClock::nowMillisec() const
+{
+	// int64 から uint32 への変換で 2^32 を法として一周させる
+	const int64 time = static_cast<int64>(Math::Floor(LocalMillisec() + m_offsetMillisec));
+	return static_cast<int32>(static_cast<uint32>(time));
+}
+
+double ServerClock::LocalMillisec()
+{
+	if (ISteadyClock* clock = GetGameClock())
+	{
+		return (clock->getMicrosec() / 1000.0);
+	}
+
+	return (Time::GetMicrosec() / 1000.0);
+}
+
+void ServerTimer::restart(const Duration& duration)
+{
+	restartUntil(ServerClock::Add(m_clock->nowMillisec(), ServerClock::ToMillisec(duration)), duration);
+}
+
+void ServerTimer::restartUntil(const int32 deadlineMillisec, const Duration& duration)
+{
+	m_isStarted = true;
+	m_deadlineMillisec = deadlineMillisec;
+	m_durationMillisec = Max(ServerClock::ToMillisec(duration), 0);
+}
+
+void ServerTimer::reset() noexcept
+{
+	m_isStarted = false;
+	m_deadlineMillisec = 0;
+	m_durationMillisec = 0;
+}
+
+bool ServerTimer::isStarted() const noexcept
+{
+	return m_isStarted;
+}
+
+bool ServerTimer::isRunning() const
+{
+	return (0 < remainingMillisec());
+}
+
+int32 ServerTimer::deadlineMillisec() const noexcept
+{
+	return m_deadlineMillisec;
+}
+
+Duration ServerTimer::duration() const noexcept
+{
+	return Duration{ m_durationMillisec / 1000.0 };
+}
+
+Duration ServerTimer::remaining() const
+{
+	return Duration{ remainingMillisec() / 1000.0 };
+}
+
+double ServerTimer::sF() const
+{
+	return (remainingMillisec() / 1000.0);
+}
+
+int32 ServerTimer::s_ceil() const
+{
+	return static_cast<int32>(Math::Ceil(sF()));
+}
+
+double ServerTimer::progress1_0() const
+{
+	if (m_durationMillisec == 0)
+	{
+		return 0.0;
+	}
+
+	return (static_cast<double>(remainingMillisec()) / m_durationMillisec);
+}
+
+double ServerTimer::progress0_1() const
+{
+	return (1.0 - progress1_0());
+}
+
+int32 ServerTimer::remainingMillisec() const
+{
+	if ((not m_isStarted) or (not m_clock))
+	{
+		return 0;
+	}
+
+	// 締め切りが未来すぎる値（時刻のずれなど）は長さで打ち切る
+	return Clamp(ServerClock::Diff(m_deadlineMillisec, m_clock->nowMillisec()), 0, m_durationMillisec);
+}
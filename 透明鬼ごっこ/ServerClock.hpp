@@ -0,0 +1,134 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief Photon のサーバ時刻に同期した時計
+/// @remark サーバ時刻はミリ秒単位の int32 で、約 49 日で一周します。時刻の比較には Diff() を使ってください。
+class ServerClock
+{
+public:
+
+	/// @brief サーバ時刻のサンプルを取り込み、ローカル時計とのずれを平滑化して更新します。
+	/// @param serverTimeMillisec Multiplayer_Photon::getServerTimeMillisec() の値
+	/// @remark ずれが大きい場合はすぐに合わせ、小さい場合は少しずつ合わせるため、時刻が目に見えて跳ぶことはありません。
+	void addSample(int32 serverTimeMillisec);
+
+	/// @brief 同期の状態を破棄します。
+	void reset() noexcept;
+
+	/// @brief サンプルを 1 つ以上取り込んだかを返します。
+	[[nodiscard]]
+	bool isSynchronized() const noexcept;
+
+	/// @brief 現在のサーバ時刻（ミリ秒）を返します。
+	[[nodiscard]]
+	int32 nowMillisec() const;
+
+	/// @brief 一周を考慮して、サーバ時刻 a - b（ミリ秒）を返します。
+	[[nodiscard]]
+	static constexpr int32 Diff(const int32 a, const int32 b) noexcept
+	{
+		return static_cast<int32>(static_cast<uint32>(a) - static_cast<uint32>(b));
+	}
+
+	/// @brief 一周を考慮して、サーバ時刻に時間を足します。
+	[[nodiscard]]
+	static constexpr int32 Add(const int32 time, const int32 millisec) noexcept
+	{
+		return static_cast<int32>(static_cast<uint32>(time) + static_cast<uint32>(millisec));
+	}
+
+	/// @brief 時間をミリ秒に変換します。
+	[[nodiscard]]
+	static int32 ToMillisec(const Duration& duration) noexcept
+	{
+		return static_cast<int32>(Math::Round(duration.count() * 1000.0));
+	}
+
+private:
+
+	/// @brief これ以上ずれている場合は平滑化せずに合わせる（ミリ秒）
+	static constexpr double SnapThresholdMillisec = 500.0;
+
+	/// @brief 1 サンプルあたりにずれを詰める割合
+	static constexpr double SmoothingRate = 0.05;
+
+	/// @brief 1 サンプルあたりに補正する最大量（ミリ秒）
+	static constexpr double MaxSlewMillisec = 2.0;
+
+	bool m_synchronized = false;
+
+	/// @brief サーバ時刻 - ローカル時刻（ミリ秒）
+	double m_offsetMillisec = 0.0;
+
+	[[nodiscard]]
+	static double LocalMillisec();
+};
+
+/// @brief サーバ時刻の締め切りで止まるタイマー
+/// @remark 締め切りをサーバ時刻で共有すれば、すべてのクライアントで同時に止まります。
+class ServerTimer
+{
+public:
+
+	SIV3D_NODISCARD_CXX20
+	ServerTimer() = default;
+
+	SIV3D_NODISCARD_CXX20
+	explicit ServerTimer(const ServerClock& clock) noexcept
+		: m_clock{ &clock } {}
+
+	/// @brief 今から duration 後を締め切りとしてタイマーを開始します。
+	void restart(const Duration& duration);
+
+	/// @brief deadlineMillisec を締め切りとして、長さ duration のタイマーを開始します。
+	/// @param deadlineMillisec 締め切りのサーバ時刻（ミリ秒）
+	/// @param duration タイマーの長さ
+	void restartUntil(int32 deadlineMillisec, const Duration& duration);
+
+	/// @brief タイマーを止めます。
+	void reset() noexcept;
+
+	[[nodiscard]]
+	bool isStarted() const noexcept;
+
+	/// @brief タイマーが締め切り前であるかを返します。
+	[[nodiscard]]
+	bool isRunning() const;
+
+	/// @brief 締め切りのサーバ時刻（ミリ秒）を返します。
+	[[nodiscard]]
+	int32 deadlineMillisec() const noexcept;
+
+	[[nodiscard]]
+	Duration duration() const noexcept;
+
+	[[nodiscard]]
+	Duration remaining() const;
+
+	/// @brief 残り時間（秒）を返します。
+	[[nodiscard]]
+	double sF() const;
+
+	/// @brief 残り時間（秒）を切り上げて返します。
+	[[nodiscard]]
+	int32 s_ceil() const;
+
+	[[nodiscard]]
+	double progress1_0() const;
+
+	[[nodiscard]]
+	double progress0_1() const;
+
+private:
+
+	const ServerClock* m_clock = nullptr;
+
+	bool m_isStarted = false;
+
+	int32 m_deadlineMillisec = 0;
+
+	int32 m_durationMillisec = 0;
+
+	[[nodiscard]]
+	int32 remainingMillisec() const;
+};
@@ -0,0 +1,159 @@
+﻿# include "SessionReplay.hpp"
+
+namespace
+{
+	constexpr uint32 SessionRecordMagic = 0x52535454; // "TTSR"
+
+	ISteadyClock* g_gameClock = nullptr;
+}
+
+bool SessionRecord::save(const FilePathView path) const
+{
+	Serializer<BinaryWriter> writer{ path };
+
+	if (not writer)
+	{
+		return false;
+	}
+
+	writer(SessionRecordMagic, Version, localPlayerID, isHost, userName, randomSeed, frames);
+	return true;
+}
+
+Optional<SessionRecord> SessionRecord::Load(const FilePathView path)
+{
+	Deserializer<BinaryReader> reader{ path };
+
+	if (not reader)
+	{
+		return none;
+	}
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	reader(magic, version);
+
+	if ((magic != SessionRecordMagic) or (version != Version))
+	{
+		return none;
+	}
+
+	SessionRecord record;
+	reader(record.localPlayerID, record.isHost, record.userName, record.randomSeed, record.frames);
+	return record;
+}
+
+size_t SessionRecord::countEvents() const
+{
+	size_t count = 0;
+
+	for (const auto& frame : frames)
+	{
+		count += frame.events.size();
+	}
+
+	return count;
+}
+
+void SessionRecorder::start(const LocalPlayerID localPlayerID, const bool isHost, const String& userName, const uint64 randomSeed)
+{
+	m_record = SessionRecord{};
+	m_record.localPlayerID = localPlayerID;
+	m_record.isHost = isHost;
+	m_record.userName = userName;
+	m_record.randomSeed = randomSeed;
+	m_pendingEvents.clear();
+	m_isRecording = true;
+}
+
+void SessionRecorder::stop()
+{
+	m_isRecording = false;
+}
+
+bool SessionRecorder::isRecording() const noexcept
+{
+	return m_isRecording;
+}
+
+void SessionRecorder::addCustomEvent(const LocalPlayerID playerID, const uint8 eventCode, Deserializer<MemoryViewReader>& reader)
+{
+	if (not m_isRecording)
+	{
+		return;
+	}
+
+	RecordedEvent event{ .type = RecordedEventType::Custom, .playerID = playerID, .eventCode = eventCode };
+	event.data.resize(static_cast<size_t>(reader->size()));
+	reader->lookahead(event.data.data(), 0, reader->size());
+	m_pendingEvents << std::move(event);
+}
+
+void SessionRecorder::addRawEvent(const LocalPlayerID playerID, const uint8 eventCode, const void* data, const size_t size)
+{
+	if (not m_isRecording)
+	{
+		return;
+	}
+
+	const uint8* bytes = static_cast<const uint8*>(data);
+	RecordedEvent event{ .type = RecordedEventType::Custom, .playerID = playerID, .eventCode = eventCode };
+	event.data.assign(bytes, (bytes + size));
+	m_pendingEvents << std::move(event);
+}
+
+void SessionRecorder::addJoinEvent(const LocalPlayerID playerID, const bool isSelf)
+{
+	if (not m_isRecording)
+	{
+		return;
+	}
+
+	m_pendingEvents << RecordedEvent{ .type = RecordedEventType::Join, .playerID = playerID, .flag = isSelf };
+}
+
+void SessionRecorder::addLeaveEvent(const LocalPlayerID playerID, const bool isInactive)
+{
+	if (not m_isRecording)
+	{
+		return;
+	}
+
+	m_pendingEvents << RecordedEvent{ .type = RecordedEventType::Leave, .playerID = playerID, .flag = isInactive };
+}
+
+void SessionRecorder::commitFrame(const double deltaTime, const int32 serverTimeMillisec, const FrameInput& input)
+{
+	if (not m_isRecording)
+	{
+		return;
+	}
+
+	m_record.frames << RecordedFrame{ deltaTime, serverTimeMillisec, input, std::move(m_pendingEvents) };
+	m_pendingEvents.clear();
+}
+
+const SessionRecord& SessionRecorder::record() const noexcept
+{
+	return m_record;
+}
+
+uint64 ReplayClock::getMicrosec()
+{
+	return m_microsec;
+}
+
+void ReplayClock::advance(const double seconds)
+{
+	m_microsec += static_cast<uint64>(seconds * 1'000'000);
+}
+
+ISteadyClock* GetGameClock() noexcept
+{
+	return g_gameClock;
+}
+
+void SetGameClock(ISteadyClock* clock) noexcept
+{
+	g_gameClock = clock;
+}
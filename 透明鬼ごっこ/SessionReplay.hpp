@@ -0,0 +1,135 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+# include "Multiplayer_Photon.hpp"
+
+/// @brief 1 フレーム分のプレイヤー入力
+struct FrameInput {
+	Vec2 axis{ 0, 0 };
+	bool transparent = false;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(axis, transparent);
+	}
+};
+
+enum class RecordedEventType : uint8 {
+	Custom,
+	Join,
+	Leave,
+};
+
+/// @brief 記録されたネットワークイベント
+struct RecordedEvent {
+	RecordedEventType type = RecordedEventType::Custom;
+	LocalPlayerID playerID = 0;
+	uint8 eventCode = 0;
+	bool flag = false; // Join: isSelf, Leave: isInactive
+	Array<uint8> data;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(type, playerID, eventCode, flag, data);
+	}
+};
+
+/// @brief 記録された 1 フレーム
+struct RecordedFrame {
+	double deltaTime = 0.0;
+	int32 serverTimeMillisec = 0;
+	FrameInput input;
+	Array<RecordedEvent> events;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(deltaTime, serverTimeMillisec, input, events);
+	}
+};
+
+/// @brief ルームに入ってから出るまでのセッションの記録
+struct SessionRecord {
+	static constexpr uint32 Version = 3;
+
+	LocalPlayerID localPlayerID = 0;
+	bool isHost = false;
+	String userName;
+	uint64 randomSeed = 0;
+	Array<RecordedFrame> frames;
+
+	/// @brief 記録をファイルに保存します。
+	/// @param path 保存先のパス
+	/// @return 保存に成功した場合 true, それ以外の場合は false
+	bool save(FilePathView path) const;
+
+	/// @brief 記録をファイルから読み込みます。
+	/// @param path 読み込むファイルのパス
+	/// @return 読み込んだ記録。失敗した場合は none
+	[[nodiscard]]
+	static Optional<SessionRecord> Load(FilePathView path);
+
+	/// @brief 記録に含まれるイベントの総数を返します。
+	[[nodiscard]]
+	size_t countEvents() const;
+};
+
+/// @brief プレイ中のセッションを記録します。
+/// @remark ネットワークイベントは update() の中で届くため、次の commitFrame() までのイベントをそのフレームに含めます。
+class SessionRecorder {
+public:
+
+	void start(LocalPlayerID localPlayerID, bool isHost, const String& userName, uint64 randomSeed);
+
+	void stop();
+
+	[[nodiscard]]
+	bool isRecording() const noexcept;
+
+	void addCustomEvent(LocalPlayerID playerID, uint8 eventCode, Deserializer<MemoryViewReader>& reader);
+
+	/// @brief Hashtable に包まずに届いたカスタム型のイベントを、受け取ったバイト列のまま記録します。
+	/// @remark 再生時は addCustomEvent() で記録したイベントと同じく、customEventAction() に渡されます。
+	void addRawEvent(LocalPlayerID playerID, uint8 eventCode, const void* data, size_t size);
+
+	void addJoinEvent(LocalPlayerID playerID, bool isSelf);
+
+	void addLeaveEvent(LocalPlayerID playerID, bool isInactive);
+
+	void commitFrame(double deltaTime, int32 serverTimeMillisec, const FrameInput& input);
+
+	[[nodiscard]]
+	const SessionRecord& record() const noexcept;
+
+private:
+
+	bool m_isRecording = false;
+
+	SessionRecord m_record;
+
+	Array<RecordedEvent> m_pendingEvents;
+};
+
+/// @brief リプレイ時に Timer や Stopwatch を駆動する、手動で進める時計
+class ReplayClock : public ISteadyClock {
+public:
+
+	[[nodiscard]]
+	uint64 getMicrosec() override;
+
+	void advance(double seconds);
+
+private:
+
+	uint64 m_microsec = 0;
+};
+
+/// @brief ゲームの Timer / Stopwatch が使う時計を返します。
+/// @return リプレイ中は ReplayClock, それ以外の場合は nullptr（システムの時計）
+[[nodiscard]]
+ISteadyClock* GetGameClock() noexcept;
+
+/// @brief ゲームの Timer / Stopwatch が使う時計を設定します。
+/// @param clock 使用する時計。nullptr の場合はシステムの時計
+void SetGameClock(ISteadyClock* clock) noexcept;
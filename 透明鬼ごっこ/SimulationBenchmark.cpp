@@ -0,0 +1,175 @@
+﻿# include "SimulationBenchmark.hpp"
+# include "PlayerSimulation.hpp"
+# include "CircleCollider.hpp"
+# include "Interest.hpp"
+# include "BenchmarkStats.hpp"
+# include "AllocationCounter.hpp"
+
+namespace
+{
+	constexpr double BodyRadius = 15.0;
+
+	constexpr double Speed = 200.0;
+
+	constexpr double TickTime = (1.0 / 60.0);
+
+	/// @brief 100 人で 1 ティックにかけてよい時間（ミリ秒）
+	constexpr double TickBudgetMillisec = 1.0;
+
+	/// @brief ホストが見えるプレイヤーを送る間隔（ティック）。Main の moveBroadcastInterval と合わせる
+	constexpr int32 BroadcastInterval = 3;
+
+	/// @brief 見える範囲。Main の visibilityRange と合わせる
+	constexpr double VisibilityRange = 800.0;
+
+	/// @brief 送るプレイヤーを選ぶところまで計測する最大の人数。全員どうしを調べるため、これより多いと時間がかかりすぎる
+	constexpr int32 MaxBroadcastPlayers = 100;
+
+	struct RunResult
+	{
+		/// @brief 1 ティック全体。送るプレイヤーを選ぶティックはその時間も含む
+		BenchmarkStats tick;
+
+		/// @brief 送るプレイヤーを選ぶ時間だけ
+		BenchmarkStats broadcast;
+
+		/// @brief 見える範囲を計算し直した回数
+		uint64 viewRebuilds = 0;
+	};
+
+	/// @brief players 人を ticks ティック動かし、入力の反映から動いたプレイヤーの取り出しまでを 1 サンプルとして計測します。
+	/// @remark players が MaxBroadcastPlayers 以下なら、ホストが各プレイヤーに送るプレイヤーを選ぶ処理（Main の broadcastVisibleMoves）も含めます。
+	[[nodiscard]]
+	RunResult Run(const CircleCollider& collider, VisibilityMap& visibility, const Array<Vec2>& starts, const int32 players, const int32 ticks)
+	{
+		// 人が入力を変える間隔（ティック）。全員が同じティックに変えないようにずらす
+		constexpr int32 TicksPerInput = 30;
+
+		PlayerSimulation simulation;
+
+		for (int32 i = 0; i < players; ++i)
+		{
+			simulation.setPlayer(i, starts[i]);
+			simulation.setSpeed(i, Speed);
+		}
+
+		Array<Array<Vec2>> inputs(ticks / TicksPerInput + 1, Arg::generator = [&]()
+			{
+				return Array<Vec2>(players, Arg::generator = []() { return BenchmarkRun::RandomDirection(); });
+			});
+
+		Array<PlayerSimulation::PlayerID> movedIDs;
+		Array<Vec2> movedPositions;
+		movedIDs.reserve(players);
+		movedPositions.reserve(players);
+
+		const bool broadcasts = (players <= MaxBroadcastPlayers);
+		InterestTracker interest;
+		Array<uint8> movedFlags;
+		Array<InterestTracker::PlayerID> sentIDs;
+		Array<Vec2> sentPositions;
+		Array<InterestTracker::PlayerID> hiddenIDs;
+
+		RunResult result;
+		result.tick.reserve(ticks);
+
+		for (int32 tick = 0; tick < ticks; ++tick)
+		{
+			const uint64 allocationsBefore = AllocationCounter::GetCount();
+			const uint64 begin = Time::GetNanosec();
+
+			for (int32 i = 0; i < players; ++i)
+			{
+				if (((tick + i) % TicksPerInput) == 0)
+				{
+					simulation.setInput(i, inputs[(tick + i) / TicksPerInput][i]);
+				}
+			}
+
+			simulation.step(collider, BodyRadius, TickTime);
+
+			if (broadcasts)
+			{
+				// Main と同じく、動いたかは送るときにまとめて取り出す
+				if ((tick % BroadcastInterval) == 0)
+				{
+					const uint64 broadcastBegin = Time::GetNanosec();
+
+					simulation.takeMovedFlags(movedFlags);
+
+					for (size_t r = 0; r < simulation.ids().size(); ++r)
+					{
+						interest.update(visibility, simulation.ids()[r], simulation.positions()[r], VisibilityRange, BodyRadius,
+							simulation.ids(), simulation.positions(), movedFlags, sentIDs, sentPositions, hiddenIDs);
+					}
+
+					result.broadcast.addSample((Time::GetNanosec() - broadcastBegin) / 1'000'000.0);
+				}
+			}
+			else
+			{
+				simulation.takeMoved(movedIDs, movedPositions);
+			}
+
+			result.tick.addSample(((Time::GetNanosec() - begin) / 1'000'000.0), (AllocationCounter::GetCount() - allocationsBefore));
+		}
+
+		result.viewRebuilds = interest.rebuildCount();
+		return result;
+	}
+}
+
+bool RunSimulationBenchmark(const CircleCollider& collider, const Optional<FilePath>& jsonPath)
+{
+	constexpr int32 Ticks = 600;
+
+	BenchmarkRun::Begin();
+
+	JSON summary;
+	summary[U"ticks"] = Ticks;
+	summary[U"tick_budget_ms"] = TickBudgetMillisec;
+
+	summary[U"broadcast_interval_ticks"] = BroadcastInterval;
+
+	VisibilityMap visibility{ collider.walls(), collider.bounds() };
+
+	constexpr int32 MaxPlayers = 1000;
+	const Optional<Array<Vec2>> starts = BenchmarkRun::RandomFreePositions(collider, BodyRadius, MaxPlayers);
+
+	if (not starts)
+	{
+		Console << U"[sim-bench] the level has no free space for the players";
+		return false;
+	}
+
+	bool passed = true;
+
+	for (const int32 players : { 100, 400, MaxPlayers })
+	{
+		const RunResult run = Run(collider, visibility, *starts, players, Ticks);
+
+		JSON result = run.tick.toJSON();
+		result[U"players"] = players;
+		result[U"us_per_player"] = ((run.tick.percentile(0.5) * 1000.0) / players);
+
+		if (run.broadcast.count())
+		{
+			result[U"broadcast"] = run.broadcast.toJSON();
+			result[U"view_rebuilds"] = run.viewRebuilds;
+		}
+
+		summary[U"runs"].push_back(result);
+
+		// 送るプレイヤーを選ぶティックも含めて予算に収まるか
+		if (players == 100)
+		{
+			passed = (run.tick.percentile(0.99) <= TickBudgetMillisec);
+		}
+	}
+
+	summary[U"budget_check"] = (passed ? U"passed" : U"failed");
+
+	BenchmarkRun::Finish(summary, jsonPath);
+
+	return passed;
+}
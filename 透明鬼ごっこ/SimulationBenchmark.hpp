@@ -0,0 +1,11 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+class CircleCollider;
+
+/// @brief PlayerSimulation で多数のプレイヤーを動かしたときの 1 ティックの所要時間を計測し、結果をコンソールに出力します。
+/// @remark 100 人までは、ホストが各プレイヤーに見えるプレイヤーを選ぶ処理も 1 ティックに含めて計測します。
+/// @param collider 焼き込み済みの壁
+/// @param jsonPath 結果の JSON の保存先。none の場合は保存しません
+/// @return 100 人での 1 ティックの 99 パーセンタイルが予算内に収まった場合 true, それ以外の場合は false
+bool RunSimulationBenchmark(const CircleCollider& collider, const Optional<FilePath>& jsonPath);
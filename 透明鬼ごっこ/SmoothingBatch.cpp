@@ -0,0 +1,223 @@
+﻿# include "SmoothingBatch.hpp"
+
+# if SIV3D_INTRINSIC(SSE)
+#	include <emmintrin.h>
+# endif
+
+# if defined(__AVX__)
+#	include <immintrin.h>
+# endif
+
+namespace
+{
+	/// @brief Math::SmoothDamp と同じ、ばね定数と減衰の近似
+	[[nodiscard]]
+	std::pair<double, double> OmegaAndExp(double smoothTime, const double deltaTime)
+	{
+		smoothTime = Max(0.0001, smoothTime);
+		const double omega = (2.0 / smoothTime);
+		const double x = (omega * deltaTime);
+		const double exp = (1.0 / (1.0 + x + 0.48 * x * x + 0.235 * x * x * x));
+		return{ omega, exp };
+	}
+}
+
+void SmoothingBatch::clear()
+{
+	m_px.clear();
+	m_py.clear();
+	m_vx.clear();
+	m_vy.clear();
+	m_tx.clear();
+	m_ty.clear();
+	m_facingRight.clear();
+}
+
+void SmoothingBatch::reserve(const size_t n)
+{
+	m_px.reserve(n);
+	m_py.reserve(n);
+	m_vx.reserve(n);
+	m_vy.reserve(n);
+	m_tx.reserve(n);
+	m_ty.reserve(n);
+	m_facingRight.reserve(n);
+}
+
+void SmoothingBatch::push(const Vec2& pos, const Vec2& velocity, const Vec2& target, const bool isFacingRight)
+{
+	m_px << pos.x;
+	m_py << pos.y;
+	m_vx << velocity.x;
+	m_vy << velocity.y;
+	m_tx << target.x;
+	m_ty << target.y;
+	m_facingRight << isFacingRight;
+}
+
+StringView SmoothingBatch::SimdPath() noexcept
+{
+# if defined(__AVX__)
+	return U"AVX";
+# elif SIV3D_INTRINSIC(SSE)
+	return U"SSE2";
+# else
+	return U"none";
+# endif
+}
+
+size_t SmoothingBatch::size() const noexcept
+{
+	return m_px.size();
+}
+
+void SmoothingBatch::update(const double smoothTime, const double deltaTime, const double facingSpeed)
+{
+	const auto [omega, exp] = OmegaAndExp(smoothTime, deltaTime);
+	const size_t count = m_px.size();
+	size_t i = 0;
+
+# if defined(__AVX__)
+
+	{
+		const __m256d vOmega = _mm256_set1_pd(omega);
+		const __m256d vExp = _mm256_set1_pd(exp);
+		const __m256d vDeltaTime = _mm256_set1_pd(deltaTime);
+		const __m256d zero = _mm256_setzero_pd();
+
+		for (; (i + 4) <= count; i += 4)
+		{
+			const __m256d px = _mm256_loadu_pd(m_px.data() + i);
+			const __m256d py = _mm256_loadu_pd(m_py.data() + i);
+			const __m256d vx = _mm256_loadu_pd(m_vx.data() + i);
+			const __m256d vy = _mm256_loadu_pd(m_vy.data() + i);
+			const __m256d tx = _mm256_loadu_pd(m_tx.data() + i);
+			const __m256d ty = _mm256_loadu_pd(m_ty.data() + i);
+
+			const __m256d cx = _mm256_sub_pd(px, tx);
+			const __m256d cy = _mm256_sub_pd(py, ty);
+			const __m256d tempX = _mm256_mul_pd(_mm256_add_pd(vx, _mm256_mul_pd(vOmega, cx)), vDeltaTime);
+			const __m256d tempY = _mm256_mul_pd(_mm256_add_pd(vy, _mm256_mul_pd(vOmega, cy)), vDeltaTime);
+			const __m256d newVX = _mm256_mul_pd(_mm256_sub_pd(vx, _mm256_mul_pd(vOmega, tempX)), vExp);
+			const __m256d newVY = _mm256_mul_pd(_mm256_sub_pd(vy, _mm256_mul_pd(vOmega, tempY)), vExp);
+			const __m256d rx = _mm256_add_pd(tx, _mm256_mul_pd(_mm256_add_pd(cx, tempX), vExp));
+			const __m256d ry = _mm256_add_pd(ty, _mm256_mul_pd(_mm256_add_pd(cy, tempY), vExp));
+
+			// 目標を通り過ぎたら目標で止める: dot(target - pos, result - target) > 0
+			const __m256d overshoot = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(tx, px), _mm256_sub_pd(rx, tx)),
+				_mm256_mul_pd(_mm256_sub_pd(ty, py), _mm256_sub_pd(ry, ty)));
+			const __m256d mask = _mm256_cmp_pd(overshoot, zero, _CMP_GT_OQ);
+
+			_mm256_storeu_pd(m_px.data() + i, _mm256_blendv_pd(rx, tx, mask));
+			_mm256_storeu_pd(m_py.data() + i, _mm256_blendv_pd(ry, ty, mask));
+			_mm256_storeu_pd(m_vx.data() + i, _mm256_andnot_pd(mask, newVX));
+			_mm256_storeu_pd(m_vy.data() + i, _mm256_andnot_pd(mask, newVY));
+		}
+	}
+
+# endif
+
+# if SIV3D_INTRINSIC(SSE)
+
+	{
+		const __m128d vOmega = _mm_set1_pd(omega);
+		const __m128d vExp = _mm_set1_pd(exp);
+		const __m128d vDeltaTime = _mm_set1_pd(deltaTime);
+		const __m128d zero = _mm_setzero_pd();
+
+		for (; (i + 2) <= count; i += 2)
+		{
+			const __m128d px = _mm_loadu_pd(m_px.data() + i);
+			const __m128d py = _mm_loadu_pd(m_py.data() + i);
+			const __m128d vx = _mm_loadu_pd(m_vx.data() + i);
+			const __m128d vy = _mm_loadu_pd(m_vy.data() + i);
+			const __m128d tx = _mm_loadu_pd(m_tx.data() + i);
+			const __m128d ty = _mm_loadu_pd(m_ty.data() + i);
+
+			const __m128d cx = _mm_sub_pd(px, tx);
+			const __m128d cy = _mm_sub_pd(py, ty);
+			const __m128d tempX = _mm_mul_pd(_mm_add_pd(vx, _mm_mul_pd(vOmega, cx)), vDeltaTime);
+			const __m128d tempY = _mm_mul_pd(_mm_add_pd(vy, _mm_mul_pd(vOmega, cy)), vDeltaTime);
+			const __m128d newVX = _mm_mul_pd(_mm_sub_pd(vx, _mm_mul_pd(vOmega, tempX)), vExp);
+			const __m128d newVY = _mm_mul_pd(_mm_sub_pd(vy, _mm_mul_pd(vOmega, tempY)), vExp);
+			const __m128d rx = _mm_add_pd(tx, _mm_mul_pd(_mm_add_pd(cx, tempX), vExp));
+			const __m128d ry = _mm_add_pd(ty, _mm_mul_pd(_mm_add_pd(cy, tempY), vExp));
+
+			// 目標を通り過ぎたら目標で止める: dot(target - pos, result - target) > 0
+			const __m128d overshoot = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(tx, px), _mm_sub_pd(rx, tx)),
+				_mm_mul_pd(_mm_sub_pd(ty, py), _mm_sub_pd(ry, ty)));
+			const __m128d mask = _mm_cmpgt_pd(overshoot, zero);
+
+			_mm_storeu_pd(m_px.data() + i, _mm_or_pd(_mm_and_pd(mask, tx), _mm_andnot_pd(mask, rx)));
+			_mm_storeu_pd(m_py.data() + i, _mm_or_pd(_mm_and_pd(mask, ty), _mm_andnot_pd(mask, ry)));
+			_mm_storeu_pd(m_vx.data() + i, _mm_andnot_pd(mask, newVX));
+			_mm_storeu_pd(m_vy.data() + i, _mm_andnot_pd(mask, newVY));
+		}
+	}
+
+# endif
+
+	updateRange(i, count, omega, exp, deltaTime);
+	updateFacing(facingSpeed);
+}
+
+void SmoothingBatch::updateScalar(const double smoothTime, const double deltaTime, const double facingSpeed)
+{
+	const auto [omega, exp] = OmegaAndExp(smoothTime, deltaTime);
+	updateRange(0, m_px.size(), omega, exp, deltaTime);
+	updateFacing(facingSpeed);
+}
+
+Vec2 SmoothingBatch::position(const size_t i) const
+{
+	return{ m_px[i], m_py[i] };
+}
+
+Vec2 SmoothingBatch::velocity(const size_t i) const
+{
+	return{ m_vx[i], m_vy[i] };
+}
+
+bool SmoothingBatch::isFacingRight(const size_t i) const
+{
+	return (m_facingRight[i] != 0);
+}
+
+void SmoothingBatch::updateRange(const size_t begin, const size_t end, const double omega, const double exp, const double deltaTime)
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		const double cx = (m_px[i] - m_tx[i]);
+		const double cy = (m_py[i] - m_ty[i]);
+		const double tempX = ((m_vx[i] + omega * cx) * deltaTime);
+		const double tempY = ((m_vy[i] + omega * cy) * deltaTime);
+		const double rx = (m_tx[i] + (cx + tempX) * exp);
+		const double ry = (m_ty[i] + (cy + tempY) * exp);
+
+		if (0.0 < ((m_tx[i] - m_px[i]) * (rx - m_tx[i]) + (m_ty[i] - m_py[i]) * (ry - m_ty[i])))
+		{
+			m_px[i] = m_tx[i];
+			m_py[i] = m_ty[i];
+			m_vx[i] = 0.0;
+			m_vy[i] = 0.0;
+		}
+		else
+		{
+			m_px[i] = rx;
+			m_py[i] = ry;
+			m_vx[i] = ((m_vx[i] - omega * tempX) * exp);
+			m_vy[i] = ((m_vy[i] - omega * tempY) * exp);
+		}
+	}
+}
+
+void SmoothingBatch::updateFacing(const double facingSpeed)
+{
+	// 分岐のない形にしておくと、コンパイラがベクトル化できる
+	for (size_t i = 0; i < m_vx.size(); ++i)
+	{
+		const uint8 right = (facingSpeed < m_vx[i]);
+		const uint8 left = (m_vx[i] < -facingSpeed);
+		m_facingRight[i] = static_cast<uint8>((m_facingRight[i] & ~left) | right);
+	}
+}
@@ -0,0 +1,73 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 多数の点を Math::SmoothDamp と同じ式でまとめて目標に近づけるバッチ
+/// @remark 位置・速度・目標を x と y の別々の配列（SoA）に持ち、SIMD で複数の点を同時に計算します。
+/// 最大速度の制限はありません。
+class SmoothingBatch
+{
+public:
+
+	/// @brief すべての点を削除します。容量は保たれます。
+	void clear();
+
+	/// @brief 容量を予約します。
+	/// @param n 点の数
+	void reserve(size_t n);
+
+	/// @brief 点を追加します。
+	/// @param pos 現在の位置
+	/// @param velocity 現在の速度
+	/// @param target 目標の位置
+	/// @param isFacingRight 右を向いているか
+	void push(const Vec2& pos, const Vec2& velocity, const Vec2& target, bool isFacingRight);
+
+	/// @brief 点の数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief すべての点を 1 ステップ進めます。
+	/// @param smoothTime 目標に到達するまでのおおよその時間（秒）
+	/// @param deltaTime 経過時間（秒）
+	/// @param facingSpeed 横向きの速さがこれを超えたら、その向きを向く
+	void update(double smoothTime, double deltaTime, double facingSpeed);
+
+	/// @brief update() と同じ計算を SIMD を使わずに行います。
+	void updateScalar(double smoothTime, double deltaTime, double facingSpeed);
+
+	/// @brief update() が使う SIMD の命令セットの名前を返します。
+	/// @return "AVX", "SSE2" または "none"
+	/// @remark AVX の経路は AVX2 を有効にした構成（BenchmarkAVX2）でだけコンパイルされます。
+	[[nodiscard]]
+	static StringView SimdPath() noexcept;
+
+	[[nodiscard]]
+	Vec2 position(size_t i) const;
+
+	[[nodiscard]]
+	Vec2 velocity(size_t i) const;
+
+	[[nodiscard]]
+	bool isFacingRight(size_t i) const;
+
+private:
+
+	Array<double> m_px;
+
+	Array<double> m_py;
+
+	Array<double> m_vx;
+
+	Array<double> m_vy;
+
+	Array<double> m_tx;
+
+	Array<double> m_ty;
+
+	Array<uint8> m_facingRight;
+
+	/// @brief [begin, end) の点を SIMD を使わずに進めます。
+	void updateRange(size_t begin, size_t end, double omega, double exp, double deltaTime);
+
+	void updateFacing(double facingSpeed);
+};
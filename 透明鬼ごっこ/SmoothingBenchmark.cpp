@@ -0,0 +1,179 @@
+﻿# include "SmoothingBenchmark.hpp"
+# include "SmoothingBatch.hpp"
+# include "BenchmarkStats.hpp"
+
+namespace
+{
+	constexpr double SmoothTime = (1.0 / 20.0);
+
+	constexpr double TickTime = (1.0 / 60.0);
+
+	constexpr double FacingSpeed = 10.0;
+
+	/// @brief Math::SmoothDamp との位置のずれの許容値（ピクセル）
+	/// @remark 式は同じだが、演算の順序がわずかに異なるため完全には一致しません。
+	constexpr double ParityTolerance = 1e-6;
+
+	struct Entity
+	{
+		Vec2 pos;
+
+		Vec2 velocity{ 0, 0 };
+
+		Vec2 target;
+
+		bool isFacingRight = true;
+	};
+
+	struct Result
+	{
+		BenchmarkStats reference;
+
+		BenchmarkStats scalar;
+
+		BenchmarkStats simd;
+
+		double maxDeviation = 0.0;
+
+		size_t facingMismatches = 0;
+	};
+
+	/// @brief ゲームと同じく、詰めた配列から集めて進め、書き戻すまでを 1 サンプルとします。
+	template <class Fty>
+	void StepBatch(SmoothingBatch& batch, Array<Entity>& entities, Fty update)
+	{
+		batch.clear();
+
+		for (const auto& entity : entities)
+		{
+			batch.push(entity.pos, entity.velocity, entity.target, entity.isFacingRight);
+		}
+
+		update(batch);
+
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			entities[i].pos = batch.position(i);
+			entities[i].velocity = batch.velocity(i);
+			entities[i].isFacingRight = batch.isFacingRight(i);
+		}
+	}
+
+	[[nodiscard]]
+	Result Run(const int32 count, const int32 ticks)
+	{
+		// 目標が動く間隔（ティック）。ネットワークから位置が届く間隔のつもり
+		constexpr int32 TicksPerTarget = 6;
+
+		Array<Entity> reference(count, Arg::generator = []()
+			{
+				const Vec2 pos = RandomVec2(RectF{ 0, 0, 800, 600 });
+				return Entity{ .pos = pos, .target = pos };
+			});
+		Array<Entity> scalar = reference;
+		Array<Entity> simd = reference;
+
+		SmoothingBatch batch;
+		batch.reserve(count);
+
+		Result result;
+		result.reference.reserve(ticks);
+		result.scalar.reserve(ticks);
+		result.simd.reserve(ticks);
+
+		for (int32 tick = 0; tick < ticks; ++tick)
+		{
+			if ((tick % TicksPerTarget) == 0)
+			{
+				for (int32 i = 0; i < count; ++i)
+				{
+					const Vec2 target = (reference[i].target + RandomVec2(Circle{ 20 }));
+					reference[i].target = scalar[i].target = simd[i].target = target;
+				}
+			}
+
+			{
+				const uint64 begin = Time::GetNanosec();
+
+				for (auto& entity : reference)
+				{
+					entity.pos = Math::SmoothDamp(entity.pos, entity.target, entity.velocity, SmoothTime, unspecified, TickTime);
+
+					if (entity.velocity.x > FacingSpeed)
+					{
+						entity.isFacingRight = true;
+					}
+					else if (entity.velocity.x < -FacingSpeed)
+					{
+						entity.isFacingRight = false;
+					}
+				}
+
+				result.reference.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+			}
+
+			{
+				const uint64 begin = Time::GetNanosec();
+				StepBatch(batch, scalar, [](SmoothingBatch& b) { b.updateScalar(SmoothTime, TickTime, FacingSpeed); });
+				result.scalar.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+			}
+
+			{
+				const uint64 begin = Time::GetNanosec();
+				StepBatch(batch, simd, [](SmoothingBatch& b) { b.update(SmoothTime, TickTime, FacingSpeed); });
+				result.simd.addSample((Time::GetNanosec() - begin) / 1'000'000.0);
+			}
+
+			for (int32 i = 0; i < count; ++i)
+			{
+				result.maxDeviation = Max({ result.maxDeviation, reference[i].pos.distanceFrom(scalar[i].pos), reference[i].pos.distanceFrom(simd[i].pos) });
+
+				// 速さがしきい値ちょうどのときだけ、丸め誤差で向きが分かれうる
+				if ((reference[i].isFacingRight != simd[i].isFacingRight) or (reference[i].isFacingRight != scalar[i].isFacingRight))
+				{
+					++result.facingMismatches;
+				}
+			}
+		}
+
+		return result;
+	}
+}
+
+bool RunSmoothingBenchmark(const Optional<FilePath>& jsonPath)
+{
+	constexpr int32 Ticks = 600;
+
+	BenchmarkRun::Begin();
+
+	JSON summary;
+	summary[U"ticks"] = Ticks;
+	summary[U"parity_tolerance_px"] = ParityTolerance;
+	summary[U"simd_path"] = String{ SmoothingBatch::SimdPath() };
+
+	bool passed = true;
+
+	for (const int32 count : { 16, 256, 4096 })
+	{
+		const Result result = Run(count, Ticks);
+
+		JSON run;
+		run[U"entities"] = count;
+		run[U"reference"] = result.reference.toJSON();
+		run[U"scalar"] = result.scalar.toJSON();
+		run[U"simd"] = result.simd.toJSON();
+		run[U"reference_ns_per_entity"] = ((result.reference.percentile(0.5) * 1'000'000.0) / count);
+		run[U"simd_ns_per_entity"] = ((result.simd.percentile(0.5) * 1'000'000.0) / count);
+		run[U"parity_max_px"] = result.maxDeviation;
+		run[U"facing_mismatches"] = result.facingMismatches;
+		summary[U"runs"].push_back(run);
+
+		passed = (passed and (result.maxDeviation <= ParityTolerance));
+	}
+
+	summary[U"parity_check"] = (passed ? U"passed" : U"failed");
+
+	BenchmarkRun::Finish(summary, jsonPath);
+
+	return passed;
+}
@@ -0,0 +1,7 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief SmoothingBatch の結果が Math::SmoothDamp と一致するかを確かめ、両者の速度を計測して結果をコンソールに出力します。
+/// @param jsonPath 結果の JSON の保存先。none の場合は保存しません
+/// @return 一致の検査に合格した場合 true, それ以外の場合は false
+bool RunSmoothingBenchmark(const Optional<FilePath>& jsonPath);
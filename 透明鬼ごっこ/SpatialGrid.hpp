@@ -0,0 +1,206 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 点の集合を一様グリッドで管理し、円との重なりを近傍のセルだけで調べる空間インデックス
+/// @tparam Key 要素を識別するキーの型
+/// @remark 範囲外の点は端のセルに入るため、範囲外でも正しく検索できます（効率は落ちます）。
+template <class Key>
+class SpatialGrid
+{
+public:
+
+	SIV3D_NODISCARD_CXX20
+	SpatialGrid() = default;
+
+	/// @brief 空間インデックスを作成します。
+	/// @param bounds 対象とする範囲
+	/// @param cellSize セルの一辺の長さ
+	SIV3D_NODISCARD_CXX20
+	SpatialGrid(const RectF& bounds, double cellSize)
+		: m_bounds{ bounds }
+		, m_cellSize{ Max(cellSize, 1.0) }
+		, m_columns{ Max(static_cast<int32>(Math::Ceil(bounds.w / m_cellSize)), 1) }
+		, m_rows{ Max(static_cast<int32>(Math::Ceil(bounds.h / m_cellSize)), 1) }
+		, m_cells(static_cast<size_t>(m_columns) * m_rows) {}
+
+	/// @brief すべての要素を削除します。
+	void clear()
+	{
+		for (auto& cell : m_cells)
+		{
+			cell.clear();
+		}
+
+		m_locations.clear();
+	}
+
+	/// @brief 要素の位置を設定します。要素がなければ追加します。
+	/// @param key 要素のキー
+	/// @param pos 要素の位置
+	void set(const Key& key, const Vec2& pos)
+	{
+		const size_t cellIndex = toCellIndex(pos);
+
+		if (auto it = m_locations.find(key); it != m_locations.end())
+		{
+			if (it->second == cellIndex)
+			{
+				findEntry(cellIndex, key)->pos = pos;
+				return;
+			}
+
+			removeEntry(it->second, key);
+			it->second = cellIndex;
+		}
+		else
+		{
+			m_locations.emplace(key, cellIndex);
+		}
+
+		m_cells[cellIndex].push_back(Entry{ key, pos });
+	}
+
+	/// @brief 要素を削除します。
+	/// @param key 要素のキー
+	void erase(const Key& key)
+	{
+		if (auto it = m_locations.find(key); it != m_locations.end())
+		{
+			removeEntry(it->second, key);
+			m_locations.erase(it);
+		}
+	}
+
+	/// @brief 要素の数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept
+	{
+		return m_locations.size();
+	}
+
+	/// @brief 位置が円の中にあるすべての要素について関数を呼びます。
+	/// @param area 検索する円
+	/// @param f 呼ばれる関数 (キー, 位置)
+	/// @remark 半径 r の要素と重なるものを探すときは、area の半径に r を足してください。
+	template <class Fty>
+	void forEachInCircle(const Circle& area, Fty f) const
+	{
+		if (m_cells.isEmpty())
+		{
+			return;
+		}
+
+		const Point begin = toCell(area.center - Vec2::All(area.r));
+		const Point end = toCell(area.center + Vec2::All(area.r));
+		const double rSq = (area.r * area.r);
+
+		for (int32 y = begin.y; y <= end.y; ++y)
+		{
+			for (int32 x = begin.x; x <= end.x; ++x)
+			{
+				for (const auto& entry : m_cells[static_cast<size_t>(y) * m_columns + x])
+				{
+					if (entry.pos.distanceFromSq(area.center) <= rSq)
+					{
+						f(entry.key, entry.pos);
+					}
+				}
+			}
+		}
+	}
+
+	/// @brief 位置が長方形の中にあるすべての要素について関数を呼びます。
+	/// @param area 検索する長方形
+	/// @param f 呼ばれる関数 (キー, 位置)
+	template <class Fty>
+	void forEachInRect(const RectF& area, Fty f) const
+	{
+		if (m_cells.isEmpty())
+		{
+			return;
+		}
+
+		const Point begin = toCell(area.tl());
+		const Point end = toCell(area.br());
+
+		for (int32 y = begin.y; y <= end.y; ++y)
+		{
+			for (int32 x = begin.x; x <= end.x; ++x)
+			{
+				for (const auto& entry : m_cells[static_cast<size_t>(y) * m_columns + x])
+				{
+					if (area.intersects(entry.pos))
+					{
+						f(entry.key, entry.pos);
+					}
+				}
+			}
+		}
+	}
+
+private:
+
+	struct Entry
+	{
+		Key key;
+
+		Vec2 pos;
+	};
+
+	RectF m_bounds{ 0, 0, 0, 0 };
+
+	double m_cellSize = 1.0;
+
+	int32 m_columns = 0;
+
+	int32 m_rows = 0;
+
+	Array<Array<Entry>> m_cells;
+
+	HashTable<Key, size_t> m_locations;
+
+	[[nodiscard]]
+	Point toCell(const Vec2& pos) const
+	{
+		const int32 x = static_cast<int32>(Math::Floor((pos.x - m_bounds.x) / m_cellSize));
+		const int32 y = static_cast<int32>(Math::Floor((pos.y - m_bounds.y) / m_cellSize));
+		return{ Clamp(x, 0, (m_columns - 1)), Clamp(y, 0, (m_rows - 1)) };
+	}
+
+	[[nodiscard]]
+	size_t toCellIndex(const Vec2& pos) const
+	{
+		const Point cell = toCell(pos);
+		return (static_cast<size_t>(cell.y) * m_columns + cell.x);
+	}
+
+	[[nodiscard]]
+	Entry* findEntry(const size_t cellIndex, const Key& key)
+	{
+		for (auto& entry : m_cells[cellIndex])
+		{
+			if (entry.key == key)
+			{
+				return &entry;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void removeEntry(const size_t cellIndex, const Key& key)
+	{
+		auto& cell = m_cells[cellIndex];
+
+		for (size_t i = 0; i < cell.size(); ++i)
+		{
+			if (cell[i].key == key)
+			{
+				// 順序は保たなくてよいので、末尾と入れ替えて消す
+				cell[i] = std::move(cell.back());
+				cell.pop_back();
+				return;
+			}
+		}
+	}
+};
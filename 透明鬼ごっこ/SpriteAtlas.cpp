@@ -0,0 +1,138 @@
+﻿# include "SpriteAtlas.hpp"
+
+namespace
+{
+	[[nodiscard]]
+	int32 NextPowerOfTwo(const int32 n)
+	{
+		int32 result = 1;
+
+		while (result < n)
+		{
+			result *= 2;
+		}
+
+		return result;
+	}
+}
+
+SpriteAtlas::SpriteAtlas(const Array<Image>& images, int32 padding, int32 extrusion)
+	: m_regions(images.size(), Rect{ 0, 0, 0, 0 })
+{
+	padding = Max(padding, 0);
+	extrusion = Max(extrusion, 0);
+
+	// 1 枚分の枠の大きさ。引き伸ばした縁の外側に隙間を置く
+	const int32 margin = (extrusion + padding);
+	int64 area = 0;
+	int32 maxCellWidth = 0;
+
+	for (const auto& image : images)
+	{
+		const int32 w = (image.width() + margin * 2);
+		area += static_cast<int64>(w) * (image.height() + margin * 2);
+		maxCellWidth = Max(maxCellWidth, w);
+	}
+
+	if (area == 0)
+	{
+		return;
+	}
+
+	// 背の高い順に棚に並べる（shelf packing）
+	Array<size_t> order(images.size());
+	std::iota(order.begin(), order.end(), size_t{ 0 });
+	std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return (images[b].height() < images[a].height()); });
+
+	const int32 width = NextPowerOfTwo(Max(maxCellWidth, static_cast<int32>(Math::Ceil(Math::Sqrt(static_cast<double>(area))))));
+	Array<Point> cells(images.size());
+	Point cursor{ 0, 0 };
+	int32 shelfHeight = 0;
+
+	for (const size_t i : order)
+	{
+		const Size cellSize = (images[i].size() + Size{ margin * 2, margin * 2 });
+
+		if (width < (cursor.x + cellSize.x))
+		{
+			cursor = Point{ 0, (cursor.y + shelfHeight) };
+			shelfHeight = 0;
+		}
+
+		cells[i] = cursor;
+		cursor.x += cellSize.x;
+		shelfHeight = Max(shelfHeight, cellSize.y);
+	}
+
+	Image atlas(width, NextPowerOfTwo(cursor.y + shelfHeight), Color{ 0, 0 });
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		const Image& image = images[i];
+
+		if (not image)
+		{
+			continue;
+		}
+
+		const Point topLeft = (cells[i] + Point{ margin, margin });
+		m_regions[i] = Rect{ topLeft, image.size() };
+
+		// 画像と、その縁を extrusion だけ外へ引き伸ばした帯を書き込む
+		for (int32 y = -extrusion; y < (image.height() + extrusion); ++y)
+		{
+			const int32 sy = Clamp(y, 0, (image.height() - 1));
+
+			for (int32 x = -extrusion; x < (image.width() + extrusion); ++x)
+			{
+				const int32 sx = Clamp(x, 0, (image.width() - 1));
+				atlas[topLeft.y + y][topLeft.x + x] = image[sy][sx];
+			}
+		}
+	}
+
+	m_texture = Texture{ atlas };
+}
+
+SpriteAtlas SpriteAtlas::Load(const Array<FilePath>& paths, const int32 padding, const int32 extrusion)
+{
+	return SpriteAtlas{ LoadImages(paths), padding, extrusion };
+}
+
+Array<Image> SpriteAtlas::LoadImages(const Array<FilePath>& paths)
+{
+	Array<Image> images;
+	images.reserve(paths.size());
+
+	for (const auto& path : paths)
+	{
+		images << Image{ path };
+	}
+
+	return images;
+}
+
+AsyncTask<Array<Image>> SpriteAtlas::LoadImagesAsync(Array<FilePath> paths)
+{
+	return Async([paths = std::move(paths)]() { return LoadImages(paths); });
+}
+
+const Texture& SpriteAtlas::texture() const noexcept
+{
+	return m_texture;
+}
+
+size_t SpriteAtlas::size() const noexcept
+{
+	return m_regions.size();
+}
+
+const Rect& SpriteAtlas::region(const size_t index) const
+{
+	return m_regions[index];
+}
+
+RectF SpriteAtlas::region(const size_t index, const RectF& subRegion) const
+{
+	return subRegion.movedBy(m_regions[index].pos);
+}
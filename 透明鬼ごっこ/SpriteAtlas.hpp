@@ -0,0 +1,85 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 複数の画像を起動時に 1 枚のテクスチャに詰め、画像ごとの範囲の表を持つ
+/// @remark 画像はインデックスで指定します。列挙型を渡すと、その値をインデックスとして使います。
+/// 画像の周りには、縁のピクセルを外側へ引き伸ばした帯（extrusion）と透明な隙間（padding）を置きます。
+/// これにより ClampNearest で描いたドット絵の端に、隣の画像がにじみ出なくなります。
+class SpriteAtlas
+{
+public:
+
+	/// @brief 画像どうしの隙間の既定値（ピクセル）
+	static constexpr int32 DefaultPadding = 1;
+
+	/// @brief 縁を引き伸ばす幅の既定値（ピクセル）
+	static constexpr int32 DefaultExtrusion = 1;
+
+	SIV3D_NODISCARD_CXX20
+	SpriteAtlas() = default;
+
+	/// @brief 画像を 1 枚に詰め、テクスチャを作ります。
+	/// @param images 画像の一覧。インデックスが region() の引数になります
+	/// @param padding 画像どうしの隙間（ピクセル）
+	/// @param extrusion 縁を引き伸ばす幅（ピクセル）
+	SIV3D_NODISCARD_CXX20
+	explicit SpriteAtlas(const Array<Image>& images, int32 padding = DefaultPadding, int32 extrusion = DefaultExtrusion);
+
+	/// @brief 画像ファイルを読み込んで 1 枚に詰めます。
+	/// @param paths 画像ファイルのパスの一覧。読み込めなかった画像は空の範囲になります
+	/// @param padding 画像どうしの隙間（ピクセル）
+	/// @param extrusion 縁を引き伸ばす幅（ピクセル）
+	[[nodiscard]]
+	static SpriteAtlas Load(const Array<FilePath>& paths, int32 padding = DefaultPadding, int32 extrusion = DefaultExtrusion);
+
+	/// @brief 画像ファイルを読み込みます。
+	/// @param paths 画像ファイルのパスの一覧。読み込めなかった画像は空の画像になります
+	[[nodiscard]]
+	static Array<Image> LoadImages(const Array<FilePath>& paths);
+
+	/// @brief 画像ファイルをワーカースレッドで読み込みます。
+	/// @remark テクスチャはメインスレッドで、結果の画像からコンストラクタで作ってください。
+	/// @param paths 画像ファイルのパスの一覧
+	[[nodiscard]]
+	static AsyncTask<Array<Image>> LoadImagesAsync(Array<FilePath> paths);
+
+	/// @brief すべての画像を詰めたテクスチャを返します。
+	[[nodiscard]]
+	const Texture& texture() const noexcept;
+
+	/// @brief 画像の数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief 画像がテクスチャの中で占める範囲を返します。
+	/// @param index 画像のインデックス
+	[[nodiscard]]
+	const Rect& region(size_t index) const;
+
+	/// @brief 画像の一部がテクスチャの中で占める範囲を返します。
+	/// @param index 画像のインデックス
+	/// @param subRegion 元の画像の中での範囲（ピクセル）
+	[[nodiscard]]
+	RectF region(size_t index, const RectF& subRegion) const;
+
+	template <class Enum> requires std::is_enum_v<Enum>
+	[[nodiscard]]
+	const Rect& region(Enum name) const
+	{
+		return region(static_cast<size_t>(name));
+	}
+
+	template <class Enum> requires std::is_enum_v<Enum>
+	[[nodiscard]]
+	RectF region(Enum name, const RectF& subRegion) const
+	{
+		return region(static_cast<size_t>(name), subRegion);
+	}
+
+private:
+
+	Texture m_texture;
+
+	/// @brief 画像ごとの、テクスチャの中での範囲
+	Array<Rect> m_regions;
+};
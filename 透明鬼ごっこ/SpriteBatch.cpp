@@ -0,0 +1,124 @@
+﻿# include "SpriteBatch.hpp"
+
+namespace
+{
+	/// @brief 1 つのバッファに入れるスプライトの最大数。インデックスが 16 ビットに収まるようにする
+	constexpr size_t MaxSpritesPerBuffer = (65536 / 4);
+}
+
+void SpriteBatch::add(const Texture& texture, const RectF& region, const Vec2& center, const double scale, const ColorF& color, const bool mirrored)
+{
+	if (not texture)
+	{
+		return;
+	}
+
+	Buffer2D& buffer = bufferFor(texture);
+
+	const Size textureSize = texture.size();
+	float u0 = static_cast<float>(region.x / textureSize.x);
+	float u1 = static_cast<float>(region.rightX() / textureSize.x);
+	const float v0 = static_cast<float>(region.y / textureSize.y);
+	const float v1 = static_cast<float>(region.bottomY() / textureSize.y);
+
+	if (mirrored)
+	{
+		std::swap(u0, u1);
+	}
+
+	const RectF rect = RectF{ Arg::center = center, (region.size * scale) };
+	const Float2 tl{ static_cast<float>(rect.x), static_cast<float>(rect.y) };
+	const Float2 br{ static_cast<float>(rect.rightX()), static_cast<float>(rect.bottomY()) };
+	const Float4 c = color.toFloat4();
+
+	const Vertex2D::IndexType base = static_cast<Vertex2D::IndexType>(buffer.vertices.size());
+	buffer.vertices << Vertex2D{ tl, Float2{ u0, v0 }, c };
+	buffer.vertices << Vertex2D{ Float2{ br.x, tl.y }, Float2{ u1, v0 }, c };
+	buffer.vertices << Vertex2D{ br, Float2{ u1, v1 }, c };
+	buffer.vertices << Vertex2D{ Float2{ tl.x, br.y }, Float2{ u0, v1 }, c };
+	buffer.indices << TriangleIndex{ base, static_cast<Vertex2D::IndexType>(base + 1), static_cast<Vertex2D::IndexType>(base + 2) };
+	buffer.indices << TriangleIndex{ base, static_cast<Vertex2D::IndexType>(base + 2), static_cast<Vertex2D::IndexType>(base + 3) };
+
+	++m_size;
+}
+
+void SpriteBatch::add(const Texture& texture, const Vec2& center, const double scale, const ColorF& color)
+{
+	add(texture, RectF{ 0, 0, texture.size() }, center, scale, color);
+}
+
+void SpriteBatch::draw() const
+{
+	if (m_size == 0)
+	{
+		return;
+	}
+
+	for (const auto& group : m_groups)
+	{
+		for (size_t i = 0; i < group.used; ++i)
+		{
+			group.buffers[i].draw(group.texture);
+		}
+	}
+}
+
+void SpriteBatch::clear()
+{
+	for (auto& group : m_groups)
+	{
+		for (size_t i = 0; i < group.used; ++i)
+		{
+			group.buffers[i].vertices.clear();
+			group.buffers[i].indices.clear();
+		}
+
+		group.used = 0;
+	}
+
+	m_size = 0;
+}
+
+size_t SpriteBatch::size() const noexcept
+{
+	return m_size;
+}
+
+size_t SpriteBatch::batchCount() const noexcept
+{
+	size_t count = 0;
+
+	for (const auto& group : m_groups)
+	{
+		count += group.used;
+	}
+
+	return count;
+}
+
+Buffer2D& SpriteBatch::bufferFor(const Texture& texture)
+{
+	// テクスチャは数枚しかないので線形探索で十分
+	auto it = std::find_if(m_groups.begin(), m_groups.end(), [&](const Group& group) { return (group.texture.id() == texture.id()); });
+
+	if (it == m_groups.end())
+	{
+		m_groups << Group{ .texture = texture };
+		it = std::prev(m_groups.end());
+	}
+
+	Group& group = *it;
+
+	// 使い始めのグループ、または最後のバッファが満杯なら次のバッファへ
+	if ((group.used == 0) or (MaxSpritesPerBuffer * 4 <= group.buffers[group.used - 1].vertices.size()))
+	{
+		if (group.buffers.size() <= group.used)
+		{
+			group.buffers.emplace_back();
+		}
+
+		++group.used;
+	}
+
+	return group.buffers[group.used - 1];
+}
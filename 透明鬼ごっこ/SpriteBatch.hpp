@@ -0,0 +1,64 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief スプライトの四角形をテクスチャごとに 1 つの頂点バッファにまとめ、テクスチャ 1 枚につき 1 回で描画する
+/// @remark 同じテクスチャのスプライトは追加した順に重なります。
+/// テクスチャが違うスプライトどうしは、テクスチャを初めて使った順に重なります。
+class SpriteBatch
+{
+public:
+
+	SIV3D_NODISCARD_CXX20
+	SpriteBatch() = default;
+
+	/// @brief スプライトを 1 つ追加します。
+	/// @param texture テクスチャ
+	/// @param region テクスチャの中で使う範囲（ピクセル）
+	/// @param center 描画する中心の位置
+	/// @param scale 拡大率
+	/// @param color 乗算する色。アルファで不透明度を指定します
+	/// @param mirrored 左右反転するか
+	void add(const Texture& texture, const RectF& region, const Vec2& center, double scale, const ColorF& color = ColorF{ 1.0 }, bool mirrored = false);
+
+	/// @brief テクスチャ全体を 1 つのスプライトとして追加します。
+	/// @param texture テクスチャ
+	/// @param center 描画する中心の位置
+	/// @param scale 拡大率
+	/// @param color 乗算する色
+	void add(const Texture& texture, const Vec2& center, double scale, const ColorF& color = ColorF{ 1.0 });
+
+	/// @brief 追加したスプライトをすべて描画します。
+	/// @remark サンプラーステートなどは呼び出し側（RenderQueue）で設定してください。
+	void draw() const;
+
+	/// @brief 追加したスプライトをすべて消します。確保したメモリは次のフレームのために残します。
+	void clear();
+
+	/// @brief 追加したスプライトの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief 描画に使う頂点バッファの数（描画の呼び出し回数）を返します。
+	[[nodiscard]]
+	size_t batchCount() const noexcept;
+
+private:
+
+	struct Group
+	{
+		Texture texture;
+
+		/// @brief 1 つのバッファの頂点数には上限があるため、複数に分けることがある
+		Array<Buffer2D> buffers;
+
+		/// @brief 使用中のバッファの数。残りは空のまま再利用を待つ
+		size_t used = 0;
+	};
+
+	Array<Group> m_groups;
+
+	size_t m_size = 0;
+
+	[[nodiscard]]
+	Buffer2D& bufferFor(const Texture& texture);
+};
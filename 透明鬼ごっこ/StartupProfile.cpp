@@ -0,0 +1,44 @@
+﻿# include "StartupProfile.hpp"
+
+StartupProfile::StartupProfile()
+	: m_stopwatch{ StartImmediately::Yes } {}
+
+void StartupProfile::mark(const StringView stage)
+{
+	if (contains(stage))
+	{
+		return;
+	}
+
+	m_marks << Mark{ String{ stage }, m_stopwatch.msF() };
+}
+
+bool StartupProfile::contains(const StringView stage) const
+{
+	return m_marks.any([&](const Mark& mark) { return (mark.stage == stage); });
+}
+
+Optional<double> StartupProfile::millisec(const StringView stage) const
+{
+	for (const auto& mark : m_marks)
+	{
+		if (mark.stage == stage)
+		{
+			return mark.millisec;
+		}
+	}
+
+	return none;
+}
+
+JSON StartupProfile::toJSON() const
+{
+	JSON json;
+
+	for (const auto& mark : m_marks)
+	{
+		json[mark.stage] = mark.millisec;
+	}
+
+	return json;
+}
@@ -0,0 +1,46 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief 起動してからの各段階（最初のフレーム、ロビーに入った、アセットの準備ができた など）に到達した時刻を記録する
+/// @remark 時刻は Main() に入ってからの経過時間です。同じ段階を何度記録しても、最初の時刻だけが残ります。
+class StartupProfile
+{
+public:
+
+	/// @brief 計測を始めます。
+	SIV3D_NODISCARD_CXX20
+	StartupProfile();
+
+	/// @brief 段階に到達したことを記録します。すでに記録されていれば何もしません。
+	/// @param stage 段階の名前
+	void mark(StringView stage);
+
+	/// @brief 段階が記録されているかを返します。
+	/// @param stage 段階の名前
+	[[nodiscard]]
+	bool contains(StringView stage) const;
+
+	/// @brief 段階に到達した時刻（ミリ秒）を返します。
+	/// @param stage 段階の名前
+	/// @return 記録されていなければ none
+	[[nodiscard]]
+	Optional<double> millisec(StringView stage) const;
+
+	/// @brief 記録した段階を、到達した順に JSON で返します。
+	[[nodiscard]]
+	JSON toJSON() const;
+
+private:
+
+	struct Mark
+	{
+		String stage;
+
+		double millisec = 0.0;
+	};
+
+	Stopwatch m_stopwatch;
+
+	/// @brief 到達した順の記録。段階は十数個なので線形探索する
+	Array<Mark> m_marks;
+};
@@ -0,0 +1,42 @@
+﻿# include "SweptContact.hpp"
+
+namespace SweptContact
+{
+	Optional<double> TimeOfContact(const Vec2& a0, const Vec2& a1, const Vec2& b0, const Vec2& b1, const double radiusSum)
+	{
+		// B から見た A の相対位置 p(t) = p + t * v について |p(t)| = radiusSum となる最小の t を求める
+		const Vec2 p = (a0 - b0);
+		const Vec2 v = ((a1 - a0) - (b1 - b0));
+		const double c = (p.lengthSq() - radiusSum * radiusSum);
+
+		if (c <= 0.0)
+		{
+			return 0.0;
+		}
+
+		const double a = v.lengthSq();
+		const double b = p.dot(v);
+
+		// 近づいていないか、相対的に止まっている
+		if ((0.0 <= b) or (a == 0.0))
+		{
+			return none;
+		}
+
+		const double discriminant = (b * b - a * c);
+
+		if (discriminant < 0.0)
+		{
+			return none;
+		}
+
+		const double t = ((-b - Math::Sqrt(discriminant)) / a);
+
+		if (1.0 < t)
+		{
+			return none;
+		}
+
+		return t;
+	}
+}
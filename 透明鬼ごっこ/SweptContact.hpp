@@ -0,0 +1,17 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief フレームの間に直線的に動く 2 つの円が初めて接する時刻を求めます。
+namespace SweptContact
+{
+	/// @brief 2 つの円がフレームの間に初めて接する時刻を返します。
+	/// @param a0 円 A のフレーム開始時の中心
+	/// @param a1 円 A のフレーム終了時の中心
+	/// @param b0 円 B のフレーム開始時の中心
+	/// @param b1 円 B のフレーム終了時の中心
+	/// @param radiusSum 2 つの円の半径の和
+	/// @return 0.0 以上 1.0 以下の時刻。フレームの間に接しない場合は none, 開始時にすでに重なっている場合は 0.0
+	/// @remark 止まっている点（トラップ）との判定には b0 と b1 に同じ位置を渡します。
+	[[nodiscard]]
+	Optional<double> TimeOfContact(const Vec2& a0, const Vec2& a1, const Vec2& b0, const Vec2& b1, double radiusSum);
+}
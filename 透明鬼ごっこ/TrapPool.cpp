@@ -0,0 +1,157 @@
+﻿# include "TrapPool.hpp"
+
+void TrapPool::clear()
+{
+	while (m_denseSlots)
+	{
+		removeAt(m_denseSlots.size() - 1);
+	}
+}
+
+TrapHandle TrapPool::allocate(const Vec2& pos, const int32 ownerID, const Color& color)
+{
+	if (not m_freeSlots)
+	{
+		collectFreeSlots();
+	}
+
+	while (m_freeSlots)
+	{
+		const uint32 slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+
+		if ((slot < m_slotToDense.size()) and (m_slotToDense[slot] == Vacant))
+		{
+			push(slot, pos, ownerID, color);
+			return{ slot, m_generations[slot] };
+		}
+	}
+
+	const uint32 slot = static_cast<uint32>(m_generations.size());
+	m_generations << 0;
+	m_slotToDense << Vacant;
+	push(slot, pos, ownerID, color);
+	return{ slot, 0 };
+}
+
+bool TrapPool::insert(const TrapHandle& handle, const Vec2& pos, const int32 ownerID, const Color& color)
+{
+	if (m_generations.size() <= handle.index)
+	{
+		m_generations.resize(handle.index + 1, 0);
+		m_slotToDense.resize(handle.index + 1, Vacant);
+	}
+
+	// 世代が古いハンドルは、すでに消されたトラップを指している
+	if (handle.generation < m_generations[handle.index])
+	{
+		return false;
+	}
+
+	if (m_slotToDense[handle.index] != Vacant)
+	{
+		removeAt(m_slotToDense[handle.index]);
+	}
+
+	m_generations[handle.index] = handle.generation;
+	push(handle.index, pos, ownerID, color);
+	return true;
+}
+
+bool TrapPool::erase(const TrapHandle& handle)
+{
+	if (not contains(handle))
+	{
+		return false;
+	}
+
+	removeAt(m_slotToDense[handle.index]);
+	return true;
+}
+
+bool TrapPool::contains(const TrapHandle& handle) const noexcept
+{
+	return ((handle.index < m_generations.size())
+		and (m_generations[handle.index] == handle.generation)
+		and (m_slotToDense[handle.index] != Vacant));
+}
+
+size_t TrapPool::size() const noexcept
+{
+	return m_denseSlots.size();
+}
+
+Trap TrapPool::get(const TrapHandle& handle) const
+{
+	assert(contains(handle));
+	return at(m_slotToDense[handle.index]);
+}
+
+Trap TrapPool::at(const size_t i) const
+{
+	return{ m_positions[i], m_owners[i], m_colors[i] };
+}
+
+TrapHandle TrapPool::handleAt(const size_t i) const
+{
+	const uint32 slot = m_denseSlots[i];
+	return{ slot, m_generations[slot] };
+}
+
+TrapHandle TrapPool::handleOfSlot(const uint32 slot) const
+{
+	assert(m_slotToDense[slot] != Vacant);
+	return{ slot, m_generations[slot] };
+}
+
+const Array<Vec2>& TrapPool::positions() const noexcept
+{
+	return m_positions;
+}
+
+void TrapPool::collectFreeSlots()
+{
+	m_freeSlots.clear();
+
+	// 小さい番号から使われるように、後ろから積む
+	for (size_t slot = m_slotToDense.size(); slot-- > 0;)
+	{
+		if (m_slotToDense[slot] == Vacant)
+		{
+			m_freeSlots << static_cast<uint32>(slot);
+		}
+	}
+}
+
+void TrapPool::push(const uint32 slot, const Vec2& pos, const int32 ownerID, const Color& color)
+{
+	m_slotToDense[slot] = static_cast<uint32>(m_denseSlots.size());
+	m_positions << pos;
+	m_colors << color;
+	m_owners << ownerID;
+	m_denseSlots << slot;
+}
+
+void TrapPool::removeAt(const size_t i)
+{
+	const size_t last = (m_denseSlots.size() - 1);
+	const uint32 slot = m_denseSlots[i];
+
+	if (i != last)
+	{
+		m_positions[i] = m_positions[last];
+		m_colors[i] = m_colors[last];
+		m_owners[i] = m_owners[last];
+		m_denseSlots[i] = m_denseSlots[last];
+		m_slotToDense[m_denseSlots[i]] = static_cast<uint32>(i);
+	}
+
+	m_positions.pop_back();
+	m_colors.pop_back();
+	m_owners.pop_back();
+	m_denseSlots.pop_back();
+
+	// 次にこのスロットを使うトラップは別の世代になる。空きスロットの一覧には allocate() が集めるときに入る
+	m_slotToDense[slot] = Vacant;
+	++m_generations[slot];
+}
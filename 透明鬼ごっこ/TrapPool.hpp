@@ -0,0 +1,153 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief トラップを指すハンドル
+/// @remark スロットが再利用されると世代が変わるため、消されたトラップのハンドルは無効になります。
+struct TrapHandle
+{
+	/// @brief スロットの番号
+	uint32 index = 0;
+
+	/// @brief スロットの世代
+	uint32 generation = 0;
+
+	[[nodiscard]]
+	friend constexpr bool operator ==(const TrapHandle& lhs, const TrapHandle& rhs) noexcept = default;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(index, generation);
+	}
+};
+
+/// @brief トラップ 1 個の値
+struct Trap
+{
+	Vec2 pos;
+
+	/// @brief 置いたプレイヤーの ID（Multiplayer_Photon の LocalPlayerID）
+	int32 ownerID = 0;
+
+	Color color = Palette::White;
+};
+
+/// @brief トラップを SoA で詰めて保持し、世代付きのハンドルで指すプール
+/// @remark ハンドルはホストが allocate() で割り当て、ほかのクライアントは insert() で同じハンドルのまま複製します。
+/// 削除は末尾との入れ替えで O(1) 、走査は詰めた配列を先頭から読むだけで済みます。
+class TrapPool
+{
+public:
+
+	/// @brief すべてのトラップを削除します。削除したトラップのハンドルは無効になります。
+	void clear();
+
+	/// @brief 新しいハンドルを割り当ててトラップを追加します。
+	/// @param pos 位置
+	/// @param ownerID 置いたプレイヤーの ID
+	/// @param color 色
+	/// @return 割り当てたハンドル
+	TrapHandle allocate(const Vec2& pos, int32 ownerID, const Color& color);
+
+	/// @brief ほかのクライアントが割り当てたハンドルでトラップを追加します。
+	/// @param handle ハンドル
+	/// @param pos 位置
+	/// @param ownerID 置いたプレイヤーの ID
+	/// @param color 色
+	/// @return 追加した場合 true, そのスロットにもっと新しい世代がある場合は false
+	bool insert(const TrapHandle& handle, const Vec2& pos, int32 ownerID, const Color& color);
+
+	/// @brief トラップを削除します。
+	/// @param handle ハンドル
+	/// @return 削除した場合 true, ハンドルが無効な場合は false
+	bool erase(const TrapHandle& handle);
+
+	/// @brief あるプレイヤーが置いたトラップをすべて削除します。
+	/// @param ownerID 置いたプレイヤーの ID
+	/// @param onErase 削除する直前に呼ばれる関数 (ハンドル)
+	template <class Fty>
+	void eraseOwner(int32 ownerID, Fty onErase);
+
+	/// @brief ハンドルが有効かを返します。
+	[[nodiscard]]
+	bool contains(const TrapHandle& handle) const noexcept;
+
+	/// @brief トラップの数を返します。
+	[[nodiscard]]
+	size_t size() const noexcept;
+
+	/// @brief トラップを返します。
+	/// @param handle 有効なハンドル
+	[[nodiscard]]
+	Trap get(const TrapHandle& handle) const;
+
+	/// @brief 詰めた配列の i 番目のトラップを返します。
+	[[nodiscard]]
+	Trap at(size_t i) const;
+
+	/// @brief 詰めた配列の i 番目のトラップのハンドルを返します。
+	[[nodiscard]]
+	TrapHandle handleAt(size_t i) const;
+
+	/// @brief スロットにいま入っているトラップのハンドルを返します。
+	/// @param slot 有効なトラップが入っているスロットの番号
+	[[nodiscard]]
+	TrapHandle handleOfSlot(uint32 slot) const;
+
+	/// @brief 詰めた配列のトラップの位置を返します。インデックスは at() と対応します
+	[[nodiscard]]
+	const Array<Vec2>& positions() const noexcept;
+
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		// 空きスロットの一覧は m_slotToDense から作り直せるため送らない
+		archive(m_positions, m_colors, m_owners, m_denseSlots, m_generations, m_slotToDense);
+	}
+
+private:
+
+	/// @brief 空きスロットを表す m_slotToDense の値
+	static constexpr uint32 Vacant = Largest<uint32>;
+
+	// 詰めた配列。i 番目のトラップはスロット m_denseSlots[i] に入っている
+	Array<Vec2> m_positions;
+
+	Array<Color> m_colors;
+
+	Array<int32> m_owners;
+
+	Array<uint32> m_denseSlots;
+
+	// スロットごとの配列
+	Array<uint32> m_generations;
+
+	Array<uint32> m_slotToDense;
+
+	/// @brief 再利用できるスロット。allocate() で空になったときに m_slotToDense から作り直す
+	/// @remark insert() で埋まったスロットが残っていることがあるため、使う前に空きかを確かめる。
+	/// allocate() を呼ばないクライアントでは空のままで、ホストを引き継いだ後や読み込み後も最初の allocate() で揃う。
+	Array<uint32> m_freeSlots;
+
+	/// @brief 空いているスロットを m_freeSlots に集めます。
+	void collectFreeSlots();
+
+	void push(uint32 slot, const Vec2& pos, int32 ownerID, const Color& color);
+
+	/// @brief 詰めた配列の i 番目を末尾と入れ替えて削除し、スロットを空けます。
+	void removeAt(size_t i);
+};
+
+template <class Fty>
+void TrapPool::eraseOwner(const int32 ownerID, Fty onErase)
+{
+	// 末尾と入れ替えて消すので、後ろから走査する
+	for (size_t i = m_owners.size(); i-- > 0;)
+	{
+		if (m_owners[i] == ownerID)
+		{
+			onErase(handleAt(i));
+			removeAt(i);
+		}
+	}
+}
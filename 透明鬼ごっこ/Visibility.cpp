@@ -0,0 +1,334 @@
+﻿# include "Visibility.hpp"
+
+namespace
+{
+	/// @brief 辺の端点のわずかに左右にも光線を飛ばし、端点の奥の壁まで届かせる
+	constexpr double AngleEpsilon = 1e-4;
+
+	[[nodiscard]]
+	constexpr double Cross(const Vec2& a, const Vec2& b) noexcept
+	{
+		return (a.x * b.y - a.y * b.x);
+	}
+
+	/// @brief 点 p が三角形 (origin, a, b) の origin と同じ側（辺 ab の内側）にあるか
+	[[nodiscard]]
+	bool IsInsideEdge(const Vec2& origin, const Vec2& a, const Vec2& b, const Vec2& p)
+	{
+		const Vec2 edge = (b - a);
+		const double side = Cross(edge, (origin - a));
+		const double pointSide = Cross(edge, (p - a));
+		return ((side * pointSide) >= 0.0);
+	}
+}
+
+const Vec2& VisibilityPolygon::origin() const noexcept
+{
+	return m_origin;
+}
+
+double VisibilityPolygon::range() const noexcept
+{
+	return m_range;
+}
+
+const Array<Vec2>& VisibilityPolygon::vertices() const noexcept
+{
+	return m_vertices;
+}
+
+bool VisibilityPolygon::contains(const Vec2& point) const
+{
+	if (m_vertices.size() < 2)
+	{
+		return false;
+	}
+
+	const Vec2 d = (point - m_origin);
+
+	if ((m_range < Abs(d.x)) or (m_range < Abs(d.y)))
+	{
+		return false;
+	}
+
+	if (d.isZero())
+	{
+		return true;
+	}
+
+	// point を含む扇形 [i - 1, i] を探す。角度は -π から π の昇順
+	const double angle = Math::Atan2(d.y, d.x);
+	const size_t i = static_cast<size_t>(std::upper_bound(m_angles.begin(), m_angles.end(), angle) - m_angles.begin());
+	const size_t next = ((i == m_vertices.size()) ? 0 : i);
+	const size_t prev = ((i == 0) ? (m_vertices.size() - 1) : (i - 1));
+
+	return IsInsideEdge(m_origin, m_vertices[prev], m_vertices[next], point);
+}
+
+bool VisibilityPolygon::intersects(const Circle& circle) const
+{
+	return (contains(circle.center)
+		or contains(circle.center + Vec2{ circle.r, 0 })
+		or contains(circle.center - Vec2{ circle.r, 0 })
+		or contains(circle.center + Vec2{ 0, circle.r })
+		or contains(circle.center - Vec2{ 0, circle.r }));
+}
+
+VisibilityMap::VisibilityMap(const Array<Polygon>& walls, const RectF& bounds, const double cellSize)
+	: m_bounds{ bounds }
+	, m_cellSize{ Max(cellSize, 1.0) }
+	, m_columns{ Max(static_cast<int32>(Math::Ceil(bounds.w / m_cellSize)), 1) }
+	, m_rows{ Max(static_cast<int32>(Math::Ceil(bounds.h / m_cellSize)), 1) }
+	, m_cells(static_cast<size_t>(m_columns) * m_rows)
+{
+	for (const auto& wall : walls)
+	{
+		const Array<Vec2>& outer = wall.outer();
+
+		for (size_t i = 0; i < outer.size(); ++i)
+		{
+			const Segment segment{ outer[i], outer[(i + 1) % outer.size()] };
+			const uint32 index = static_cast<uint32>(m_segments.size());
+			m_segments << segment;
+
+			const Point begin = toCell(Vec2{ Min(segment.a.x, segment.b.x), Min(segment.a.y, segment.b.y) });
+			const Point end = toCell(Vec2{ Max(segment.a.x, segment.b.x), Max(segment.a.y, segment.b.y) });
+
+			for (int32 y = begin.y; y <= end.y; ++y)
+			{
+				for (int32 x = begin.x; x <= end.x; ++x)
+				{
+					m_cells[static_cast<size_t>(y) * m_columns + x] << index;
+				}
+			}
+		}
+	}
+
+	m_visitedStamp.resize(m_segments.size(), 0);
+}
+
+const VisibilityPolygon& VisibilityMap::compute(const Vec2& viewer, const double range)
+{
+	const int32 qx = static_cast<int32>(Math::Floor(viewer.x / CacheStep));
+	const int32 qy = static_cast<int32>(Math::Floor(viewer.y / CacheStep));
+	const uint64 key = ((static_cast<uint64>(static_cast<uint32>(qx)) << 32) | static_cast<uint32>(qy));
+
+	if (auto it = m_cache.find(key); (it != m_cache.end()) and (it->second.m_range == range))
+	{
+		return it->second;
+	}
+
+	if (MaxCachedResults <= m_cache.size())
+	{
+		m_cache.clear();
+	}
+
+	VisibilityPolygon& result = m_cache[key];
+	build(Vec2{ (qx + 0.5) * CacheStep, (qy + 0.5) * CacheStep }, range, result);
+	return result;
+}
+
+bool VisibilityMap::update(const Vec2& viewer, const double range, const double step, VisibilityPolygon& result)
+{
+	const Vec2 center{ ((Math::Floor(viewer.x / step) + 0.5) * step), ((Math::Floor(viewer.y / step) + 0.5) * step) };
+
+	if ((result.m_range == range) and (result.m_origin == center))
+	{
+		return false;
+	}
+
+	build(center, range, result);
+	return true;
+}
+
+size_t VisibilityMap::cachedCount() const noexcept
+{
+	return m_cache.size();
+}
+
+Point VisibilityMap::toCell(const Vec2& pos) const
+{
+	const int32 x = static_cast<int32>(Math::Floor((pos.x - m_bounds.x) / m_cellSize));
+	const int32 y = static_cast<int32>(Math::Floor((pos.y - m_bounds.y) / m_cellSize));
+	return{ Clamp(x, 0, (m_columns - 1)), Clamp(y, 0, (m_rows - 1)) };
+}
+
+void VisibilityMap::gatherCandidates(const RectF& area)
+{
+	m_candidates.clear();
+
+	if (m_cells.isEmpty())
+	{
+		return;
+	}
+
+	// 複数のセルにまたがる辺を一度だけ拾うため、呼び出しごとに印を変える
+	if (++m_stamp == 0)
+	{
+		m_visitedStamp.fill(0);
+		m_stamp = 1;
+	}
+
+	const Point begin = toCell(area.tl());
+	const Point end = toCell(area.br());
+
+	for (int32 y = begin.y; y <= end.y; ++y)
+	{
+		for (int32 x = begin.x; x <= end.x; ++x)
+		{
+			for (const uint32 index : m_cells[static_cast<size_t>(y) * m_columns + x])
+			{
+				if (m_visitedStamp[index] != m_stamp)
+				{
+					m_visitedStamp[index] = m_stamp;
+					m_candidates << m_segments[index];
+				}
+			}
+		}
+	}
+}
+
+void VisibilityMap::build(const Vec2& viewer, const double range, VisibilityPolygon& result)
+{
+	const RectF area{ Arg::center(viewer), (range * 2) };
+	gatherCandidates(area);
+
+	// 範囲の外周も辺として扱い、光線が必ずどこかに当たるようにする
+	const Vec2 corners[4] = { area.tl(), area.tr(), area.br(), area.bl() };
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		m_candidates << Segment{ corners[i], corners[(i + 1) % 4] };
+	}
+
+	// 角度の順に掃引する光線の向き。範囲内の端点とその左右
+	m_rayAngles.clear();
+
+	for (const auto& segment : m_candidates)
+	{
+		for (const Vec2& endpoint : { segment.a, segment.b })
+		{
+			if (not area.intersects(endpoint))
+			{
+				continue;
+			}
+
+			const Vec2 d = (endpoint - viewer);
+			const double angle = Math::Atan2(d.y, d.x);
+			m_rayAngles << (angle - AngleEpsilon) << angle << (angle + AngleEpsilon);
+		}
+	}
+
+	for (double& angle : m_rayAngles)
+	{
+		if (angle <= -Math::Pi)
+		{
+			angle += Math::TwoPi;
+		}
+		else if (Math::Pi < angle)
+		{
+			angle -= Math::TwoPi;
+		}
+	}
+
+	std::sort(m_rayAngles.begin(), m_rayAngles.end());
+
+	m_rayDirections.clear();
+
+	for (const double angle : m_rayAngles)
+	{
+		m_rayDirections.emplace_back(Math::Cos(angle), Math::Sin(angle));
+	}
+
+	m_rayHits.assign(m_rayAngles.size(), Largest<double>);
+
+	// 光線ごとにすべての辺を調べる代わりに、辺ごとに視点から見た角度の範囲にある光線だけを調べる
+	const auto rayAt = [&](const double angle) { return static_cast<size_t>(std::lower_bound(m_rayAngles.begin(), m_rayAngles.end(), angle) - m_rayAngles.begin()); };
+
+	for (const auto& segment : m_candidates)
+	{
+		const Vec2 da = (segment.a - viewer);
+		const Vec2 db = (segment.b - viewer);
+		const double angleA = Math::Atan2(da.y, da.x);
+		double span = (Math::Atan2(db.y, db.x) - angleA);
+
+		if (span <= -Math::Pi)
+		{
+			span += Math::TwoPi;
+		}
+		else if (Math::Pi < span)
+		{
+			span -= Math::TwoPi;
+		}
+
+		// 視点が辺の延長線上にあると範囲が決まらないので、すべての光線を調べる
+		if ((Math::Pi - 1e-9) <= Abs(span))
+		{
+			castRays(viewer, segment, 0, m_rayAngles.size());
+			continue;
+		}
+
+		// 端点の左右に飛ばした光線も含めるため、範囲を少し広げる
+		const double lower = (Min(angleA, (angleA + span)) - (AngleEpsilon * 2));
+		const double upper = (Max(angleA, (angleA + span)) + (AngleEpsilon * 2));
+
+		// -π と π の境目をまたぐ範囲は 2 つに分ける
+		if (lower < -Math::Pi)
+		{
+			castRays(viewer, segment, 0, rayAt(upper));
+			castRays(viewer, segment, rayAt(lower + Math::TwoPi), m_rayAngles.size());
+		}
+		else if (Math::Pi < upper)
+		{
+			castRays(viewer, segment, rayAt(lower), m_rayAngles.size());
+			castRays(viewer, segment, 0, rayAt(upper - Math::TwoPi));
+		}
+		else
+		{
+			castRays(viewer, segment, rayAt(lower), rayAt(upper));
+		}
+	}
+
+	result.m_origin = viewer;
+	result.m_range = range;
+	result.m_vertices.clear();
+	result.m_angles.clear();
+	result.m_vertices.reserve(m_rayAngles.size());
+	result.m_angles.reserve(m_rayAngles.size());
+
+	for (size_t i = 0; i < m_rayAngles.size(); ++i)
+	{
+		if (m_rayHits[i] == Largest<double>)
+		{
+			continue;
+		}
+
+		result.m_vertices << (viewer + m_rayDirections[i] * m_rayHits[i]);
+		result.m_angles << m_rayAngles[i];
+	}
+}
+
+void VisibilityMap::castRays(const Vec2& viewer, const Segment& segment, const size_t first, const size_t last)
+{
+	const Vec2 edge = (segment.b - segment.a);
+	const Vec2 toStart = (segment.a - viewer);
+
+	for (size_t i = first; i < last; ++i)
+	{
+		const Vec2& direction = m_rayDirections[i];
+		const double denominator = Cross(direction, edge);
+
+		if (Abs(denominator) < 1e-12)
+		{
+			continue;
+		}
+
+		const double t = (Cross(toStart, edge) / denominator);
+		const double u = (Cross(toStart, direction) / denominator);
+
+		if ((0.0 <= t) and (t < m_rayHits[i]) and InRange(u, 0.0, 1.0))
+		{
+			m_rayHits[i] = t;
+		}
+	}
+}
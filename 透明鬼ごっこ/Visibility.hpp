@@ -0,0 +1,139 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief ある視点から見える範囲を、視点のまわりの扇形の列で表した多角形
+/// @remark 頂点は視点から見た角度の順に並んでいるため、点が含まれるかを二分探索で調べられます。
+class VisibilityPolygon
+{
+public:
+
+	/// @brief 視点を返します。
+	[[nodiscard]]
+	const Vec2& origin() const noexcept;
+
+	/// @brief 計算に使った範囲（視点を中心とする正方形の一辺の半分）を返します。
+	[[nodiscard]]
+	double range() const noexcept;
+
+	/// @brief 頂点を視点から見た角度の順に返します。
+	[[nodiscard]]
+	const Array<Vec2>& vertices() const noexcept;
+
+	/// @brief 点が見えるかを返します。
+	[[nodiscard]]
+	bool contains(const Vec2& point) const;
+
+	/// @brief 円の一部が見えるかを返します。
+	/// @remark 中心と上下左右の 4 点のどれかが見えるかで近似します。
+	[[nodiscard]]
+	bool intersects(const Circle& circle) const;
+
+private:
+
+	friend class VisibilityMap;
+
+	Vec2 m_origin{ 0, 0 };
+
+	double m_range = 0.0;
+
+	Array<Vec2> m_vertices;
+
+	/// @brief m_vertices[i] の視点から見た角度
+	Array<double> m_angles;
+};
+
+/// @brief 静的な壁に対する可視範囲を求め、結果をキャッシュする
+/// @remark 壁の辺を一様グリッドに振り分けておき、視点のまわりの辺だけを使って角度の順に光線を飛ばします。
+/// 辺ごとに視点から見た角度の範囲を求め、その範囲の光線とだけ交差を調べます。
+/// 視点の位置は CacheStep 単位に丸めて、同じ位置からの結果を使い回します。
+class VisibilityMap
+{
+public:
+
+	/// @brief 視点を丸める単位（ピクセル）
+	static constexpr double CacheStep = 4.0;
+
+	/// @brief キャッシュする結果の最大数。超えたらすべて捨てる
+	static constexpr size_t MaxCachedResults = 256;
+
+	/// @brief グリッドのセルの一辺の長さの既定値
+	static constexpr double DefaultCellSize = 128.0;
+
+	SIV3D_NODISCARD_CXX20
+	VisibilityMap() = default;
+
+	/// @brief 壁の辺をグリッドに振り分けます。
+	/// @param walls 壁の一覧
+	/// @param bounds 対象とする範囲
+	/// @param cellSize セルの一辺の長さ
+	SIV3D_NODISCARD_CXX20
+	VisibilityMap(const Array<Polygon>& walls, const RectF& bounds, double cellSize = DefaultCellSize);
+
+	/// @brief 視点から見える範囲を返します。
+	/// @param viewer 視点（壁の外にあること）
+	/// @param range 視点を中心とする正方形の一辺の半分。この外は見えないものとします
+	/// @return 見える範囲。次に compute() を呼ぶと無効になることがあります
+	[[nodiscard]]
+	const VisibilityPolygon& compute(const Vec2& viewer, double range);
+
+	/// @brief 視点から見える範囲を、呼び出し側が持つ result に求めます。
+	/// @param viewer 視点（壁の外にあること）
+	/// @param range 視点を中心とする正方形の一辺の半分
+	/// @param step 視点を丸める単位。result が同じ範囲で、丸めた同じ位置から求めたものなら計算し直しません
+	/// @param result 見える範囲の格納先
+	/// @return 計算し直した場合 true
+	/// @remark 動いている視点ごとに結果を持っておけるので、キャッシュの追い出しに左右されません。
+	bool update(const Vec2& viewer, double range, double step, VisibilityPolygon& result);
+
+	/// @brief キャッシュしている結果の数を返します。
+	[[nodiscard]]
+	size_t cachedCount() const noexcept;
+
+private:
+
+	struct Segment
+	{
+		Vec2 a;
+
+		Vec2 b;
+	};
+
+	RectF m_bounds{ 0, 0, 0, 0 };
+
+	double m_cellSize = DefaultCellSize;
+
+	int32 m_columns = 0;
+
+	int32 m_rows = 0;
+
+	Array<Segment> m_segments;
+
+	/// @brief セルごとの、セルと重なる辺のインデックス
+	Array<Array<uint32>> m_cells;
+
+	HashTable<uint64, VisibilityPolygon> m_cache;
+
+	// compute() の作業用。呼ぶたびに確保しないように使い回す
+	Array<uint32> m_visitedStamp;
+
+	uint32 m_stamp = 0;
+
+	Array<Segment> m_candidates;
+
+	Array<double> m_rayAngles;
+
+	Array<Vec2> m_rayDirections;
+
+	/// @brief 光線ごとの、いちばん近い辺までの距離
+	Array<double> m_rayHits;
+
+	[[nodiscard]]
+	Point toCell(const Vec2& pos) const;
+
+	void gatherCandidates(const RectF& area);
+
+	/// @brief 光線 [first, last) と辺の交差を調べ、近ければ m_rayHits を更新します。
+	void castRays(const Vec2& viewer, const Segment& segment, size_t first, size_t last);
+
+	void build(const Vec2& viewer, double range, VisibilityPolygon& result);
+};
@@ -0,0 +1,235 @@
+﻿# include "WallChunks.hpp"
+
+namespace
+{
+	/// @brief 表示範囲のこの距離以内に入ったチャンクを読み込む
+	constexpr double LoadDistance = 256.0;
+
+	/// @brief 表示範囲からこの距離より離れたチャンクを破棄する。読み込みと破棄を繰り返さないように LoadDistance より大きくする
+	constexpr double UnloadDistance = 768.0;
+
+	[[nodiscard]]
+	RectF Union(const RectF& a, const RectF& b)
+	{
+		const Vec2 tl{ Min(a.x, b.x), Min(a.y, b.y) };
+		const Vec2 br{ Max(a.rightX(), b.rightX()), Max(a.bottomY(), b.bottomY()) };
+		return{ tl, (br - tl) };
+	}
+}
+
+WallChunks::WallChunks(const Array<Polygon>& walls, const RectF& bounds, const ColorF& color, UnderlayFunction drawUnderlay, const double chunkSize)
+	: m_bounds{ bounds }
+	, m_color{ color }
+	, m_drawUnderlay{ std::move(drawUnderlay) }
+	, m_chunkSize{ Max(chunkSize, 1.0) }
+	, m_columns{ Max(static_cast<int32>(Math::Ceil(bounds.w / m_chunkSize)), 1) }
+	, m_rows{ Max(static_cast<int32>(Math::Ceil(bounds.h / m_chunkSize)), 1) }
+	, m_chunks(static_cast<size_t>(m_columns) * m_rows)
+{
+	for (size_t i = 0; i < walls.size(); ++i)
+	{
+		const RectF wallRect = walls[i].boundingRect();
+		const Point cell = toChunk(wallRect.center());
+		Chunk& chunk = m_chunks[static_cast<size_t>(cell.y) * m_columns + cell.x];
+
+		chunk.region = (chunk.walls ? Union(chunk.region, wallRect) : wallRect);
+		chunk.walls << static_cast<uint32>(i);
+	}
+
+	for (int32 y = 0; y < m_rows; ++y)
+	{
+		for (int32 x = 0; x < m_columns; ++x)
+		{
+			Chunk& chunk = m_chunks[static_cast<size_t>(y) * m_columns + x];
+			chunk.area = RectF{ (m_bounds.x + x * m_chunkSize), (m_bounds.y + y * m_chunkSize), m_chunkSize, m_chunkSize };
+
+			if (not chunk.walls)
+			{
+				continue;
+			}
+
+			// 端のチャンクは範囲外の壁も受け持つため、範囲の外側へは無限に広がっているとみなす
+			const double left = ((x == 0) ? chunk.region.x : chunk.area.x);
+			const double top = ((y == 0) ? chunk.region.y : chunk.area.y);
+			const double right = ((x == m_columns - 1) ? chunk.region.rightX() : chunk.area.rightX());
+			const double bottom = ((y == m_rows - 1) ? chunk.region.bottomY() : chunk.area.bottomY());
+
+			m_overhang = Max({ m_overhang, (left - chunk.region.x), (top - chunk.region.y),
+				(chunk.region.rightX() - right), (chunk.region.bottomY() - bottom) });
+
+			// 端のチャンクのテクスチャは、範囲外にある壁まで含める
+			const Vec2 tl{ Min(left, chunk.area.x), Min(top, chunk.area.y) };
+			const Vec2 br{ Max(right, chunk.area.rightX()), Max(bottom, chunk.area.bottomY()) };
+			chunk.area = RectF{ tl, (br - tl) };
+		}
+	}
+}
+
+void WallChunks::update(const Array<Polygon>& walls, const RectF& view)
+{
+	const RectF keepArea = view.stretched(UnloadDistance);
+
+	m_loaded.remove_if([&](const size_t index)
+		{
+			Chunk& chunk = m_chunks[index];
+
+			if (chunk.area.intersects(keepArea))
+			{
+				return false;
+			}
+
+			chunk.texture = RenderTexture{};
+			chunk.loaded = false;
+			return true;
+		});
+
+	const RectF loadArea = view.stretched(LoadDistance);
+
+	forEachChunkNear(loadArea, 0.0, [&](const size_t index)
+		{
+			Chunk& chunk = m_chunks[index];
+
+			if (chunk.loaded or (not chunk.area.intersects(loadArea)))
+			{
+				return;
+			}
+
+			load(walls, chunk);
+			m_loaded << index;
+		});
+}
+
+void WallChunks::draw(const RectF& view) const
+{
+	forEachChunkNear(view, 0.0, [&](const size_t index)
+		{
+			const Chunk& chunk = m_chunks[index];
+
+			if ((not chunk.loaded) or (not chunk.area.intersects(view)))
+			{
+				return;
+			}
+
+			chunk.texture.draw(chunk.area.pos);
+		});
+}
+
+size_t WallChunks::chunkCount() const noexcept
+{
+	return m_chunks.size();
+}
+
+size_t WallChunks::loadedCount() const noexcept
+{
+	return m_loaded.size();
+}
+
+Point WallChunks::toChunk(const Vec2& pos) const
+{
+	const int32 x = static_cast<int32>(Math::Floor((pos.x - m_bounds.x) / m_chunkSize));
+	const int32 y = static_cast<int32>(Math::Floor((pos.y - m_bounds.y) / m_chunkSize));
+	return{ Clamp(x, 0, (m_columns - 1)), Clamp(y, 0, (m_rows - 1)) };
+}
+
+template <class Fty>
+void WallChunks::forEachChunkNear(const RectF& area, const double margin, Fty f) const
+{
+	if (m_chunks.isEmpty())
+	{
+		return;
+	}
+
+	const RectF searchArea = area.stretched(margin);
+	const Point begin = toChunk(searchArea.tl());
+	const Point end = toChunk(searchArea.br());
+
+	for (int32 y = begin.y; y <= end.y; ++y)
+	{
+		for (int32 x = begin.x; x <= end.x; ++x)
+		{
+			f(static_cast<size_t>(y) * m_columns + x);
+		}
+	}
+}
+
+void WallChunks::load(const Array<Polygon>& walls, Chunk& chunk) const
+{
+	const Float4 color = m_color.toFloat4();
+	Array<Buffer2D> meshes;
+	Array<Vertex2D> vertices;
+	Array<TriangleIndex> indices;
+
+	const auto flush = [&]()
+		{
+			if (vertices)
+			{
+				meshes.emplace_back(vertices, indices);
+				vertices.clear();
+				indices.clear();
+			}
+		};
+
+	// 隣のチャンクに属していても、このチャンクの範囲に掛かる壁はすべて描く。はみ出しの分だけ広げて探す
+	forEachChunkNear(chunk.area, m_overhang, [&](const size_t index)
+		{
+			for (const uint32 wallIndex : m_chunks[index].walls)
+			{
+				const Polygon& wall = walls[wallIndex];
+
+				if (not wall.boundingRect().intersects(chunk.area))
+				{
+					continue;
+				}
+
+				const Array<Vec2>& wallVertices = wall.vertices();
+
+				if (Largest<Vertex2D::IndexType> < (vertices.size() + wallVertices.size()))
+				{
+					flush();
+				}
+
+				const auto base = static_cast<Vertex2D::IndexType>(vertices.size());
+
+				for (const auto& v : wallVertices)
+				{
+					Vertex2D vertex;
+					vertex.pos = Float2{ static_cast<float>(v.x), static_cast<float>(v.y) };
+					vertex.tex = Float2{ 0.0f, 0.0f };
+					vertex.color = color;
+					vertices << vertex;
+				}
+
+				for (const auto& triangle : wall.indices())
+				{
+					indices << TriangleIndex{ static_cast<Vertex2D::IndexType>(base + triangle.i0),
+						static_cast<Vertex2D::IndexType>(base + triangle.i1), static_cast<Vertex2D::IndexType>(base + triangle.i2) };
+				}
+			}
+		});
+
+	flush();
+
+	const Size textureSize{ static_cast<int32>(Math::Ceil(chunk.area.w)), static_cast<int32>(Math::Ceil(chunk.area.h)) };
+	chunk.texture = RenderTexture{ textureSize, ColorF{ 0.0, 0.0 } };
+
+	{
+		const ScopedRenderTarget2D target{ chunk.texture };
+		// 既定のブレンドではアルファが 0 のまま残り、Premultiplied で描くと背景に加算されてしまう。
+		// 透明な黒の上に MaxAlpha で描くと、色は乗算済みになりアルファも書き込まれる
+		const ScopedRenderStates2D blend{ BlendState::MaxAlpha };
+		// カメラなど外側の変換は無視して、チャンクの左上を原点にする
+		const Transformer2D transformer{ Mat3x2::Translate(-chunk.area.pos), TransformCursor::No, Transformer2D::Target::SetLocal };
+
+		if (m_drawUnderlay)
+		{
+			m_drawUnderlay(chunk.area);
+		}
+
+		for (const auto& mesh : meshes)
+		{
+			mesh.draw();
+		}
+	}
+
+	chunk.loaded = true;
+}
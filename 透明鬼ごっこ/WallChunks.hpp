@@ -0,0 +1,96 @@
+﻿# pragma once
+# include <Siv3D.hpp>
+
+/// @brief ステージの壁などの動かないものを、チャンクごとの RenderTexture に一度だけ描いておき、1 枚の四角形として描画する
+/// @remark ステージはチャンクサイズのマス目に分けます。壁は外接長方形の中心があるチャンクに属し、
+/// チャンクのテクスチャにはそのマス目と重なるすべての壁が描かれます。
+/// テクスチャは表示範囲に近づくと描かれ、十分に離れると破棄されます。
+/// ワールド座標のまま等倍で描くので、ウィンドウの大きさが変わっても描き直す必要はありません。
+class WallChunks
+{
+public:
+
+	/// @brief チャンクの一辺の長さの既定値
+	static constexpr double DefaultChunkSize = 512.0;
+
+	/// @brief 壁の下に描く、動かないものを描く関数。引数はテクスチャに描く範囲（ワールド座標）
+	using UnderlayFunction = std::function<void(const RectF&)>;
+
+	SIV3D_NODISCARD_CXX20
+	WallChunks() = default;
+
+	/// @brief 壁をチャンクに振り分けます。テクスチャはまだ描きません。
+	/// @param walls 壁の一覧
+	/// @param bounds 対象とする範囲。範囲外の壁は最寄りのチャンクに入ります
+	/// @param color 壁の色
+	/// @param drawUnderlay 壁の下に描く、動かないもの（スポーン地点など）を描く関数。ワールド座標で描いてください
+	/// @param chunkSize チャンクの一辺の長さ
+	SIV3D_NODISCARD_CXX20
+	WallChunks(const Array<Polygon>& walls, const RectF& bounds, const ColorF& color, UnderlayFunction drawUnderlay = {}, double chunkSize = DefaultChunkSize);
+
+	/// @brief 表示範囲の近くのチャンクのテクスチャを描き、遠くのチャンクのテクスチャを破棄します。
+	/// @param walls コンストラクタに渡したものと同じ壁の一覧
+	/// @param view 表示範囲
+	void update(const Array<Polygon>& walls, const RectF& view);
+
+	/// @brief 表示範囲と重なる、読み込み済みのチャンクを描画します。
+	/// @remark テクスチャの色はアルファ乗算済みなので、BlendState::Premultiplied を設定した状態で呼んでください。
+	/// @param view 表示範囲
+	void draw(const RectF& view) const;
+
+	/// @brief チャンクの数を返します。
+	[[nodiscard]]
+	size_t chunkCount() const noexcept;
+
+	/// @brief テクスチャを読み込んでいるチャンクの数を返します。
+	[[nodiscard]]
+	size_t loadedCount() const noexcept;
+
+private:
+
+	struct Chunk
+	{
+		/// @brief このチャンクに属する壁のインデックス
+		Array<uint32> walls;
+
+		/// @brief 属する壁すべての外接長方形
+		RectF region{ 0, 0, 0, 0 };
+
+		/// @brief テクスチャに描く範囲。端のチャンクは範囲外の壁まで広げる
+		RectF area{ 0, 0, 0, 0 };
+
+		RenderTexture texture;
+
+		bool loaded = false;
+	};
+
+	RectF m_bounds{ 0, 0, 0, 0 };
+
+	ColorF m_color{ 1.0 };
+
+	UnderlayFunction m_drawUnderlay;
+
+	double m_chunkSize = DefaultChunkSize;
+
+	int32 m_columns = 0;
+
+	int32 m_rows = 0;
+
+	/// @brief 壁がチャンクの範囲からはみ出す最大の長さ
+	double m_overhang = 0.0;
+
+	Array<Chunk> m_chunks;
+
+	/// @brief 読み込み済みのチャンクのインデックス
+	Array<size_t> m_loaded;
+
+	[[nodiscard]]
+	Point toChunk(const Vec2& pos) const;
+
+	/// @brief area を margin だけ広げた範囲と重なるマス目のチャンクについて関数を呼びます。
+	/// @remark margin に m_overhang を渡すと、area と重なりうる壁を持つチャンクをすべて拾えます。
+	template <class Fty>
+	void forEachChunkNear(const RectF& area, double margin, Fty f) const;
+
+	void load(const Array<Polygon>& walls, Chunk& chunk) const;
+};